@@ -0,0 +1,86 @@
+#pragma once
+#include <vector>
+
+/*
+\brief Set of cell indices processed by a converging simulation, without duplicates.
+Insertion is constant time : a cell is marked with the current generation when inserted,
+and clearing the set only starts a new generation. The set may also contain all the cells
+of the field without listing them, Cells() is then empty.
+*/
+class ActiveCells
+{
+private:
+	std::vector<int> cells;
+	std::vector<unsigned int> marks;
+	unsigned int generation;
+	bool all;
+
+public:
+	ActiveCells() : generation(1), all(false)
+	{
+	}
+
+	/*
+	\brief Activate all the cells of a field.
+	*/
+	void Reset(int cellCount)
+	{
+		cells.clear();
+		marks.assign(cellCount, 0);
+		generation = 1;
+		all = true;
+	}
+
+	void SetAll()
+	{
+		Clear();
+		all = true;
+	}
+
+	bool All() const
+	{
+		return all;
+	}
+
+	/*
+	\brief Returns true if the set was reset for a field of the given cell count.
+	*/
+	bool IsInitialized(int cellCount) const
+	{
+		return int(marks.size()) == cellCount;
+	}
+
+	void Clear()
+	{
+		all = false;
+		cells.clear();
+		if (++generation == 0)
+		{
+			std::fill(marks.begin(), marks.end(), 0);
+			generation = 1;
+		}
+	}
+
+	void Insert(int id)
+	{
+		if (marks[id] == generation)
+			return;
+		marks[id] = generation;
+		cells.push_back(id);
+	}
+
+	const std::vector<int>& Cells() const
+	{
+		return cells;
+	}
+
+	int Count() const
+	{
+		return all ? int(marks.size()) : int(cells.size());
+	}
+
+	bool Empty() const
+	{
+		return Count() == 0;
+	}
+};
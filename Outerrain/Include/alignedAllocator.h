@@ -0,0 +1,107 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+/*
+\brief Subsystems whose allocations are counted separately by AlignedMemory.
+*/
+enum MemorySubsystem
+{
+	MemoryGeneral = 0,		// Any other container
+	MemoryFields = 1,		// Values of the fields, and of the buffers of their pools
+	MemoryMesh = 2,			// Vertices, normals, texcoords and indices of the meshes
+	MemoryScratch = 3,		// Chunks of the frame arenas
+	MemorySubsystemCount = 4
+};
+
+class AlignedMemory
+{
+public:
+	static const size_t Alignment = 64;
+	static const size_t HugePageSize = size_t(2) << 20;
+
+	static void* Allocate(size_t bytes, MemorySubsystem subsystem);
+	static void Free(void* p, size_t bytes, MemorySubsystem subsystem);
+
+	static void SetHugePages(bool enabled);
+	static bool HugePages();
+
+	static size_t Allocated(MemorySubsystem subsystem);
+	static size_t Peak(MemorySubsystem subsystem);
+	static size_t AllocationCount(MemorySubsystem subsystem);
+	static const char* Name(MemorySubsystem subsystem);
+	static void PrintInfos();
+};
+
+/*
+\brief Standard allocator returning memory aligned on cache lines, see AlignedMemory.
+Containers of large fields and meshes use it through AlignedVector, so that rows start on cache lines
+and vectorized loops do not straddle lines, and so that their memory is counted per subsystem.
+*/
+template<typename T, MemorySubsystem Subsystem = MemoryGeneral>
+class AlignedAllocator
+{
+public:
+	typedef T value_type;
+
+	template<typename U>
+	struct rebind
+	{
+		typedef AlignedAllocator<U, Subsystem> other;
+	};
+
+	AlignedAllocator()
+	{
+	}
+
+	template<typename U>
+	AlignedAllocator(const AlignedAllocator<U, Subsystem>&)
+	{
+	}
+
+	T* allocate(size_t n)
+	{
+		void* p = AlignedMemory::Allocate(n * sizeof(T), Subsystem);
+		if (p == nullptr)
+			throw std::bad_alloc();
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		AlignedMemory::Free(p, n * sizeof(T), Subsystem);
+	}
+
+	/*
+	\brief Default initialize values instead of value initializing them : resize() without a value leaves floats
+	uninitialized, so that large buffers are not written twice, and their pages are first touched by the code filling them.
+	*/
+	template<typename U>
+	void construct(U* p)
+	{
+		::new(static_cast<void*>(p)) U;
+	}
+
+	template<typename U, typename... Args>
+	void construct(U* p, Args&&... args)
+	{
+		::new(static_cast<void*>(p)) U(std::forward<Args>(args)...);
+	}
+
+	template<typename U>
+	bool operator==(const AlignedAllocator<U, Subsystem>&) const
+	{
+		return true;
+	}
+
+	template<typename U>
+	bool operator!=(const AlignedAllocator<U, Subsystem>&) const
+	{
+		return false;
+	}
+};
+
+template<typename T, MemorySubsystem Subsystem = MemoryGeneral>
+using AlignedVector = std::vector<T, AlignedAllocator<T, Subsystem>>;
@@ -0,0 +1,14 @@
+#pragma once
+
+/*
+\brief Operators combining a height with the terrain below it, shared by the terrain graph and the construction tree.
+*/
+enum BlendOperation
+{
+	BlendAdd = 0,
+	BlendSubtract = 1,
+	BlendMultiply = 2,
+	BlendMin = 3,
+	BlendMax = 4,
+	BlendLerp = 5
+};
@@ -14,6 +14,8 @@ public:
 	Box2D(const Vector2& C, float R);
 
 	bool Contains(const Vector2&) const;
+	bool Intersect(const Box2D&) const;
+	Box2D Merged(const Box2D&) const;
 	void Extend(const Vector2&);
 	Box2D Extended(const Vector2&) const;
 	void Scale(float f);
@@ -0,0 +1,136 @@
+#pragma once
+#include <vector>
+#include <map>
+#include <mutex>
+
+#include "alignedAllocator.h"
+
+/*
+\brief Pool of reusable buffers, used for the scratch fields of erosion steps so that every step does not
+allocate, page fault and free several megabytes.
+Buffers are the aligned buffers of the fields, see ValueField. They are sorted in size classes : four classes per power of two, so that a buffer wastes at most a quarter of its size.
+Acquired buffers have the requested size and unspecified values, they are given back with Release() once done.
+The pool keeps at most a given memory, 512 MB by default, released buffers beyond are freed. Access is thread safe.
+*/
+template<typename T>
+class BufferPool
+{
+public:
+	typedef AlignedVector<T, MemoryFields> Buffer;
+
+protected:
+	std::mutex mutex;
+	std::map<size_t, std::vector<Buffer>> buffers;		// Free buffers, by size class
+	size_t pooledBytes;
+	size_t maxPooledBytes;
+
+	/*
+	\brief Get the smallest size class holding n values, internal function.
+	*/
+	static size_t ClassAbove(size_t n)
+	{
+		if (n <= MinClass)
+			return MinClass;
+		size_t base = MinClass;
+		while (base * 2 <= n)
+			base *= 2;
+		size_t step = base / 4;
+		return base + ((n - base + step - 1) / step) * step;
+	}
+
+	/*
+	\brief Get the largest size class whose buffers fit in n values, internal function.
+	*/
+	static size_t ClassBelow(size_t n)
+	{
+		size_t base = MinClass;
+		while (base * 2 <= n)
+			base *= 2;
+		size_t step = base / 4;
+		return base + ((n - base) / step) * step;
+	}
+
+public:
+	static const size_t MinClass = 1024;
+
+	BufferPool(size_t maxBytes = size_t(512) << 20) : pooledBytes(0), maxPooledBytes(maxBytes)
+	{
+	}
+
+	/*
+	\brief Get the pool shared by the application.
+	*/
+	static BufferPool& Global()
+	{
+		static BufferPool pool;
+		return pool;
+	}
+
+	/*
+	\brief Get a buffer of n values, whose values are unspecified.
+	*/
+	Buffer Acquire(size_t n)
+	{
+		size_t size = ClassAbove(n);
+		Buffer buffer;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = buffers.find(size);
+			if (it != buffers.end() && !it->second.empty())
+			{
+				buffer.swap(it->second.back());
+				it->second.pop_back();
+				pooledBytes -= buffer.capacity() * sizeof(T);
+			}
+		}
+		if (buffer.capacity() < n)
+			buffer.reserve(size);
+		buffer.resize(n);
+		return buffer;
+	}
+
+	/*
+	\brief Give a buffer back to the pool. Any buffer may be given, whatever its origin.
+	*/
+	void Release(Buffer&& buffer)
+	{
+		size_t bytes = buffer.capacity() * sizeof(T);
+		if (buffer.capacity() < MinClass)
+			return;
+		Buffer kept;
+		kept.swap(buffer);
+		std::lock_guard<std::mutex> lock(mutex);
+		if (pooledBytes + bytes > maxPooledBytes)
+			return;
+		pooledBytes += bytes;
+		buffers[ClassBelow(kept.capacity())].push_back(std::move(kept));
+	}
+
+	/*
+	\brief Free all the pooled buffers.
+	*/
+	void Clear()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		buffers.clear();
+		pooledBytes = 0;
+	}
+
+	/*
+	\brief Get the memory held by the free buffers, in bytes.
+	*/
+	size_t PooledBytes()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return pooledBytes;
+	}
+
+	/*
+	\brief Set the memory the pool may keep, in bytes.
+	*/
+	void SetMaxPooledBytes(size_t bytes)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		maxPooledBytes = bytes;
+	}
+};
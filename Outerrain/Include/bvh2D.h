@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+
+#include "box2D.h"
+
+/*
+\brief Bounding volume hierarchy over a set of 2D boxes, stored as a flat array of nodes.
+*/
+class BVH2D
+{
+protected:
+	struct Node
+	{
+		Box2D box;
+		int first;		// Inner nodes : index of the right child, the left child follows the node. Leaves : first item.
+		int count;		// Item count of leaves, 0 for inner nodes
+	};
+
+	static const int LeafSize = 4;
+
+	std::vector<Node> nodes;
+	std::vector<int> items;
+	std::vector<Box2D> boxes;
+
+	int Build(const std::vector<Vector2>& centers, int first, int last);
+
+public:
+	BVH2D();
+
+	void Build(const std::vector<Box2D>& boxes);
+	void Clear();
+	bool Empty() const;
+	Box2D GetBox() const;
+	int NodeCount() const;
+
+	/*
+	\brief Call visit(item) for every box intersecting a query box.
+	*/
+	template<typename Visitor>
+	void Query(const Box2D& box, const Visitor& visit) const
+	{
+		if (nodes.empty())
+			return;
+		int stack[64];
+		int top = 0;
+		stack[top++] = 0;
+		while (top > 0)
+		{
+			const Node& node = nodes[stack[--top]];
+			if (node.box.Intersect(box) == false)
+				continue;
+			if (node.count > 0)
+			{
+				for (int k = node.first; k < node.first + node.count; k++)
+				{
+					if (boxes[items[k]].Intersect(box))
+						visit(items[k]);
+				}
+				continue;
+			}
+			int index = int(&node - nodes.data());
+			stack[top++] = node.first;
+			stack[top++] = index + 1;
+		}
+	}
+
+	void Query(const Box2D& box, std::vector<int>& result) const;
+};
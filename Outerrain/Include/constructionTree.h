@@ -0,0 +1,56 @@
+#pragma once
+#include "heightfield.h"
+#include "blendOperation.h"
+#include "bvh2D.h"
+
+enum StampShape
+{
+	StampCircle = 0,
+	StampSegment = 1,
+	StampField = 2
+};
+
+/*
+\brief Local terrain feature : a height and a falloff alpha in [0, 1] over a compact support,
+combined with the terrain below it by a blend operator.
+*/
+struct TerrainStamp
+{
+	StampShape shape;
+	BlendOperation operation;
+	Vector2 a, b;					// Circle : center. Segment : end points. Field : box of the stamp.
+	float radius;					// Circle and segment radius, width of the border falloff of fields
+	float height;					// Stamp height, scale of the field values for fields
+	float weight;					// Alpha multiplier
+	const ScalarField2D* field;		// Stamped field, for field stamps only
+
+	static TerrainStamp Circle(const Vector2& center, float radius, float height, BlendOperation operation = BlendAdd, float weight = 1.0f);
+	static TerrainStamp Segment(const Vector2& a, const Vector2& b, float radius, float height, BlendOperation operation = BlendAdd, float weight = 1.0f);
+	static TerrainStamp Field(const ScalarField2D* field, const Box2D& box, float height, float border, BlendOperation operation = BlendAdd, float weight = 1.0f);
+
+	Box2D Support() const;
+	bool Evaluate(const Vector2& p, float& h, float& alpha) const;
+	void Apply(const Vector2& p, float& h) const;
+};
+
+class ConstructionTree
+{
+protected:
+	std::vector<TerrainStamp> stamps;
+	BVH2D bvh;
+	bool dirty;
+
+	void Build();
+
+public:
+	ConstructionTree();
+
+	int Add(const TerrainStamp& stamp);
+	void Clear();
+	int StampCount() const;
+	const TerrainStamp& GetStamp(int i) const;
+	Box2D Support();
+
+	float Evaluate(const Vector2& p, float base = 0.0f);
+	void Rasterize(HeightField& hf, int tileSize = 32);
+};
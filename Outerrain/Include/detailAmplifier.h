@@ -0,0 +1,23 @@
+#pragma once
+#include "heightfield.h"
+#include "noise.h"
+
+class DetailAmplifier
+{
+protected:
+	HeightField coarse;
+	ScalarField2D detail;
+	const Noise& noise;
+	float amplitude;
+	float frequency;
+	int octaves;
+
+	void AmplifyBlock(const HeightField& shape, float* heights, int i0, int i1, int j0, int j1) const;
+
+public:
+	DetailAmplifier(const HeightField& coarse, const Noise& noise, float amplitude, float frequency, int octaves, float slopeWeight = 1.0f, float drainageWeight = 1.0f);
+
+	void Amplify(HeightField& tile) const;
+	HeightField Amplify(int nx, int ny, int tileSize = 64) const;
+	const ScalarField2D& DetailMask() const;
+};
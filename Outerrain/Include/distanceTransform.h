@@ -0,0 +1,21 @@
+#pragma once
+#include <vector>
+
+#include "scalarfield2D.h"
+
+class DistanceTransform
+{
+protected:
+	static void Columns(const std::vector<char>& mask, int nx, int ny, float* g);
+	static void Rows(float* g, int nx, int ny, float cellJ, float cellI);
+
+public:
+	static const int StripWidth = 256;
+
+	static ScalarField2D Compute(const ScalarField2D& shape, const std::vector<char>& mask);
+	static ScalarField2D Compute(const ScalarField2D& field, float threshold);
+	static ScalarField2D Compute(const ScalarField2D& shape, const std::vector<ScalarValue>& cells);
+
+	static ScalarField2D BruteForce(const ScalarField2D& shape, const std::vector<char>& mask);
+	static float Check(const ScalarField2D& shape, const std::vector<char>& mask);
+};
@@ -0,0 +1,11 @@
+#pragma once
+
+/*
+\brief Erosion processes shared by the background erosion worker, the terrain graph and the multigrid driver.
+*/
+enum ErosionType
+{
+	ErosionThermal = 0,
+	ErosionStreamPower = 1,
+	ErosionHydraulic = 2
+};
@@ -0,0 +1,54 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "heightfield.h"
+#include "landscapeEvolution.h"
+#include "erosionType.h"
+
+class ErosionWorker
+{
+protected:
+	HeightField field;
+	LandscapeEvolution* evolution;
+	HeightField buffers[2];
+	std::atomic<int> front;
+	std::atomic<int> readers[2];
+	std::atomic<unsigned int> version;
+	ActiveCells active;
+	std::atomic<int> activeCellCount;
+	unsigned int activeRequest;
+
+	ErosionType type;
+	unsigned int request;
+	std::atomic<int> remainingSteps;
+	std::atomic<int> completedSteps;
+	std::atomic<bool> paused;
+	bool quit;
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::thread thread;
+
+	void ThreadLoop();
+	bool Step(ErosionType stepType);
+	void Publish();
+
+public:
+	ErosionWorker(const HeightField& hf);
+	~ErosionWorker();
+
+	void Run(ErosionType erosionType, int stepCount);
+	void Pause();
+	void Resume();
+	void Cancel();
+
+	bool IsPaused() const;
+	bool IsRunning() const;
+	int RemainingSteps() const;
+	int CompletedSteps() const;
+	int ActiveCellCount() const;
+	unsigned int Version() const;
+	bool CopySnapshot(HeightField& hf, unsigned int& lastVersion);
+};
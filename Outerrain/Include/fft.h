@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+
+/*
+\brief Two dimensional complex fast Fourier transform of power of two resolutions.
+*/
+class FFT2D
+{
+protected:
+	/*
+	\brief Precomputed tables of a one dimensional transform of size n.
+	*/
+	struct Plan
+	{
+		int n;
+		std::vector<int> reversed;		// Bit reversed index of every entry
+		std::vector<float> cosine;		// Twiddle factors exp(-2 i pi k / n), k < n / 2
+		std::vector<float> sine;
+	};
+
+	static const int Lanes = 16;
+	static const int StripLanes = 4;
+	static const int BlockSize = 256;
+
+	int nx, ny;
+	Plan rows, columns;
+
+	static Plan MakePlan(int n);
+	static void Transform(const Plan& plan, float* re, float* im, bool inverse);
+	static void Butterflies(const Plan& plan, float* re, float* im, int first, int last, int half, float sign);
+	void TransformRows(float* re, float* im, bool inverse) const;
+	void TransformColumns(float* re, float* im, bool inverse) const;
+
+public:
+	FFT2D(int nx, int ny);
+
+	static bool IsPowerOfTwo(int n);
+
+	bool IsValid() const;
+	void Forward(float* re, float* im) const;
+	void Inverse(float* re, float* im) const;
+};
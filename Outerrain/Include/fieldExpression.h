@@ -0,0 +1,398 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "valueField.h"
+#include "taskScheduler.h"
+
+/*
+\brief Expression templates over float fields.
+Arithmetic on fields and scalars builds a lightweight expression tree instead of computing temporaries.
+Assigning an expression to a ScalarField2D, or reducing it, evaluates the whole tree in a single pass over
+the cells, split in parallel chunks, with a plain indexed inner loop that the compiler can vectorize :
+	S = abs(log(A / (1.0f + S)));
+All the fields of an expression must have the same resolution. Expressions only hold references to
+their fields, and must not outlive them.
+*/
+template<typename E>
+class FieldExpression
+{
+public:
+	const E& Self() const
+	{
+		return static_cast<const E&>(*this);
+	}
+};
+
+/*
+\brief Leaf of an expression reading a field.
+*/
+class FieldTerminal : public FieldExpression<FieldTerminal>
+{
+private:
+	const ValueField<float>* field;
+	const float* data;
+
+public:
+	FieldTerminal(const ValueField<float>& field) : field(&field), data(field.Data())
+	{
+	}
+
+	float operator[](int i) const
+	{
+		return data[i];
+	}
+
+	const ValueField<float>* Shape() const
+	{
+		return field;
+	}
+};
+
+/*
+\brief Leaf of an expression holding a constant.
+*/
+class ScalarTerminal : public FieldExpression<ScalarTerminal>
+{
+private:
+	float value;
+
+public:
+	ScalarTerminal(float value) : value(value)
+	{
+	}
+
+	float operator[](int) const
+	{
+		return value;
+	}
+
+	const ValueField<float>* Shape() const
+	{
+		return nullptr;
+	}
+};
+
+template<typename Op, typename A>
+class UnaryExpression : public FieldExpression<UnaryExpression<Op, A>>
+{
+private:
+	A a;
+
+public:
+	UnaryExpression(const A& a) : a(a)
+	{
+	}
+
+	float operator[](int i) const
+	{
+		return Op::Apply(a[i]);
+	}
+
+	const ValueField<float>* Shape() const
+	{
+		return a.Shape();
+	}
+};
+
+template<typename Op, typename A, typename B>
+class BinaryExpression : public FieldExpression<BinaryExpression<Op, A, B>>
+{
+private:
+	A a;
+	B b;
+
+public:
+	BinaryExpression(const A& a, const B& b) : a(a), b(b)
+	{
+	}
+
+	float operator[](int i) const
+	{
+		return Op::Apply(a[i], b[i]);
+	}
+
+	const ValueField<float>* Shape() const
+	{
+		return a.Shape() != nullptr ? a.Shape() : b.Shape();
+	}
+};
+
+template<typename Op, typename A, typename B, typename C>
+class TernaryExpression : public FieldExpression<TernaryExpression<Op, A, B, C>>
+{
+private:
+	A a;
+	B b;
+	C c;
+
+public:
+	TernaryExpression(const A& a, const B& b, const C& c) : a(a), b(b), c(c)
+	{
+	}
+
+	float operator[](int i) const
+	{
+		return Op::Apply(a[i], b[i], c[i]);
+	}
+
+	const ValueField<float>* Shape() const
+	{
+		return a.Shape() != nullptr ? a.Shape() : (b.Shape() != nullptr ? b.Shape() : c.Shape());
+	}
+};
+
+/*
+\brief Conversion of the operands of an expression : expressions are copied, float fields and scalars become leaves.
+*/
+template<typename T, typename Enable = void>
+struct FieldOperand
+{
+	static const bool IsField = false;
+	static const bool IsValid = false;
+};
+
+template<typename T>
+struct FieldOperand<T, typename std::enable_if<std::is_base_of<FieldExpression<T>, T>::value>::type>
+{
+	static const bool IsField = true;
+	static const bool IsValid = true;
+	typedef T Type;
+	static Type Make(const T& t) { return t; }
+};
+
+template<typename T>
+struct FieldOperand<T, typename std::enable_if<std::is_base_of<ValueField<float>, T>::value>::type>
+{
+	static const bool IsField = true;
+	static const bool IsValid = true;
+	typedef FieldTerminal Type;
+	static Type Make(const T& t) { return FieldTerminal(t); }
+};
+
+template<typename T>
+struct FieldOperand<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+{
+	static const bool IsField = false;
+	static const bool IsValid = true;
+	typedef ScalarTerminal Type;
+	static Type Make(const T& t) { return ScalarTerminal(float(t)); }
+};
+
+template<typename A, typename B = float, typename C = float>
+struct EnableField : std::enable_if<FieldOperand<A>::IsValid && FieldOperand<B>::IsValid && FieldOperand<C>::IsValid &&
+									(FieldOperand<A>::IsField || FieldOperand<B>::IsField || FieldOperand<C>::IsField)>
+{
+};
+
+namespace FieldOps
+{
+	struct Add { static float Apply(float a, float b) { return a + b; } };
+	struct Subtract { static float Apply(float a, float b) { return a - b; } };
+	struct Multiply { static float Apply(float a, float b) { return a * b; } };
+	struct Divide { static float Apply(float a, float b) { return a / b; } };
+	struct Less { static float Apply(float a, float b) { return a < b ? 1.0f : 0.0f; } };
+	struct Greater { static float Apply(float a, float b) { return a > b ? 1.0f : 0.0f; } };
+	struct Negate { static float Apply(float a) { return -a; } };
+	struct Sqrt { static float Apply(float a) { return std::sqrt(a); } };
+	struct Log { static float Apply(float a) { return std::log(a); } };
+	struct Abs { static float Apply(float a) { return std::fabs(a); } };
+	struct Clamp { static float Apply(float x, float a, float b) { return x < a ? a : x > b ? b : x; } };
+	struct Lerp { static float Apply(float a, float b, float t) { return a + (b - a) * t; } };
+	struct Select { static float Apply(float c, float a, float b) { return c != 0.0f ? a : b; } };
+}
+
+template<typename Op, typename A>
+using FieldUnary = UnaryExpression<Op, typename FieldOperand<A>::Type>;
+
+template<typename Op, typename A, typename B>
+using FieldBinary = BinaryExpression<Op, typename FieldOperand<A>::Type, typename FieldOperand<B>::Type>;
+
+template<typename Op, typename A, typename B, typename C>
+using FieldTernary = TernaryExpression<Op, typename FieldOperand<A>::Type, typename FieldOperand<B>::Type, typename FieldOperand<C>::Type>;
+
+template<typename A, typename B, typename = typename EnableField<A, B>::type>
+inline FieldBinary<FieldOps::Add, A, B> operator+(const A& a, const B& b)
+{
+	return FieldBinary<FieldOps::Add, A, B>(FieldOperand<A>::Make(a), FieldOperand<B>::Make(b));
+}
+
+template<typename A, typename B, typename = typename EnableField<A, B>::type>
+inline FieldBinary<FieldOps::Subtract, A, B> operator-(const A& a, const B& b)
+{
+	return FieldBinary<FieldOps::Subtract, A, B>(FieldOperand<A>::Make(a), FieldOperand<B>::Make(b));
+}
+
+template<typename A, typename B, typename = typename EnableField<A, B>::type>
+inline FieldBinary<FieldOps::Multiply, A, B> operator*(const A& a, const B& b)
+{
+	return FieldBinary<FieldOps::Multiply, A, B>(FieldOperand<A>::Make(a), FieldOperand<B>::Make(b));
+}
+
+template<typename A, typename B, typename = typename EnableField<A, B>::type>
+inline FieldBinary<FieldOps::Divide, A, B> operator/(const A& a, const B& b)
+{
+	return FieldBinary<FieldOps::Divide, A, B>(FieldOperand<A>::Make(a), FieldOperand<B>::Make(b));
+}
+
+template<typename A, typename B, typename = typename EnableField<A, B>::type>
+inline FieldBinary<FieldOps::Less, A, B> operator<(const A& a, const B& b)
+{
+	return FieldBinary<FieldOps::Less, A, B>(FieldOperand<A>::Make(a), FieldOperand<B>::Make(b));
+}
+
+template<typename A, typename B, typename = typename EnableField<A, B>::type>
+inline FieldBinary<FieldOps::Greater, A, B> operator>(const A& a, const B& b)
+{
+	return FieldBinary<FieldOps::Greater, A, B>(FieldOperand<A>::Make(a), FieldOperand<B>::Make(b));
+}
+
+template<typename A, typename = typename EnableField<A>::type>
+inline FieldUnary<FieldOps::Negate, A> operator-(const A& a)
+{
+	return FieldUnary<FieldOps::Negate, A>(FieldOperand<A>::Make(a));
+}
+
+template<typename A, typename = typename EnableField<A>::type>
+inline FieldUnary<FieldOps::Sqrt, A> sqrt(const A& a)
+{
+	return FieldUnary<FieldOps::Sqrt, A>(FieldOperand<A>::Make(a));
+}
+
+template<typename A, typename = typename EnableField<A>::type>
+inline FieldUnary<FieldOps::Log, A> log(const A& a)
+{
+	return FieldUnary<FieldOps::Log, A>(FieldOperand<A>::Make(a));
+}
+
+template<typename A, typename = typename EnableField<A>::type>
+inline FieldUnary<FieldOps::Abs, A> abs(const A& a)
+{
+	return FieldUnary<FieldOps::Abs, A>(FieldOperand<A>::Make(a));
+}
+
+/*
+\brief Clamp x in [a, b], cell by cell.
+*/
+template<typename X, typename A, typename B, typename = typename EnableField<X, A, B>::type>
+inline FieldTernary<FieldOps::Clamp, X, A, B> clamp(const X& x, const A& a, const B& b)
+{
+	return FieldTernary<FieldOps::Clamp, X, A, B>(FieldOperand<X>::Make(x), FieldOperand<A>::Make(a), FieldOperand<B>::Make(b));
+}
+
+/*
+\brief Linear interpolation between a and b with parameter t, cell by cell.
+*/
+template<typename A, typename B, typename T, typename = typename EnableField<A, B, T>::type>
+inline FieldTernary<FieldOps::Lerp, A, B, T> lerp(const A& a, const B& b, const T& t)
+{
+	return FieldTernary<FieldOps::Lerp, A, B, T>(FieldOperand<A>::Make(a), FieldOperand<B>::Make(b), FieldOperand<T>::Make(t));
+}
+
+/*
+\brief a where the condition is not zero, b elsewhere, cell by cell. Conditions are built with < and >.
+*/
+template<typename C, typename A, typename B, typename = typename EnableField<C, A, B>::type>
+inline FieldTernary<FieldOps::Select, C, A, B> select(const C& c, const A& a, const B& b)
+{
+	return FieldTernary<FieldOps::Select, C, A, B>(FieldOperand<C>::Make(c), FieldOperand<A>::Make(a), FieldOperand<B>::Make(b));
+}
+
+namespace FieldAlgebra
+{
+	// Cells per parallel chunk : large enough to amortize a task, small enough to balance the workers
+	const int ChunkSize = 16384;
+
+	/*
+	\brief Evaluate an expression into an array, in parallel chunks.
+	*/
+	template<typename E>
+	inline void Evaluate(const E& e, float* out, int size)
+	{
+		TaskScheduler::Global().ParallelFor(0, size, [&](int first, int last)
+		{
+			for (int i = first; i < last; i++)
+				out[i] = e[i];
+		}, ChunkSize);
+	}
+
+	/*
+	\brief Reduce an expression with an associative operator, in parallel chunks.
+	*/
+	template<typename E, typename Operator>
+	inline float Reduce(const E& e, float identity, const Operator& reduce)
+	{
+		int size = e.Shape()->SizeX() * e.Shape()->SizeY();
+		std::vector<float> partials((size + ChunkSize - 1) / ChunkSize, identity);
+		TaskScheduler::Global().ParallelFor(0, size, [&](int first, int last)
+		{
+			float ret = identity;
+			for (int i = first; i < last; i++)
+				ret = reduce(ret, e[i]);
+			partials[first / ChunkSize] = ret;
+		}, ChunkSize);
+		float ret = identity;
+		for (size_t i = 0; i < partials.size(); i++)
+			ret = reduce(ret, partials[i]);
+		return ret;
+	}
+}
+
+template<typename A, typename = typename EnableField<A>::type>
+inline float ReduceSum(const A& a)
+{
+	return FieldAlgebra::Reduce(FieldOperand<A>::Make(a), 0.0f, [](float x, float y) { return x + y; });
+}
+
+template<typename A, typename = typename EnableField<A>::type>
+inline float ReduceAverage(const A& a)
+{
+	typename FieldOperand<A>::Type e = FieldOperand<A>::Make(a);
+	return ReduceSum(e) / float(e.Shape()->SizeX() * e.Shape()->SizeY());
+}
+
+template<typename A, typename = typename EnableField<A>::type>
+inline float ReduceMin(const A& a)
+{
+	return FieldAlgebra::Reduce(FieldOperand<A>::Make(a), std::numeric_limits<float>::max(), [](float x, float y) { return x < y ? x : y; });
+}
+
+template<typename A, typename = typename EnableField<A>::type>
+inline float ReduceMax(const A& a)
+{
+	return FieldAlgebra::Reduce(FieldOperand<A>::Make(a), -std::numeric_limits<float>::max(), [](float x, float y) { return x > y ? x : y; });
+}
+
+/*
+\brief Compute the minimum and maximum of an expression in a single pass.
+As ReduceMin() and ReduceMax(), an empty field gives the largest float as minimum and the lowest one as maximum.
+*/
+template<typename A, typename = typename EnableField<A>::type>
+inline void ReduceMinMax(const A& a, float& min, float& max)
+{
+	typename FieldOperand<A>::Type e = FieldOperand<A>::Make(a);
+	const int chunk = FieldAlgebra::ChunkSize;
+	int size = e.Shape()->SizeX() * e.Shape()->SizeY();
+	min = std::numeric_limits<float>::max();
+	max = -std::numeric_limits<float>::max();
+	if (size <= 0)
+		return;
+	std::vector<float> partialMin((size + chunk - 1) / chunk), partialMax(partialMin.size());
+	TaskScheduler::Global().ParallelFor(0, size, [&](int first, int last)
+	{
+		float lo = std::numeric_limits<float>::max(), hi = -std::numeric_limits<float>::max();
+		for (int i = first; i < last; i++)
+		{
+			float v = e[i];
+			lo = v < lo ? v : lo;
+			hi = v > hi ? v : hi;
+		}
+		partialMin[first / chunk] = lo;
+		partialMax[first / chunk] = hi;
+	}, chunk);
+	min = *std::min_element(partialMin.begin(), partialMin.end());
+	max = *std::max_element(partialMax.begin(), partialMax.end());
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <vector>
+
+#include "valueField.h"
+
+class FieldFilter
+{
+protected:
+	static const int StripWidth = 256;
+
+	static void WeightedSum(const float* const* rows, const float* weights, int count, float* out, int n);
+	static void ConvolveRows(const float* src, float* dst, int nx, int ny, const std::vector<float>& kernel);
+	static void ConvolveColumns(float* data, int nx, int ny, const std::vector<float>& kernel);
+	static void BoxRows(const float* src, float* dst, int nx, int ny, int r);
+	static void BoxColumns(float* data, int nx, int ny, int r);
+
+public:
+	static const int MaxMedianRadius = 7;
+
+	static void Gaussian(const ValueField<float>& field, ValueField<float>& result, float sigma);
+	static void Box(const ValueField<float>& field, ValueField<float>& result, int radius);
+	static void Bilateral(const ValueField<float>& field, ValueField<float>& result, float sigmaSpatial, float sigmaRange);
+	static void Median(const ValueField<float>& field, ValueField<float>& result, int radius);
+};
@@ -0,0 +1,22 @@
+#pragma once
+#include <vector>
+
+#include "scalarfield2D.h"
+
+class FieldPyramid
+{
+protected:
+	std::vector<ScalarField2D> levels;
+
+public:
+	FieldPyramid();
+	FieldPyramid(const ScalarField2D& field, int levelCount);
+
+	void Build(const ScalarField2D& field, int levelCount);
+	int LevelCount() const;
+	const ScalarField2D& Level(int l) const;
+	ScalarField2D& Level(int l);
+
+	static ScalarField2D Downsample(const ScalarField2D& field);
+	static ScalarField2D Upsample(const ScalarField2D& field, int nx, int ny);
+};
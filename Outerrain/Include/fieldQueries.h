@@ -0,0 +1,54 @@
+#pragma once
+#include <vector>
+
+#include "scalarfield2D.h"
+
+/*
+\brief Summed area table of a field, answering rectangle sums and means in constant time.
+*/
+class SummedAreaTable
+{
+protected:
+	int nx, ny;
+	std::vector<double> table;	// (ny + 1) x (nx + 1) sums, the first row and column are zero
+
+public:
+	SummedAreaTable();
+	SummedAreaTable(const ScalarField2D& field);
+
+	void Build(const ScalarField2D& field);
+	void Update(const ScalarField2D& field, const Vector2i& min, const Vector2i& max);
+
+	double Sum(const Vector2i& min, const Vector2i& max) const;
+	float Mean(const Vector2i& min, const Vector2i& max) const;
+};
+
+/*
+\brief Pyramid of the minimum and maximum values of a field over blocks of 2^l x 2^l cells.
+*/
+class MinMaxPyramid
+{
+protected:
+	struct Level
+	{
+		int nx, ny;
+		std::vector<float> min;
+		std::vector<float> max;
+	};
+
+	std::vector<Level> levels;
+
+	void Reduce(int l, int i0, int j0, int i1, int j1);
+	void Descend(int l, int i, int j, const Vector2i& a, const Vector2i& b, float& min, float& max) const;
+
+public:
+	MinMaxPyramid();
+	MinMaxPyramid(const ScalarField2D& field);
+
+	void Build(const ScalarField2D& field);
+	void Update(const ScalarField2D& field, const Vector2i& min, const Vector2i& max);
+
+	void Range(const Vector2i& a, const Vector2i& b, float& min, float& max) const;
+	void Bounds(const Vector2i& a, const Vector2i& b, float& min, float& max) const;
+	int LevelCount() const;
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include <vector>
+
+#include "heightfield.h"
+
+class FlowAccumulation
+{
+protected:
+	const HeightField& hf;
+	std::vector<int> receivers;
+	std::vector<float> accumulation;
+	int lastUpdateCount;
+
+	int ComputeReceiver(int i, int j) const;
+	void Propagate(int id, float delta);
+
+public:
+	FlowAccumulation(const HeightField& hf);
+
+	void Compute();
+	void Update(const Vector2i& min, const Vector2i& max);
+
+	int Receiver(int i, int j) const;
+	float Get(int i, int j) const;
+	int LastUpdateCount() const;
+	ScalarField2D DrainageArea() const;
+};
@@ -17,10 +17,17 @@ class Fractal
 public:
 	static float fBm(const Noise& n, const Vector3& point, float a, float f, int octaves);
 	static float fBm(const Noise& n, const Vector2& point, float a, float f, int octaves);
+	static void fBm(const Noise& n, const Vector2* points, float* values, int count, float a, float f, int octaves);
+	static void Evaluate(const Noise& n, FractalType type, const Vector2* points, float* values, int count, float a, float f, int octaves);
 	static float RidgeNoise(const Noise& n, const Vector3& point, float a, float f, int octaves);
+	static float RidgeNoise(const Noise& n, const Vector2& point, float a, float f, int octaves);
 
-	static float MusgravefBm(const Noise& n, Vector3 point, float H, float lacunarity, float octaves);
-	static float MusgraveHeteroTerrain(const Noise& n, Vector3 point, float H, float lacunarity, float octaves, float offset);
-	static float MusgraveHybridMultifractal(const Noise& n, Vector3 point, float H, float lacunarity, float octaves, float offset );
-	static float MusgraveRidgedMultifractal(const Noise& n, Vector3 point, float H, float lacunarity, float octaves, float offset, float gain);
+	static float MusgravefBm(const Noise& n, const Vector3& point, float H, float lacunarity, float octaves);
+	static float MusgravefBm(const Noise& n, const Vector2& point, float H, float lacunarity, float octaves);
+	static float MusgraveHeteroTerrain(const Noise& n, const Vector3& point, float H, float lacunarity, float octaves, float offset);
+	static float MusgraveHeteroTerrain(const Noise& n, const Vector2& point, float H, float lacunarity, float octaves, float offset);
+	static float MusgraveHybridMultifractal(const Noise& n, const Vector3& point, float H, float lacunarity, float octaves, float offset);
+	static float MusgraveHybridMultifractal(const Noise& n, const Vector2& point, float H, float lacunarity, float octaves, float offset);
+	static float MusgraveRidgedMultifractal(const Noise& n, const Vector3& point, float H, float lacunarity, float octaves, float offset, float gain);
+	static float MusgraveRidgedMultifractal(const Noise& n, const Vector2& point, float H, float lacunarity, float octaves, float offset, float gain);
 };
@@ -0,0 +1,86 @@
+#pragma once
+#include <vector>
+#include <type_traits>
+
+#include "alignedAllocator.h"
+
+/*
+\brief Bump allocator for the temporaries of a step, such as the row buffers of a parallel loop chunk.
+Memory is taken from chunks which are kept from one step to the next, so that temporaries cost neither
+an allocation nor page faults once the arena is warm. Every thread has its own arena, see Local().
+Allocations are aligned on cache lines, their values are unspecified, and they are only freed all at once
+by rewinding the arena, usually with a FrameArena::Scope.
+*/
+class FrameArena
+{
+protected:
+	struct Chunk
+	{
+		char* data;
+		size_t size;
+	};
+
+	std::vector<Chunk> chunks;
+	size_t current;			// Chunk being filled
+	size_t offset;			// First free byte of the current chunk
+
+	void* AllocateBytes(size_t bytes);
+
+public:
+	static const size_t ChunkSize = size_t(1) << 20;
+
+	/*
+	\brief Position in an arena, to rewind to.
+	*/
+	struct Marker
+	{
+		size_t chunk;
+		size_t offset;
+	};
+
+	/*
+	\brief Rewind an arena to its position at construction when leaving a scope.
+	*/
+	class Scope
+	{
+	protected:
+		FrameArena& arena;
+		Marker marker;
+
+	public:
+		Scope(FrameArena& arena = FrameArena::Local()) : arena(arena), marker(arena.Mark())
+		{
+		}
+
+		~Scope()
+		{
+			arena.Rewind(marker);
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	};
+
+	FrameArena();
+	~FrameArena();
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	static FrameArena& Local();
+
+	/*
+	\brief Get an array of count values, whose values are unspecified.
+	*/
+	template<typename T>
+	T* Allocate(size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Arena values are never destroyed");
+		return static_cast<T*>(AllocateBytes(count * sizeof(T)));
+	}
+
+	Marker Mark() const;
+	void Rewind(const Marker& marker);
+	void Reset();
+	void Release();
+	size_t Capacity() const;
+};
@@ -6,30 +6,113 @@
 #include "fractal.h"
 #include "terrainSettings.h"
 #include "frame.h"
+#include "activeCells.h"
+
+class FlowAccumulation;
+
+/*
+\brief Stencil kernel of thermal weathering : the steepest lower neighbour of a cell, if steeper than the talus angle.
+Neighbour (k, l) is coded (k + 1) * 3 + (l + 1), the cell itself meaning no transfer.
+*/
+class ThermalTargetKernel
+{
+private:
+	float threshold;
+
+public:
+	static const char None = 4;
+
+	ThermalTargetKernel(float threshold) : threshold(threshold)
+	{
+	}
+
+	template<typename Neighbourhood>
+	char operator()(const Neighbourhood& n, int, int) const
+	{
+		float maxZDiff = 0.0f;
+		char code = None;
+		for (int k = -1; k <= 1; k++)
+		{
+			for (int l = -1; l <= 1; l++)
+			{
+				float z = n(0, 0) - n(k, l);
+				if (n.Inside(k, l) && z > maxZDiff)
+				{
+					maxZDiff = z;
+					code = char((k + 1) * 3 + (l + 1));
+				}
+			}
+		}
+		return maxZDiff > threshold ? code : None;
+	}
+};
+
+/*
+\brief Stencil kernel of thermal weathering over the targets given by ThermalTargetKernel : the height change of a cell,
+which gives matter if it has a target and receives matter from the neighbours targeting it.
+*/
+class ThermalTransferKernel
+{
+private:
+	float amplitude;
+
+public:
+	ThermalTransferKernel(float amplitude) : amplitude(amplitude)
+	{
+	}
+
+	template<typename Neighbourhood>
+	float operator()(const Neighbourhood& n, int, int) const
+	{
+		float dh = (n(0, 0) != ThermalTargetKernel::None) ? -amplitude : 0.0f;
+		for (int k = -1; k <= 1; k++)
+		{
+			for (int l = -1; l <= 1; l++)
+			{
+				if ((k != 0 || l != 0) && n.Inside(k, l) && n(k, l) == char((1 - k) * 3 + (1 - l)))
+					dh += amplitude;
+			}
+		}
+		return dh;
+	}
+};
 
 class HeightField : public ScalarField2D
 {
+protected:
+	int DenseThermalWeathering(float amplitude, float tanThresholdAngle, ActiveCells* active);
+
 public:
 	HeightField();
 	HeightField(const TerrainSettings& settings);
 	HeightField(int nx, int ny, const Box2D& bbox);
 	HeightField(int nx, int ny, const Box2D& bbox, float value);
+	HeightField(int nx, int ny, const Box2D& bbox, float value, FieldAllocation allocation);
 	HeightField(const std::string& filePath, float minAltitude, float maxAltitude, int nx, int ny, const Box2D& bbox);
 	HeightField(int nx, int ny, const Box2D& bbox, const Noise& n, float amplitude, float freq, int oct, FractalType type);
 	HeightField(int nx, int ny, const Box2D& bbox, const Noise& n, float amplitude, float freq, int oct, const Vector3& offset, FractalType type);
+	HeightField(const HeightField& hf);
+	HeightField(HeightField&& hf);
 	~HeightField();
 
+	HeightField& operator=(const HeightField& hf);
+	HeightField& operator=(HeightField&& hf);
+
 	void InitFromNoise(const Noise& n, float amplitude, float freq, int oct, const Vector3& offset, FractalType type);
 
 	virtual void ThermalWeathering(float amplitude, float tanThresholdAngle = 0.6f);
+	int SparseThermalWeathering(float amplitude, float tanThresholdAngle, ActiveCells& active);
+	int ThermalWeatheringUntilStable(float amplitude, float tanThresholdAngle, int maxSteps, std::vector<int>* activeCounts = nullptr);
 	virtual void StreamPowerErosion(float amplitude);
 	virtual void HydraulicErosion();
 
 	ScalarField2D DrainageArea() const;
 	ScalarField2D Wetness() const;
+	ScalarField2D Wetness(const FlowAccumulation& flow) const;
 	ScalarField2D StreamPower() const;
+	ScalarField2D StreamPower(const FlowAccumulation& flow) const;
 	ScalarField2D Slope() const;
-	ScalarField2D Illumination() const;
+	ScalarField2D Illumination(unsigned int seed = 0) const;
 
 	bool Intersect(const Ray& ray, Hit& hit, float K) const;
 	bool Intersect(const Ray& ray, Hit& hit) const;
@@ -0,0 +1,19 @@
+#pragma once
+#include <string>
+
+#include "valueField.h"
+
+class ScalarField2D;
+
+class HeightmapImporter
+{
+protected:
+	static bool LoadPGM(const std::string& filePath, ValueField<float>& image);
+	static bool LoadPFM(const std::string& filePath, ValueField<float>& image);
+	static bool LoadRAW(const std::string& filePath, int bytesPerSample, ValueField<float>& image);
+	static bool LoadSDL(const std::string& filePath, ValueField<float>& image);
+
+public:
+	static bool Load(const std::string& filePath, ValueField<float>& image);
+	static void Resample(const ValueField<float>& image, ScalarField2D& field, float blackValue, float whiteValue);
+};
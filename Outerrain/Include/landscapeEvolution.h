@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+
+#include "heightfield.h"
+
+class LandscapeEvolution
+{
+protected:
+	HeightField& hf;
+	ScalarField2D uplift;
+
+	float erodibility;
+	float areaExponent;
+	float slopeExponent;
+	float diffusion;
+
+	std::vector<int> receivers;
+	std::vector<float> receiverDistance;
+	std::vector<int> donorOffset;
+	std::vector<int> donors;
+	std::vector<int> stack;
+	std::vector<float> area;
+	std::vector<float> thomasFactor;
+	std::vector<float> thomasInverse;
+
+	void ApplyUplift(float dt);
+	void ComputeReceivers();
+	void ComputeStack();
+	void ComputeDrainageArea();
+	void StreamPowerStep(float dt);
+	void DiffusionStep(float dt);
+	void PrepareThomas(int n, float r);
+
+public:
+	LandscapeEvolution(HeightField& hf, float uplift = 5.0e-4f, float k = 2.0e-5f, float m = 0.5f, float n = 1.0f, float kd = 0.01f);
+
+	void SetUplift(float u);
+	void SetUplift(const ScalarField2D& u);
+	void SetStreamPower(float k, float m, float n);
+	void SetDiffusion(float kd);
+
+	void FillDepressions(float epsilon = 1.0e-3f);
+	void Step(float dt);
+	void Simulate(float duration, float dt);
+
+	ScalarField2D DrainageArea() const;
+	const std::vector<int>& Receivers() const;
+	const std::vector<int>& Stack() const;
+};
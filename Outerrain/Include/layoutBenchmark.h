@@ -0,0 +1,20 @@
+#pragma once
+
+#include "heightfield.h"
+#include "tiledField.h"
+
+/*
+\brief Timings of the stencil passes of the terrains over the field layouts : row major ValueField,
+and TiledField with tiles in row order or in Morton order.
+*/
+class LayoutBenchmark
+{
+protected:
+	static double Gradient(const HeightField& hf, int repeat);
+	static double Gradient(const HeightField& hf, FieldLayout layout, int repeat);
+	static double Thermal(const HeightField& hf, int steps);
+	static double Thermal(const HeightField& hf, FieldLayout layout, int steps);
+
+public:
+	static void PrintTimes(int n = 4096, int repeat = 5, int steps = 10);
+};
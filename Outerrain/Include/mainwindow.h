@@ -10,6 +10,9 @@
 #include "app-stats.h"
 #include "light.h"
 #include "scene-hierarchy.h"
+#include "terrainStreamer.h"
+#include "erosionWorker.h"
+#include "terrainNodes.h"
 
 class MainWindow
 {
@@ -22,6 +25,11 @@ private:
 	SceneHierarchy hierarchy;
 	HeightField* hf;
 	TerrainSettings settings;
+	TerrainStreamer* streamer;
+	ErosionWorker* erosion;
+	unsigned int erosionVersion;
+	TerrainGraph* graph;
+	BlendNode* graphRidges;
 
 	/* Example scenes */
 	void AddCube(const Vector3& p = Vector3(0), float s = 1.0);
@@ -29,6 +37,8 @@ private:
 	void Heightfield2Scene();
 	void NoiseField1Scene();
 	void NoiseField2Scene();
+	void GraphScene();
+	void UpdateGraphTerrain();
 
 	/* Functions */
 	void InitBasicTerrain();
@@ -39,6 +49,10 @@ private:
 	void StreamPowerErosionStep();
 	void HydraulicErosionStep();
 	void ThermalErosionStep();
+	void RunErosion(ErosionType type, int stepCount);
+	void UpdateErosion();
+	void StopErosion();
+	void UpdateStreamer();
 	void TranslateNoise(int, int);
 
 	void GenerateTerrainFromSettings(bool gpu = false);
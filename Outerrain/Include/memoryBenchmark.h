@@ -0,0 +1,18 @@
+#pragma once
+
+#include "valueField.h"
+#include "taskScheduler.h"
+
+/*
+\brief Bandwidth measures of the banded loops over large fields, to check the scaling of the simulations across
+cores and NUMA nodes, with fields first touched by the calling thread or by bands, see FieldAllocation.
+*/
+class MemoryBenchmark
+{
+protected:
+	static void FirstTouch(TaskScheduler& scheduler, float* data, int nx, int ny, float value, FieldAllocation allocation);
+
+public:
+	static double Bandwidth(TaskScheduler& scheduler, int nx, int ny, FieldAllocation allocation, int repeat = 10);
+	static void PrintScaling(int n = 8192, int repeat = 10);
+};
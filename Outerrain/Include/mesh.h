@@ -8,17 +8,23 @@
 #include "component.h"
 #include "vec.h"
 #include "box.h"
+#include "alignedAllocator.h"
 
 class Mesh : public Component
 {
 	friend class MeshRenderer;
 	friend class MeshSetRenderer;
 
+public:
+	typedef AlignedVector<Vector3, MemoryMesh> Vector3Buffer;
+	typedef AlignedVector<Vector2, MemoryMesh> Vector2Buffer;
+	typedef AlignedVector<unsigned int, MemoryMesh> IndexBuffer;
+
 protected:
-	std::vector<Vector3> vertices;
-	std::vector<Vector3> normals;
-	std::vector<Vector2> texcoords;
-	std::vector<unsigned int> indices;
+	Vector3Buffer vertices;
+	Vector3Buffer normals;
+	Vector2Buffer texcoords;
+	IndexBuffer indices;
 
 	bool isDirty;
 
@@ -30,14 +36,15 @@ public:
 	void AddNormal(const Vector3&);
 	void AddTriangle(unsigned int, unsigned int, unsigned int);
 	void AddTexcoord(const Vector2&);
+	void Reserve(size_t vertexCount, size_t triangleCount, bool withNormals = true, bool withTexcoords = true);
 
 	Box GetBounds() const;
 	bool LoadObj(const std::string& path);
 	void ClearBuffers();
 	void PrintInfos();
 
-	std::vector<Vector3> Normals() const { return normals; }
-	std::vector<Vector3> Vertices() const { return vertices; }
+	const Vector3Buffer& Normals() const { return normals; }
+	const Vector3Buffer& Vertices() const { return vertices; }
 
 	size_t VertexCount() const { return vertices.size(); }
 	size_t NormalCount() const { return normals.size(); }
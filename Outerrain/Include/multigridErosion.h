@@ -0,0 +1,27 @@
+#pragma once
+#include "heightfield.h"
+#include "erosionType.h"
+#include "fieldPyramid.h"
+
+class MultigridErosion
+{
+protected:
+	ErosionType type;
+	int levelCount;
+	int coarseSteps;
+	int fineSteps;
+	float amplitude;
+	float tanThresholdAngle;
+	float dt;
+
+	void Erode(HeightField& hf, int steps, float scale) const;
+
+public:
+	MultigridErosion(ErosionType type, int levelCount = 4, int coarseSteps = 256, int fineSteps = 16);
+
+	void SetThermal(float amplitude, float tanThresholdAngle);
+	void SetStreamPower(float dt);
+
+	int StepCount(int level, int count) const;
+	void Run(HeightField& hf) const;
+};
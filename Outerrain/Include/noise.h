@@ -1,4 +1,6 @@
 #pragma once
+#include <algorithm>
+
 #include "vec.h"
 
 /* Abstract */
@@ -9,6 +11,75 @@ public:
 	virtual ~Noise() { }
 	virtual float GetValue(const Vector2&) const = 0;
 	virtual float GetValue(const Vector3&) const = 0;
+
+	virtual void GetValues(const Vector2* points, float* values, int count) const
+	{
+		for (int i = 0; i < count; i++)
+			values[i] = GetValue(points[i]);
+	}
+
+	virtual void GetValues(const Vector3* points, float* values, int count) const
+	{
+		for (int i = 0; i < count; i++)
+			values[i] = GetValue(points[i]);
+	}
+
+protected:
+	static const int BatchSize = 64;
+
+	static void InitPermutation(unsigned int seed, int* perm);
+
+	/*
+	\brief Round down to an integer. Unlike int(floorf(x)), the conversion is vectorized by the compiler.
+	*/
+	static inline int FastFloor(float x)
+	{
+		int i = int(x);
+		return i - (x < float(i) ? 1 : 0);
+	}
+
+	/*
+	\brief Evaluate an array of points by blocks of BatchSize points, internal function.
+	The coordinates of a block are copied to separate arrays, and kernel(x, y, r, n) writes the n values of the block
+	to a local array r which cannot alias the tables of the noise, so that its loop over the block vectorizes.
+	*/
+	template<typename Kernel>
+	static void Batch(const Vector2* points, float* values, int count, const Kernel& kernel)
+	{
+		float x[BatchSize], y[BatchSize], r[BatchSize];
+		for (int first = 0; first < count; first += BatchSize)
+		{
+			int n = count - first < BatchSize ? count - first : BatchSize;
+			for (int k = 0; k < n; k++)
+			{
+				x[k] = points[first + k].x;
+				y[k] = points[first + k].y;
+			}
+			kernel(x, y, r, n);
+			std::copy(r, r + n, values + first);
+		}
+	}
+
+	/*
+	\brief Evaluate an array of points by blocks, with kernel(x, y, z, r, n), internal function.
+	*/
+	template<typename Kernel>
+	static void Batch(const Vector3* points, float* values, int count, const Kernel& kernel)
+	{
+		float x[BatchSize], y[BatchSize], z[BatchSize], r[BatchSize];
+		for (int first = 0; first < count; first += BatchSize)
+		{
+			int n = count - first < BatchSize ? count - first : BatchSize;
+			for (int k = 0; k < n; k++)
+			{
+				x[k] = points[first + k].x;
+				y[k] = points[first + k].y;
+				z[k] = points[first + k].z;
+			}
+			kernel(x, y, z, r, n);
+			std::copy(r, r + n, values + first);
+		}
+	}
 };
 
 /* Perlin Noise */
@@ -23,9 +94,67 @@ private:
 	float At(const Vector3&) const;
 
 public:
-	PerlinNoise();
+	PerlinNoise(unsigned int seed = 0);
 	~PerlinNoise();
 
 	float GetValue(const Vector2&) const;
 	float GetValue(const Vector3&) const;
 };
+
+/* Simplex Noise */
+class SimplexNoise : public Noise
+{
+private:
+	int perm[512];
+
+	float At(float x, float y) const;
+	void At(const float* x, const float* y, const float* z, float* values, int count) const;
+
+public:
+	SimplexNoise(unsigned int seed = 0);
+
+	float GetValue(const Vector2&) const;
+	float GetValue(const Vector3&) const;
+	void GetValues(const Vector2* points, float* values, int count) const;
+	void GetValues(const Vector3* points, float* values, int count) const;
+};
+
+/* Value Noise */
+class ValueNoise : public Noise
+{
+private:
+	int perm[512];
+	float lattice[256];
+
+	float At(float x, float y) const;
+	float At(float x, float y, float z) const;
+
+public:
+	ValueNoise(unsigned int seed = 0);
+
+	float GetValue(const Vector2&) const;
+	float GetValue(const Vector3&) const;
+	void GetValues(const Vector2* points, float* values, int count) const;
+	void GetValues(const Vector3* points, float* values, int count) const;
+};
+
+/* Cellular (Worley) Noise */
+class CellularNoise : public Noise
+{
+private:
+	int perm[512];
+	float jitterX[256];
+	float jitterY[256];
+	float jitterZ[256];
+
+	float At(float x, float y) const;
+	float At(float x, float y, float z) const;
+
+public:
+	CellularNoise(unsigned int seed = 0);
+
+	float GetValue(const Vector2&) const;
+	float GetValue(const Vector3&) const;
+	void GetValues(const Vector2* points, float* values, int count) const;
+	void GetValues(const Vector3* points, float* values, int count) const;
+};
@@ -0,0 +1,312 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#include "valueField.h"
+#include "taskScheduler.h"
+
+/*
+\brief Storage policy of a PackedField : heights as IEEE 754 half precision floats, 2 bytes per cell.
+Relative precision is about 1e-3, values beyond 65504 become infinite.
+Conversions have no branches and only use integer arithmetic, so that loops over cells vectorize.
+*/
+class HalfStorage
+{
+public:
+	typedef float Value;
+	typedef uint16_t Packed;
+
+	/*
+	\brief Convert a float to half precision, rounding to the nearest even value.
+	Overflows give infinities, NaNs are kept, small values give denormals.
+	*/
+	Packed Encode(float v) const
+	{
+		uint32_t x;
+		memcpy(&x, &v, sizeof(x));
+		uint32_t sign = (x >> 16) & 0x8000u;
+		x &= 0x7FFFFFFFu;
+
+		// Normal halves : rebias the exponent and round the 13 dropped mantissa bits
+		uint32_t normal = (x - ((127u - 15u) << 23) + 0x0FFFu + ((x >> 13) & 1u)) >> 13;
+
+		// Denormal halves : adding 0.5 aligns the mantissa, the float addition rounds it
+		float shifted;
+		memcpy(&shifted, &x, sizeof(shifted));
+		shifted += 0.5f;
+		uint32_t denormal;
+		memcpy(&denormal, &shifted, sizeof(denormal));
+		denormal -= 126u << 23;
+
+		uint32_t special = x > 0x7F800000u ? 0x7E00u : 0x7C00u;
+		uint32_t h = x >= (143u << 23) ? special : x < (113u << 23) ? denormal : normal;
+		return Packed(h | sign);
+	}
+
+	/*
+	\brief Convert a half precision float to a float, exactly.
+	*/
+	float Decode(Packed h) const
+	{
+		uint32_t x = uint32_t(h & 0x7FFFu) << 13;
+		uint32_t exponent = x & (0x7C00u << 13);
+		uint32_t normal = x + ((127u - 15u) << 23);
+
+		// Infinities and NaNs keep their maximal exponent
+		uint32_t special = normal + ((128u - 16u) << 23);
+
+		// Denormals are renormalized by a float subtraction
+		uint32_t bits = normal + (1u << 23);
+		float f;
+		memcpy(&f, &bits, sizeof(f));
+		f -= 6.103515625e-05f;
+		uint32_t denormal;
+		memcpy(&denormal, &f, sizeof(denormal));
+
+		uint32_t r = exponent == (0x7C00u << 13) ? special : exponent == 0 ? denormal : normal;
+		r |= uint32_t(h & 0x8000u) << 16;
+		float v;
+		memcpy(&v, &r, sizeof(v));
+		return v;
+	}
+};
+
+/*
+\brief Storage policy of a PackedField : heights quantized on 16 bits over a fixed range, 2 bytes per cell.
+The absolute error is uniform, at most half of a step of (max - min) / 65535 : 1.5 cm over 2000 m.
+Values outside of the range are clamped.
+*/
+class QuantizedStorage
+{
+protected:
+	float offset;
+	float scale;
+	float invScale;
+
+public:
+	typedef float Value;
+	typedef uint16_t Packed;
+
+	QuantizedStorage(float min = 0.0f, float max = 1.0f) : offset(min), scale((max - min) / 65535.0f), invScale(max > min ? 65535.0f / (max - min) : 0.0f)
+	{
+	}
+
+	/*
+	\brief Create the storage covering the range of a field.
+	*/
+	static QuantizedStorage Range(const ValueField<float>& field)
+	{
+		return QuantizedStorage(field.Min(), field.Max());
+	}
+
+	Packed Encode(float v) const
+	{
+		float q = Math::Clamp((v - offset) * invScale, 0.0f, 65535.0f);
+		return Packed(int(q + 0.5f));
+	}
+
+	float Decode(Packed q) const
+	{
+		return offset + float(q) * scale;
+	}
+};
+
+/*
+\brief Storage policy of a PackedField : unit vectors such as normals, octahedral encoded on 2 x 16 bits, 4 bytes per cell
+instead of 12. The sphere is projected on the octahedron |x| + |y| + |z| = 1, whose lower half is folded over the upper one,
+so the y axis of heightfield normals gets the unfolded part. The angular error is below 0.05 degree.
+*/
+class OctahedralStorage
+{
+protected:
+	static float SignNotZero(float v)
+	{
+		return v >= 0.0f ? 1.0f : -1.0f;
+	}
+
+public:
+	typedef Vector3 Value;
+	typedef uint32_t Packed;
+
+	Packed Encode(const Vector3& n) const
+	{
+		// Null vectors are stored as the up vector
+		float inv = 1.0f / Math::Max(fabsf(n.x) + fabsf(n.y) + fabsf(n.z), 1e-30f);
+		float u = n.x * inv;
+		float v = n.z * inv;
+		float fu = (1.0f - fabsf(v)) * SignNotZero(u);
+		float fv = (1.0f - fabsf(u)) * SignNotZero(v);
+		u = n.y < 0.0f ? fu : u;
+		v = n.y < 0.0f ? fv : v;
+		int32_t a = int32_t(floorf(Math::Clamp(u, -1.0f, 1.0f) * 32767.0f + 0.5f));
+		int32_t b = int32_t(floorf(Math::Clamp(v, -1.0f, 1.0f) * 32767.0f + 0.5f));
+		return (uint32_t(a) & 0xFFFFu) | (uint32_t(b) << 16);
+	}
+
+	Vector3 Decode(Packed p) const
+	{
+		float u = float(int16_t(p & 0xFFFFu)) / 32767.0f;
+		float v = float(int16_t(p >> 16)) / 32767.0f;
+		float y = 1.0f - fabsf(u) - fabsf(v);
+		float t = Math::Max(-y, 0.0f);
+		u += u >= 0.0f ? -t : t;
+		v += v >= 0.0f ? -t : t;
+		return Normalize(Vector3(u, y, v));
+	}
+};
+
+/*
+\brief Field with the geometry of a ValueField, whose values are stored compressed by a storage policy :
+HalfStorage or QuantizedStorage for heights, OctahedralStorage for normals.
+Values are converted on every access. Whole fields or runs of cells should be converted with the batch functions,
+whose loops vectorize, or unpacked to a ValueField for heavy processing.
+*/
+template<typename Storage>
+class PackedField
+{
+public:
+	typedef typename Storage::Value Value;
+	typedef typename Storage::Packed Packed;
+
+protected:
+	int nx, ny;
+	Box2D box;
+	Storage storage;
+	AlignedVector<Packed, MemoryFields> values;
+
+public:
+	PackedField() : nx(0), ny(0), box(Vector2(0), Vector2(0))
+	{
+	}
+
+	PackedField(int nx, int ny, const Box2D& bbox, const Storage& storage = Storage()) : nx(nx), ny(ny), box(bbox), storage(storage)
+	{
+		values.resize(nx * ny, storage.Encode(Value(0)));
+	}
+
+	PackedField(const ValueField<Value>& field, const Storage& storage = Storage()) : nx(field.SizeX()), ny(field.SizeY()), box(field.GetBox()), storage(storage)
+	{
+		values.resize(nx * ny);
+		Encode(field);
+	}
+
+	/*
+	\brief Compress a field with the same resolution, rows in parallel.
+	*/
+	void Encode(const ValueField<Value>& field)
+	{
+		const Value* src = field.Data();
+		TaskScheduler::Global().ParallelFor(0, ny, [&](int first, int last)
+		{
+			Encode(src + first * nx, first * nx, (last - first) * nx);
+		});
+	}
+
+	/*
+	\brief Decompress the field into a field with the same resolution, rows in parallel.
+	*/
+	void Decode(ValueField<Value>& field) const
+	{
+		Value* dst = field.Data();
+		TaskScheduler::Global().ParallelFor(0, ny, [&](int first, int last)
+		{
+			Decode(first * nx, (last - first) * nx, dst + first * nx);
+		});
+	}
+
+	/*
+	\brief Compress a run of cells.
+	\param src values
+	\param index first cell
+	\param count cell count
+	*/
+	void Encode(const Value* src, int index, int count)
+	{
+		Packed* dst = values.data() + index;
+		for (int k = 0; k < count; k++)
+			dst[k] = storage.Encode(src[k]);
+	}
+
+	/*
+	\brief Decompress a run of cells.
+	\param index first cell
+	\param count cell count
+	\param dst returned values
+	*/
+	void Decode(int index, int count, Value* dst) const
+	{
+		const Packed* src = values.data() + index;
+		for (int k = 0; k < count; k++)
+			dst[k] = storage.Decode(src[k]);
+	}
+
+	/*
+	\brief Decompress the whole field.
+	*/
+	ValueField<Value> Unpacked() const
+	{
+		ValueField<Value> field(nx, ny, box);
+		Decode(field);
+		return field;
+	}
+
+	int ToIndex1D(int i, int j) const
+	{
+		return i * nx + j;
+	}
+
+	Value Get(int row, int column) const
+	{
+		return storage.Decode(values[ToIndex1D(row, column)]);
+	}
+
+	Value Get(int index) const
+	{
+		return storage.Decode(values[index]);
+	}
+
+	void Set(int row, int column, const Value& v)
+	{
+		values[ToIndex1D(row, column)] = storage.Encode(v);
+	}
+
+	void Set(int index, const Value& v)
+	{
+		values[index] = storage.Encode(v);
+	}
+
+	const Packed* Data() const
+	{
+		return values.data();
+	}
+
+	const Storage& GetStorage() const
+	{
+		return storage;
+	}
+
+	/*
+	\brief Get the memory used by the values, in bytes.
+	*/
+	size_t MemorySize() const
+	{
+		return values.size() * sizeof(Packed);
+	}
+
+	int SizeX() const
+	{
+		return nx;
+	}
+
+	int SizeY() const
+	{
+		return ny;
+	}
+
+	Box2D GetBox() const
+	{
+		return box;
+	}
+};
@@ -8,13 +8,14 @@ protected:
 	int r;
 	float tileSize;
 	int maxTries;
+	unsigned int seed;
 	std::vector<Vector2> poissonPoints;
 
 	void Generate();
 
 public:
 	PoissonTile2D();
-	PoissonTile2D(int r, float tileSize, int maxTries);
+	PoissonTile2D(int r, float tileSize, int maxTries, unsigned int seed = 0);
 
 	void Randomize();
 	std::vector<Vector2> GetPoints() const;
@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+
+/*
+\brief Subsystems owning their own random streams. Two subsystems using the same seed
+and index never share numbers.
+*/
+enum class RandomSubsystem
+{
+	Noise = 0,
+	Poisson = 1,
+	Illumination = 2,
+	Erosion = 3,
+	Terrain = 4
+};
+
+/*
+\brief Counter based random number generator, in the spirit of SplitMix64.
+The n-th number of a stream is a pure hash of (seed, subsystem, index, n) : there is no shared state,
+so each thread, tile or cell can own an independent stream and results do not depend on scheduling.
+*/
+class RandomStream
+{
+private:
+	uint64_t key;
+	uint64_t counter;
+
+public:
+	RandomStream(uint64_t seed, RandomSubsystem subsystem, uint64_t index = 0) : counter(0)
+	{
+		key = Hash(seed, subsystem, index);
+	}
+
+	/*
+	\brief SplitMix64 finalizer : bijective 64 bits avalanche mix.
+	*/
+	static inline uint64_t Mix(uint64_t z)
+	{
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	/*
+	\brief Stateless hash of a stream key, used directly when only one number is needed per index.
+	*/
+	static inline uint64_t Hash(uint64_t seed, RandomSubsystem subsystem, uint64_t index)
+	{
+		return Mix(Mix(Mix(seed) ^ (uint64_t(subsystem) + 0x9E3779B97F4A7C15ull)) + index);
+	}
+
+	/*
+	\brief Jump to the n-th number of the stream.
+	*/
+	void Seek(uint64_t n)
+	{
+		counter = n;
+	}
+
+	uint64_t NextUInt64()
+	{
+		counter++;
+		return Mix(key + counter * 0x9E3779B97F4A7C15ull);
+	}
+
+	uint32_t NextUInt()
+	{
+		return uint32_t(NextUInt64() >> 32);
+	}
+
+	/*
+	\brief Uniform float in [0, 1).
+	*/
+	float NextFloat()
+	{
+		return float(NextUInt64() >> 40) * (1.0f / 16777216.0f);
+	}
+
+	/*
+	\brief Uniform float in [a, b).
+	*/
+	float Uniform(float a, float b)
+	{
+		return a + (b - a) * NextFloat();
+	}
+
+	/*
+	\brief Uniform integer in [0, n).
+	*/
+	int Range(int n)
+	{
+		return int((uint64_t(NextUInt()) * uint64_t(n)) >> 32);
+	}
+};
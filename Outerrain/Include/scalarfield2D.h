@@ -2,6 +2,8 @@
 
 #include "GL/glew.h"
 #include "valueField.h"
+#include "stencil.h"
+#include "fieldExpression.h"
 
 typedef struct ScalarValue
 {
@@ -11,16 +13,73 @@ typedef struct ScalarValue
 	ScalarValue(int a, int b, float h) : x(a), y(b), value(h) { }
 } ScalarValue;
 
+/*
+\brief Stencil kernel of the gradient : central differences, one sided at the border of the field.
+*/
+class GradientKernel
+{
+private:
+	float invCellX, invCellY;
+
+public:
+	GradientKernel(const Vector2& cellSize) : invCellX(1.0f / cellSize.x), invCellY(1.0f / cellSize.y)
+	{
+	}
+
+	template<typename Neighbourhood>
+	Vector2 operator()(const Neighbourhood& n, int, int) const
+	{
+		int ia = n.Inside(-1, 0) ? -1 : 0, ib = n.Inside(1, 0) ? 1 : 0;
+		int ja = n.Inside(0, -1) ? -1 : 0, jb = n.Inside(0, 1) ? 1 : 0;
+		return Vector2((n(ib, 0) - n(ia, 0)) * invCellX / float(ib - ia), (n(0, jb) - n(0, ja)) * invCellY / float(jb - ja));
+	}
+};
+
 class ScalarField2D : public ValueField<float>
 {
 public:
 	ScalarField2D();
 	ScalarField2D(const std::string& filePath, float blackAltitude, float whiteAltitude, int nx, int ny, const Box2D& bbox);
 	ScalarField2D(const ScalarField2D& field);
+	ScalarField2D(ScalarField2D&& field);
 	ScalarField2D(int nx, int ny, const Box2D& bbox);
 	ScalarField2D(int nx, int ny, const Box2D& bbox, float value);
+	ScalarField2D(int nx, int ny, const Box2D& bbox, float value, FieldAllocation allocation);
+	ScalarField2D(int nx, int ny, const Box2D& bbox, Buffer&& buffer);
 	~ScalarField2D();
 
+	ScalarField2D& operator=(const ScalarField2D& field);
+	ScalarField2D& operator=(ScalarField2D&& field);
+
+	/*
+	\brief Constructor from a field expression, evaluated in a single fused pass.
+	*/
+	template<typename E>
+	ScalarField2D(const FieldExpression<E>& e) : ValueField(e.Self().Shape()->SizeX(), e.Self().Shape()->SizeY(), e.Self().Shape()->GetBox())
+	{
+		FieldAlgebra::Evaluate(e.Self(), values.data(), nx * ny);
+	}
+
+	/*
+	\brief Assign a field expression, evaluated in a single fused pass. The expression may read this field.
+	*/
+	template<typename E>
+	ScalarField2D& operator=(const FieldExpression<E>& e)
+	{
+		const ValueField<float>* shape = e.Self().Shape();
+		if (shape->SizeX() != nx || shape->SizeY() != ny)
+		{
+			ScalarField2D ret(e);
+			nx = ret.nx;
+			ny = ret.ny;
+			box = ret.box;
+			values.swap(ret.values);
+			return *this;
+		}
+		FieldAlgebra::Evaluate(e.Self(), values.data(), nx * ny);
+		return *this;
+	}
+
 	void Add(int i, int j, float v);
 	void Remove(int i, int j, float v);
 
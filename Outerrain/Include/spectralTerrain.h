@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+
+#include "heightfield.h"
+
+class SpectralTerrain
+{
+protected:
+	static void Spectrum(const HeightField& hf, float beta, uint64_t seed, float anisotropy, float angle, float* re, float* im);
+
+public:
+	static HeightField Generate(int nx, int ny, const Box2D& box, float amplitude, float beta, uint64_t seed, float anisotropy = 0.0f, float angle = 0.0f);
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#include "valueField.h"
+#include "tiledField.h"
+#include "taskScheduler.h"
+#include "frameArena.h"
+
+/*
+\brief Neighbourhood of a cell whose whole stencil lies inside the field.
+Inside() is always true and access is a plain offset, so that kernels compile to branch-free code.
+*/
+template<typename T>
+class InteriorNeighbourhood
+{
+private:
+	const T* center;
+	int stride;
+
+public:
+	InteriorNeighbourhood(const T* center, int stride) : center(center), stride(stride)
+	{
+	}
+
+	bool Inside(int, int) const
+	{
+		return true;
+	}
+
+	T operator()(int k, int l) const
+	{
+		return center[k * stride + l];
+	}
+};
+
+/*
+\brief Neighbourhood of a cell close to the field border.
+Inside() tells whether a neighbour exists, and access is clamped to the border.
+*/
+template<typename T>
+class BorderNeighbourhood
+{
+private:
+	const T* data;
+	int nx, ny;
+	int i, j;
+
+public:
+	BorderNeighbourhood(const T* data, int nx, int ny, int i, int j) : data(data), nx(nx), ny(ny), i(i), j(j)
+	{
+	}
+
+	bool Inside(int k, int l) const
+	{
+		return i + k >= 0 && i + k < ny && j + l >= 0 && j + l < nx;
+	}
+
+	T operator()(int k, int l) const
+	{
+		int a = Math::Min(Math::Max(i + k, 0), ny - 1);
+		int b = Math::Min(Math::Max(j + l, 0), nx - 1);
+		return data[a * nx + b];
+	}
+};
+
+/*
+\brief Neighbourhood of a cell in a row major copy of a block of cells, whose border values are clamped.
+Access is a plain offset, Inside() tells whether a neighbour exists in the field.
+*/
+template<typename T>
+class BlockNeighbourhood
+{
+private:
+	const T* center;
+	int stride;
+	int nx, ny;
+	int i, j;
+
+public:
+	BlockNeighbourhood(const T* center, int stride, int nx, int ny, int i, int j) : center(center), stride(stride), nx(nx), ny(ny), i(i), j(j)
+	{
+	}
+
+	bool Inside(int k, int l) const
+	{
+		return i + k >= 0 && i + k < ny && j + l >= 0 && j + l < nx;
+	}
+
+	T operator()(int k, int l) const
+	{
+		return center[k * stride + l];
+	}
+};
+
+/*
+\brief Tiled stencil evaluation over a ValueField.
+The field is split in square tiles which are dispatched to the global task scheduler. Inside a tile, cells
+farther than the stencil radius from the field border get an InteriorNeighbourhood, the remaining halo
+cells get a BorderNeighbourhood : kernels are generic over the neighbourhood type and written only once,
+with the interior instantiation free of bound checks so that the compiler can vectorize it.
+Kernels must only read the source field, writes go to distinct cells of other fields.
+*/
+class Stencil
+{
+public:
+	static const int DefaultTileSize = 64;
+
+	/*
+	\brief Call kernel(n, i, j) for every cell, n being the neighbourhood of cell (i, j).
+	\param field source field
+	\param radius stencil radius, in cells
+	\param kernel generic callable
+	\param tileSize tile side, in cells
+	*/
+	template<typename T, typename Kernel>
+	static void ForEach(const ValueField<T>& field, int radius, const Kernel& kernel, int tileSize = DefaultTileSize)
+	{
+		const T* data = field.Data();
+		int nx = field.SizeX();
+		int ny = field.SizeY();
+		TaskScheduler::Global().ParallelFor2D(0, ny, 0, nx, [&](int i0, int i1, int j0, int j1)
+		{
+			int interiorJ0 = Math::Min(Math::Max(j0, radius), j1);
+			int interiorJ1 = Math::Max(Math::Min(j1, nx - radius), interiorJ0);
+			for (int i = i0; i < i1; i++)
+			{
+				if (i < radius || i >= ny - radius)
+				{
+					for (int j = j0; j < j1; j++)
+						kernel(BorderNeighbourhood<T>(data, nx, ny, i, j), i, j);
+					continue;
+				}
+				for (int j = j0; j < interiorJ0; j++)
+					kernel(BorderNeighbourhood<T>(data, nx, ny, i, j), i, j);
+				const T* row = data + i * nx;
+				for (int j = interiorJ0; j < interiorJ1; j++)
+					kernel(InteriorNeighbourhood<T>(row + j, nx), i, j);
+				for (int j = interiorJ1; j < j1; j++)
+					kernel(BorderNeighbourhood<T>(data, nx, ny, i, j), i, j);
+			}
+		}, tileSize, tileSize);
+	}
+
+	/*
+	\brief Fill a field with the result of kernel(n, i, j) over the neighbourhoods of a source field.
+	\param field source field
+	\param result returned field, with the same resolution, it must not be the source field
+	\param radius stencil radius, in cells
+	\param kernel generic callable returning the value of the cell
+	\param tileSize tile side, in cells
+	*/
+	template<typename T, typename U, typename Kernel>
+	static void Apply(const ValueField<T>& field, ValueField<U>& result, int radius, const Kernel& kernel, int tileSize = DefaultTileSize)
+	{
+		U* out = result.Data();
+		int nx = field.SizeX();
+		ForEach(field, radius, [&](const auto& n, int i, int j)
+		{
+			out[i * nx + j] = kernel(n, i, j);
+		}, tileSize);
+	}
+
+	/*
+	\brief Call kernel(n, i, j) for every cell of a tile of a TiledField, n being the neighbourhood of cell (i, j).
+	The tile is copied with a halo of radius cells to a small row major block, whatever the layout of the field,
+	so that interior cells get an InteriorNeighbourhood into the block.
+	\param field source field
+	\param radius stencil radius, in cells
+	\param t tile index, tiles being numbered row by row
+	\param block buffer of at least (TileSize + 2 radius)^2 values
+	\param kernel generic callable
+	*/
+	template<typename T, typename Kernel>
+	static void ForEachInTile(const TiledField<T>& field, int radius, int t, T* block, const Kernel& kernel)
+	{
+		const int size = TiledField<T>::TileSize;
+		int nx = field.SizeX();
+		int ny = field.SizeY();
+		int w = size + 2 * radius;
+		int i0 = (t / field.TileCountX()) * size;
+		int j0 = (t % field.TileCountX()) * size;
+		int i1 = Math::Min(i0 + size, ny);
+		int j1 = Math::Min(j0 + size, nx);
+		int interiorJ0 = Math::Min(Math::Max(j0, radius), j1);
+		int interiorJ1 = Math::Max(Math::Min(j1, nx - radius), interiorJ0);
+		field.Gather(i0 - radius, j0 - radius, w, w, block);
+		for (int i = i0; i < i1; i++)
+		{
+			// Cell (i, j) of the field is at row[j] in the block
+			const T* row = block + (i - i0 + radius) * w + radius - j0;
+			if (i < radius || i >= ny - radius)
+			{
+				for (int j = j0; j < j1; j++)
+					kernel(BlockNeighbourhood<T>(row + j, w, nx, ny, i, j), i, j);
+				continue;
+			}
+			for (int j = j0; j < interiorJ0; j++)
+				kernel(BlockNeighbourhood<T>(row + j, w, nx, ny, i, j), i, j);
+			for (int j = interiorJ0; j < interiorJ1; j++)
+				kernel(InteriorNeighbourhood<T>(row + j, w), i, j);
+			for (int j = interiorJ1; j < j1; j++)
+				kernel(BlockNeighbourhood<T>(row + j, w, nx, ny, i, j), i, j);
+		}
+	}
+
+	/*
+	\brief Call kernel(n, i, j) for every cell of a TiledField, tiles in parallel, see ForEachInTile().
+	\param field source field
+	\param radius stencil radius, in cells
+	\param kernel generic callable
+	*/
+	template<typename T, typename Kernel>
+	static void ForEach(const TiledField<T>& field, int radius, const Kernel& kernel)
+	{
+		int w = TiledField<T>::TileSize + 2 * radius;
+		TaskScheduler::Global().ParallelFor(0, field.TileCountX() * field.TileCountY(), [&](int first, int last)
+		{
+			FrameArena::Scope scope;
+			T* block = FrameArena::Local().Allocate<T>(w * w);
+			for (int t = first; t < last; t++)
+				ForEachInTile(field, radius, t, block, kernel);
+		});
+	}
+
+	/*
+	\brief Fill a TiledField with the result of kernel(n, i, j) over the neighbourhoods of a source field.
+	Results of a tile are gathered in a row major block, which is copied to the result at once.
+	\param field source field
+	\param result returned field, with the same resolution, it must not be the source field
+	\param radius stencil radius, in cells
+	\param kernel generic callable returning the value of the cell
+	*/
+	template<typename T, typename U, typename Kernel>
+	static void Apply(const TiledField<T>& field, TiledField<U>& result, int radius, const Kernel& kernel)
+	{
+		const int size = TiledField<T>::TileSize;
+		int nx = field.SizeX();
+		int ny = field.SizeY();
+		int tilesX = field.TileCountX();
+		TaskScheduler::Global().ParallelFor(0, tilesX * field.TileCountY(), [&](int first, int last)
+		{
+			FrameArena::Scope scope;
+			T* block = FrameArena::Local().Allocate<T>((size + 2 * radius) * (size + 2 * radius));
+			U* out = FrameArena::Local().Allocate<U>(size * size);
+			for (int t = first; t < last; t++)
+			{
+				int i0 = (t / tilesX) * size;
+				int j0 = (t % tilesX) * size;
+				int w = Math::Min(size, nx - j0);
+				int h = Math::Min(size, ny - i0);
+				ForEachInTile(field, radius, t, block, [&](const auto& n, int i, int j)
+				{
+					out[(i - i0) * w + j - j0] = kernel(n, i, j);
+				});
+				result.Scatter(i0, j0, w, h, out);
+			}
+		});
+	}
+
+	/*
+	\brief Evaluate a kernel on a single cell, with the neighbourhood matching its position.
+	*/
+	template<typename T, typename Kernel>
+	static auto At(const ValueField<T>& field, int radius, int i, int j, const Kernel& kernel)
+	{
+		int nx = field.SizeX();
+		int ny = field.SizeY();
+		if (i < radius || i >= ny - radius || j < radius || j >= nx - radius)
+			return kernel(BorderNeighbourhood<T>(field.Data(), nx, ny, i, j), i, j);
+		return kernel(InteriorNeighbourhood<T>(field.Data() + i * nx + j, nx), i, j);
+	}
+};
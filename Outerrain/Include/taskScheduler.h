@@ -0,0 +1,82 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <chrono>
+
+struct TaskState
+{
+	std::function<void()> function;
+	std::atomic<int> pendingCount;
+	std::atomic<bool> done;
+	std::mutex mutex;
+	std::vector<std::shared_ptr<TaskState>> successors;
+};
+
+typedef std::shared_ptr<TaskState> Task;
+
+struct WorkerStatistics
+{
+	unsigned long long taskCount;
+	unsigned long long stealCount;
+	double busySeconds;
+};
+
+class TaskScheduler
+{
+private:
+	struct Worker
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+		std::deque<Task> bound;				// Tasks only this worker may run, never stolen
+		std::atomic<int> boundCount;
+		std::atomic<unsigned long long> taskCount;
+		std::atomic<unsigned long long> stealCount;
+		std::atomic<long long> busyNanoseconds;
+	};
+
+	std::vector<std::thread> threads;
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::atomic<int> queuedCount;
+	std::atomic<int> waitingCount;
+	std::mutex sleepMutex;
+	std::condition_variable sleepCondition;
+	bool stop;
+	std::chrono::steady_clock::time_point statisticsStart;
+
+	void WorkerLoop(int index);
+	int CurrentWorker() const;
+	void Schedule(const Task& task);
+	void ScheduleOn(const Task& task, int index);
+	Task Pop(int index);
+	void Execute(const Task& task, int index);
+
+public:
+	TaskScheduler(int threadCount = 0);
+	~TaskScheduler();
+
+	Task Submit(std::function<void()> function, const std::vector<Task>& dependencies = std::vector<Task>());
+	bool IsDone(const Task& task) const;
+	void Wait(const Task& task);
+	void Wait(const std::vector<Task>& tasks);
+
+	void ParallelFor(int begin, int end, const std::function<void(int, int)>& body, int grain = 0);
+	void ParallelFor2D(int beginI, int endI, int beginJ, int endJ, const std::function<void(int, int, int, int)>& body, int grainI = 0, int grainJ = 0);
+	void ParallelBands(int begin, int end, const std::function<void(int, int)>& body);
+	bool PinThreads();
+	static std::vector<int> CallingThreadCores();
+	static bool SetCallingThreadCores(const std::vector<int>& cores);
+
+	int ThreadCount() const;
+	WorkerStatistics Statistics(int worker) const;
+	double Utilization(int worker) const;
+	void ResetStatistics();
+
+	static TaskScheduler& Global();
+};
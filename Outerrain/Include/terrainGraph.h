@@ -0,0 +1,145 @@
+#pragma once
+#include <unordered_map>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <string>
+
+#include "heightfield.h"
+
+class TerrainGraph;
+
+/*
+\brief 64 bit FNV-1a hash of the content of a node : its kind, its parameters and the hashes of its inputs.
+*/
+class ContentHash
+{
+private:
+	unsigned long long value;
+
+public:
+	ContentHash() : value(14695981039346656037ull)
+	{
+	}
+
+	void Add(const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+			value = (value ^ bytes[i]) * 1099511628211ull;
+	}
+
+	void Add(unsigned long long v) { Add(&v, sizeof(v)); }
+	void Add(int v) { Add(&v, sizeof(v)); }
+	void Add(float v) { Add(&v, sizeof(v)); }
+	void Add(const Vector2& v) { Add(v.x); Add(v.y); }
+	void Add(const Box2D& b) { Add(b.Vertex(0)); Add(b.Vertex(1)); }
+	void Add(const std::string& s) { Add(int(s.size())); Add(s.data(), s.size()); }
+
+	unsigned long long Value() const
+	{
+		return value;
+	}
+};
+
+/*
+\brief Node of a terrain graph. A node computes square tiles of samples from the tiles of its inputs.
+Parameters are public members : changing them changes the content hash of the node, so the graph
+recomputes the node and its downstream nodes on the next request, while upstream tiles stay cached.
+Nodes must not be modified while the graph is evaluating.
+*/
+class TerrainNode
+{
+protected:
+	std::vector<const TerrainNode*> inputs;
+
+	virtual void HashParameters(ContentHash& hash) const = 0;
+
+public:
+	TerrainNode() { }
+	virtual ~TerrainNode() { }
+
+	const std::vector<const TerrainNode*>& Inputs() const
+	{
+		return inputs;
+	}
+
+	/*
+	\brief Get the sample margin the node reads around a tile from its inputs.
+	*/
+	virtual int Halo() const
+	{
+		return 0;
+	}
+
+	unsigned long long Key() const;
+
+	/*
+	\brief Compute a tile.
+	\param graph graph providing the input samples
+	\param tile returned samples, allocated with the tile resolution and box
+	\param firstSample global index of the sample (0, 0) of the tile
+	*/
+	virtual void Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const = 0;
+};
+
+class TerrainGraph
+{
+protected:
+	struct CacheEntry
+	{
+		std::shared_ptr<const HeightField> field;
+		std::list<unsigned long long>::iterator lruPosition;
+	};
+
+	Vector2 origin;
+	float cellSize;
+	int tileCells;
+	size_t maxTileCount;
+	size_t reservedTileCount;		// Tiles needed by the running evaluations, kept on top of maxTileCount
+
+	std::vector<TerrainNode*> nodes;
+
+	std::mutex cacheMutex;
+	std::unordered_map<unsigned long long, CacheEntry> cache;
+	std::list<unsigned long long> lru;
+	std::atomic<int> computedTileCount;
+	std::atomic<int> cacheHitCount;
+
+	static unsigned long long TileKey(unsigned long long nodeKey, const Vector2i& t);
+	std::shared_ptr<const HeightField> Find(unsigned long long key);
+	std::shared_ptr<const HeightField> Insert(unsigned long long key, const std::shared_ptr<const HeightField>& field);
+	void Evict();
+	Vector2i TileCoord(const Vector2i& sample) const;
+	Box2D SampleBox(const Vector2i& firstSample, int n) const;
+
+public:
+	TerrainGraph(const Vector2& origin, float cellSize, int tileCells = 64, int maxTileCount = 1024);
+	~TerrainGraph();
+
+	/*
+	\brief Add a node to the graph, which takes its ownership.
+	*/
+	template<typename Node>
+	Node* Add(Node* node)
+	{
+		nodes.push_back(node);
+		return node;
+	}
+
+	int TileCells() const;
+	float CellSize() const;
+	Vector2 SamplePosition(const Vector2i& sample) const;
+
+	std::shared_ptr<const HeightField> Tile(const TerrainNode* node, const Vector2i& t);
+	std::shared_ptr<const HeightField> Region(const TerrainNode* node, const Vector2i& firstSample, int n);
+	HeightField Evaluate(const TerrainNode* node, const Vector2i& firstSample, int n);
+	HeightField Evaluate(const TerrainNode* node, const Box2D& box);
+
+	void ClearCache();
+	size_t CachedTileCount();
+	int ComputedTileCount() const;
+	int CacheHitCount() const;
+	void ResetStatistics();
+};
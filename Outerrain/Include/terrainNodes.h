@@ -0,0 +1,151 @@
+#pragma once
+#include "terrainGraph.h"
+#include "erosionType.h"
+#include "blendOperation.h"
+
+enum NoiseType
+{
+	NoisePerlin = 0,
+	NoiseSimplex = 1,
+	NoiseValue = 2,
+	NoiseCellular = 3
+};
+
+enum DerivedType
+{
+	DerivedSlope = 0,
+	DerivedDrainageArea = 1,
+	DerivedWetness = 2,
+	DerivedStreamPower = 3
+};
+
+/* Single octave noise */
+class NoiseNode : public TerrainNode
+{
+protected:
+	void HashParameters(ContentHash& hash) const;
+
+public:
+	NoiseType noiseType;
+	unsigned int seed;
+	float amplitude;
+	float frequency;
+	Vector2 offset;
+
+	NoiseNode(NoiseType type, unsigned int seed, float amplitude, float frequency, const Vector2& offset = Vector2(0));
+	void Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const;
+
+	static Noise* CreateNoise(NoiseType type, unsigned int seed);
+};
+
+/* Fractal noise, see Fractal::Evaluate */
+class FractalNode : public TerrainNode
+{
+protected:
+	void HashParameters(ContentHash& hash) const;
+
+public:
+	NoiseType noiseType;
+	unsigned int seed;
+	FractalType fractalType;
+	float amplitude;
+	float frequency;
+	int octaves;
+	Vector2 offset;
+
+	FractalNode(NoiseType noise, unsigned int seed, FractalType type, float amplitude, float frequency, int octaves, const Vector2& offset = Vector2(0));
+	void Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const;
+};
+
+/* Heightmap image mapped on a world box */
+class ImageNode : public TerrainNode
+{
+protected:
+	std::string filePath;
+	ValueField<float> image;
+
+	void HashParameters(ContentHash& hash) const;
+
+public:
+	float blackAltitude;
+	float whiteAltitude;
+	Box2D box;
+
+	ImageNode(const std::string& filePath, float blackAltitude, float whiteAltitude, const Box2D& box);
+	bool Load(const std::string& filePath);
+	void Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const;
+};
+
+/* Erosion steps computed on the tile and a margin around it */
+class ErosionNode : public TerrainNode
+{
+protected:
+	void HashParameters(ContentHash& hash) const;
+
+public:
+	ErosionType erosionType;
+	int steps;
+	int margin;
+
+	ErosionNode(const TerrainNode* input, ErosionType type, int steps, int margin = -1);
+	int Halo() const;
+	void Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const;
+};
+
+/* Combination of two inputs, optionally weighted by a mask */
+class BlendNode : public TerrainNode
+{
+protected:
+	void HashParameters(ContentHash& hash) const;
+
+public:
+	BlendOperation operation;
+	float weight;
+
+	BlendNode(const TerrainNode* a, const TerrainNode* b, BlendOperation operation, float weight = 1.0f, const TerrainNode* mask = nullptr);
+	void Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const;
+};
+
+/* Mask of the samples inside a value range, with a linear falloff */
+class MaskNode : public TerrainNode
+{
+protected:
+	void HashParameters(ContentHash& hash) const;
+
+public:
+	float low;
+	float high;
+	float falloff;
+
+	MaskNode(const TerrainNode* input, float low, float high, float falloff);
+	void Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const;
+};
+
+/* Linear remapping of a value range */
+class RemapNode : public TerrainNode
+{
+protected:
+	void HashParameters(ContentHash& hash) const;
+
+public:
+	float inputMin, inputMax;
+	float outputMin, outputMax;
+
+	RemapNode(const TerrainNode* input, float inputMin, float inputMax, float outputMin, float outputMax);
+	void Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const;
+};
+
+/* Field derived from a heightfield : slope, drainage area, wetness or stream power */
+class DerivedNode : public TerrainNode
+{
+protected:
+	void HashParameters(ContentHash& hash) const;
+
+public:
+	DerivedType derivedType;
+	int margin;
+
+	DerivedNode(const TerrainNode* input, DerivedType type, int margin = 32);
+	int Halo() const;
+	void Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const;
+};
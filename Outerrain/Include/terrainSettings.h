@@ -8,6 +8,7 @@ enum TerrainType
 {
 	HeightFieldTerrain = 0,
 	NoiseFieldTerrain = 1,
+	GraphTerrain = 2,
 };
 
 class TerrainSettings
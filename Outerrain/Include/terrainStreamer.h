@@ -0,0 +1,57 @@
+#pragma once
+#include <unordered_map>
+#include <list>
+
+#include "heightfield.h"
+#include "taskScheduler.h"
+
+struct TerrainTile
+{
+	Vector2i coord;
+	HeightField* field;
+	Task job;
+	std::list<unsigned long long>::iterator lruPosition;
+
+	bool IsReady() const;
+};
+
+class TerrainStreamer
+{
+protected:
+	const Noise& noise;
+	float amplitude;
+	float frequency;
+	int octaves;
+	FractalType fractalType;
+
+	Vector2 origin;
+	float cellSize;
+	int tileCells;
+	int viewRadius;
+	int prefetchRadius;
+	size_t maxTileCount;
+
+	std::unordered_map<unsigned long long, TerrainTile> tiles;
+	std::list<unsigned long long> lru;
+	std::vector<HeightField*> freeFields;
+	int generatedTileCount;
+
+	static unsigned long long Key(const Vector2i& t);
+	TerrainTile& Request(const Vector2i& t);
+	void RequestRange(const Vector2i& a, const Vector2i& b, int ring);
+	void Generate(HeightField* field, const Vector2i& t) const;
+	void Evict(size_t requestedCount);
+
+public:
+	TerrainStreamer(const Noise& n, float amplitude, float freq, int oct, FractalType type, const Vector2& origin, float cellSize, int tileCells,
+					int viewRadius = 2, int prefetchRadius = 1, int maxTileCount = 64);
+	~TerrainStreamer();
+
+	Vector2i TileCoord(const Vector2& p) const;
+	void Update(const Vector2& cameraPosition);
+	const HeightField* GetTile(const Vector2i& t);
+	void Assemble(HeightField& field, const Vector2i& firstSample);
+
+	int GeneratedTileCount() const;
+	size_t CachedTileCount() const;
+};
@@ -0,0 +1,292 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+
+#include "valueField.h"
+#include "taskScheduler.h"
+
+/*
+\brief Order of the cells inside the tiles of a TiledField.
+*/
+enum FieldLayout
+{
+	LayoutTiled = 0,		// Rows of the tile one after the other
+	LayoutMorton = 1		// Z-order curve, interleaving the bits of the row and column indices
+};
+
+/*
+\brief Field stored by square tiles of TileSize x TileSize cells, tiles being contiguous in memory and ordered row by row.
+Neighbour cells in both directions usually share a tile, so stencils and bilinear lookups touch a few cache lines
+and pages instead of distant rows : a whole tile of floats holds in 4 KB.
+The resolution is padded to whole tiles, padding cells are never read.
+Fields are converted from and to row major ValueField for the algorithms which stream rows.
+Stencils are faster with the tiled layout, whose tile rows are copied at once, Morton order is copied cell by cell.
+*/
+template<typename T>
+class TiledField
+{
+public:
+	static const int TileShift = 5;
+	static const int TileSize = 1 << TileShift;
+	static const int TileCells = TileSize * TileSize;
+
+protected:
+	int nx, ny;
+	Box2D box;
+	FieldLayout layout;
+	int tilesX, tilesY;
+	AlignedVector<T, MemoryFields> values;
+
+	/*
+	\brief Spread the bits of a tile coordinate over the even bits of the result.
+	*/
+	static int Spread(int x)
+	{
+		x = (x | (x << 4)) & 0x0F0F;
+		x = (x | (x << 2)) & 0x3333;
+		x = (x | (x << 1)) & 0x5555;
+		return x;
+	}
+
+public:
+	TiledField() : nx(0), ny(0), box(Vector2(0), Vector2(0)), layout(LayoutTiled), tilesX(0), tilesY(0)
+	{
+	}
+
+	TiledField(int nx, int ny, const Box2D& bbox, FieldLayout layout = LayoutTiled, const T& value = T(0)) : nx(nx), ny(ny), box(bbox), layout(layout)
+	{
+		tilesX = (nx + TileSize - 1) >> TileShift;
+		tilesY = (ny + TileSize - 1) >> TileShift;
+		values.resize(size_t(tilesX) * tilesY * TileCells, value);
+	}
+
+	TiledField(const ValueField<T>& field, FieldLayout layout = LayoutTiled) : TiledField(field.SizeX(), field.SizeY(), field.GetBox(), layout)
+	{
+		Encode(field);
+	}
+
+	/*
+	\brief Get the position of a cell in memory.
+	*/
+	int Index(int i, int j) const
+	{
+		int tile = ((i >> TileShift) * tilesX + (j >> TileShift)) << (2 * TileShift);
+		int a = i & (TileSize - 1), b = j & (TileSize - 1);
+		return tile + (layout == LayoutTiled ? (a << TileShift) + b : (Spread(a) << 1) | Spread(b));
+	}
+
+	T Get(int row, int column) const
+	{
+		return values[Index(row, column)];
+	}
+
+	void Set(int row, int column, const T& v)
+	{
+		values[Index(row, column)] = v;
+	}
+
+	/*
+	\brief Copy a rectangle of cells to a row major buffer, with indices clamped to the field.
+	Runs of cells of the same tile row are copied at once with the tiled layout.
+	\param i0, j0 first cell, may be outside of the field
+	\param w, h rectangle size
+	\param out returned values, w x h
+	*/
+	void Gather(int i0, int j0, int w, int h, T* out) const
+	{
+		for (int a = 0; a < h; a++)
+		{
+			int i = Math::Min(Math::Max(i0 + a, 0), ny - 1);
+			T* row = out + a * w;
+			int b = 0;
+			for (; b < w && j0 + b < 0; b++)
+				row[b] = values[Index(i, 0)];
+			while (b < w && j0 + b < nx)
+			{
+				int j = j0 + b;
+				int run = layout == LayoutTiled ? Math::Min(Math::Min(TileSize - (j & (TileSize - 1)), nx - j), w - b) : 1;
+				const T* src = values.data() + Index(i, j);
+				std::copy(src, src + run, row + b);
+				b += run;
+			}
+			for (; b < w; b++)
+				row[b] = values[Index(i, nx - 1)];
+		}
+	}
+
+	/*
+	\brief Copy a row major buffer to a rectangle of cells inside the field, inverse of Gather().
+	\param i0, j0 first cell
+	\param w, h rectangle size
+	\param in values, w x h
+	*/
+	void Scatter(int i0, int j0, int w, int h, const T* in)
+	{
+		for (int a = 0; a < h; a++)
+		{
+			const T* row = in + a * w;
+			int b = 0;
+			while (b < w)
+			{
+				int j = j0 + b;
+				int run = layout == LayoutTiled ? Math::Min(TileSize - (j & (TileSize - 1)), w - b) : 1;
+				std::copy(row + b, row + b + run, values.data() + Index(i0 + a, j));
+				b += run;
+			}
+		}
+	}
+
+	/*
+	\brief Copy a row major field with the same resolution, rows of tiles in parallel.
+	*/
+	void Encode(const ValueField<T>& field)
+	{
+		const T* src = field.Data();
+		TaskScheduler::Global().ParallelFor(0, tilesY, [&](int first, int last)
+		{
+			for (int i = first * TileSize; i < Math::Min(last * TileSize, ny); i++)
+			{
+				for (int j = 0; j < nx; j++)
+					values[Index(i, j)] = src[i * nx + j];
+			}
+		}, 1);
+	}
+
+	/*
+	\brief Copy the field to a row major field with the same resolution, rows of tiles in parallel.
+	*/
+	void Decode(ValueField<T>& field) const
+	{
+		T* dst = field.Data();
+		TaskScheduler::Global().ParallelFor(0, tilesY, [&](int first, int last)
+		{
+			for (int i = first * TileSize; i < Math::Min(last * TileSize, ny); i++)
+				Gather(i, 0, nx, 1, dst + i * nx);
+		}, 1);
+	}
+
+	/*
+	\brief Get the values, in layout order, padding cells included.
+	*/
+	const T* Data() const
+	{
+		return values.data();
+	}
+
+	T* Data()
+	{
+		return values.data();
+	}
+
+	/*
+	\brief Get the number of values, padding cells included.
+	*/
+	int Size() const
+	{
+		return int(values.size());
+	}
+
+	FieldLayout Layout() const
+	{
+		return layout;
+	}
+
+	int SizeX() const
+	{
+		return nx;
+	}
+
+	int SizeY() const
+	{
+		return ny;
+	}
+
+	int TileCountX() const
+	{
+		return tilesX;
+	}
+
+	int TileCountY() const
+	{
+		return tilesY;
+	}
+
+	Box2D GetBox() const
+	{
+		return box;
+	}
+
+	Vector2 BottomLeft() const
+	{
+		return box.Vertex(0);
+	}
+
+	Vector2 TopRight() const
+	{
+		return box.Vertex(1);
+	}
+};
+
+/*
+\brief Bilinear sampler of a TiledField, with the same conventions as BilinearSampler.
+The four cells of a sample are looked up separately, they share a tile except along tile borders.
+The sampler keeps a reference to the field : it must not outlive the field.
+*/
+template<typename T>
+class TiledBilinearSampler
+{
+protected:
+	const TiledField<T>& field;
+	int nx, ny;
+	float x0, y0;
+	float invCellX, invCellY;
+	float maxI, maxJ;
+
+public:
+	TiledBilinearSampler(const TiledField<T>& field) : field(field), nx(field.SizeX()), ny(field.SizeY())
+	{
+		Vector2 a = field.BottomLeft();
+		Vector2 b = field.TopRight();
+		x0 = a.x;
+		y0 = a.y;
+		invCellX = float(ny - 1) / (b.x - a.x);
+		invCellY = float(nx - 1) / (b.y - a.y);
+		maxI = float(ny - 1);
+		maxJ = float(nx - 1);
+	}
+
+	T Sample(float x, float y) const
+	{
+		float fi = Math::Clamp((x - x0) * invCellX, 0.0f, maxI);
+		float fj = Math::Clamp((y - y0) * invCellY, 0.0f, maxJ);
+		int i = Math::Min(int(fi), ny - 2);
+		int j = Math::Min(int(fj), nx - 2);
+		float u = fi - float(i);
+		float v = fj - float(j);
+
+		// Inside a tile of the tiled layout, neighbours are at fixed offsets
+		const T* data = field.Data();
+		int id = field.Index(i, j);
+		int right = TiledField<T>::TileSize - 1;
+		bool inner = field.Layout() == LayoutTiled && (i & right) != right && (j & right) != right;
+		int id01 = inner ? id + 1 : field.Index(i, j + 1);
+		int id10 = inner ? id + TiledField<T>::TileSize : field.Index(i + 1, j);
+		int id11 = inner ? id + TiledField<T>::TileSize + 1 : field.Index(i + 1, j + 1);
+		T p00 = data[id], p01 = data[id01];
+		T p10 = data[id10], p11 = data[id11];
+		T a = p00 + (p01 - p00) * v;
+		T b = p10 + (p11 - p10) * v;
+		return a + (b - a) * u;
+	}
+
+	T Sample(const Vector2& p) const
+	{
+		return Sample(p.x, p.y);
+	}
+
+	void Sample(const Vector2* points, T* out, int count) const
+	{
+		for (int k = 0; k < count; k++)
+			out[k] = Sample(points[k].x, points[k].y);
+	}
+};
@@ -6,14 +6,28 @@
 
 #include "vec.h"
 #include "box2D.h"
+#include "alignedAllocator.h"
+#include "taskScheduler.h"
+
+/*
+\brief How the values of a new field are written for the first time.
+*/
+enum FieldAllocation
+{
+	AllocateSerial = 0,			// By the calling thread
+	AllocateFirstTouch = 1		// By bands of rows in parallel, from the thread running the banded loops, see TaskScheduler::ParallelBands()
+};
 
 template<typename T>
 class ValueField
 {
+public:
+	typedef AlignedVector<T, MemoryFields> Buffer;
+
 protected:
 	int nx, ny;
 	Box2D box;
-	std::vector<T> values;
+	Buffer values;
 
 public:
 	ValueField() : nx(0), ny(0), box(Vector2(0), Vector2(0))
@@ -30,8 +44,52 @@ public:
 		values.resize(nx * ny, value);
 	}
 
+	/*
+	\brief Constructor. With AllocateFirstTouch, values are allocated uninitialized and filled by the banded loop
+	of the global scheduler : on NUMA machines, pages are then allocated on the node of the thread which processes
+	their rows in the banded loops of the simulation, instead of all on the node of the calling thread.
+	*/
+	ValueField(int nx, int ny, const Box2D& bbox, const T& value, FieldAllocation allocation) : nx(nx), ny(ny), box(bbox)
+	{
+		if (allocation == AllocateSerial)
+		{
+			values.resize(nx * ny, value);
+			return;
+		}
+		values.resize(nx * ny);
+		T* data = values.data();
+		TaskScheduler::Global().ParallelBands(0, ny, [&](int first, int last)
+		{
+			std::fill(data + size_t(first) * nx, data + size_t(last) * nx, value);
+		});
+	}
+
+	/*
+	\brief Constructor taking over a buffer, such as a buffer of a BufferPool. Values are left as they are in the buffer.
+	*/
+	ValueField(int nx, int ny, const Box2D& bbox, Buffer&& buffer) : nx(nx), ny(ny), box(bbox), values(std::move(buffer))
+	{
+		values.resize(nx * ny);
+	}
+
+	ValueField(const ValueField& field) = default;
+	ValueField(ValueField&& field) = default;
+	ValueField& operator=(const ValueField& field) = default;
+	ValueField& operator=(ValueField&& field) = default;
+
 	virtual ~ValueField() { }
 
+	/*
+	\brief Take the buffer of the values, for instance to give it back to a BufferPool. The field is left empty.
+	*/
+	Buffer ReleaseValues()
+	{
+		Buffer buffer;
+		buffer.swap(values);
+		nx = ny = 0;
+		return buffer;
+	}
+
 	bool Inside(const Vector2& p) const
 	{
 		Vector2 q = p - box.Vertex(0);
@@ -122,37 +180,17 @@ public:
 		return values[index];
 	}
 
-	T GetValueBilinear(const Vector2& p) const
-	{
-		Vector2 q = p - box.Vertex(0);
-		Vector2 d = box.Vertex(1) - box.Vertex(0);
-
-		float texelX = 1.0f / float(nx - 1);
-		float texelY = 1.0f / float(ny - 1);
-
-		float u = q[0] / d[0];
-		float v = q[1] / d[1];
-
-		int i = int(v * (ny - 1));
-		int j = int(u * (nx - 1));
-
-		float anchorU = j * texelX;
-		float anchorV = i * texelY;
-
-		float localU = (u - anchorU) / texelX;
-		float localV = (v - anchorV) / texelY;
-
-		T v1 = Get(i, j);
-		T v2 = Get(i + 1, j);
-		T v3 = Get(i + 1, j + 1);
-		T v4 = Get(i, j + 1);
+	T GetValueBilinear(const Vector2& p) const;
 
-		return (1 - localU) * (1 - localV) * v1
-			+ (1 - localU) * localV * v2
-			+ localU * (1 - localV) * v4
-			+ localU * localV * v3;
+	const T* Data() const
+	{
+		return values.data();
 	}
 
+	T* Data()
+	{
+		return values.data();
+	}
 
 	void Fill(T v)
 	{
@@ -215,4 +253,94 @@ public:
 	{
 		return box;
 	}
+
+	void SetBox(const Box2D& bbox)
+	{
+		box = bbox;
+	}
+};
+
+/*
+\brief Bilinear sampler of a ValueField, with the field extents and inverse cell size computed once.
+World positions follow ValueField::Vertex(i, j) : x runs along rows i and y along columns j.
+Positions outside of the field are clamped to its border.
+The sampler keeps a pointer to the field data : it must not outlive the field.
+*/
+template<typename T>
+class BilinearSampler
+{
+protected:
+	const T* data;
+	int nx, ny;
+	float x0, y0;
+	float invCellX, invCellY;
+	float maxI, maxJ;
+
+public:
+	BilinearSampler(const ValueField<T>& field) : data(field.Data()), nx(field.SizeX()), ny(field.SizeY())
+	{
+		Vector2 a = field.BottomLeft();
+		Vector2 b = field.TopRight();
+		x0 = a.x;
+		y0 = a.y;
+		invCellX = float(ny - 1) / (b.x - a.x);
+		invCellY = float(nx - 1) / (b.y - a.y);
+		maxI = float(ny - 1);
+		maxJ = float(nx - 1);
+	}
+
+	T Sample(float x, float y) const
+	{
+		// Continuous index, clamped to the field
+		float fi = Math::Clamp((x - x0) * invCellX, 0.0f, maxI);
+		float fj = Math::Clamp((y - y0) * invCellY, 0.0f, maxJ);
+
+		// The anchor never is the last row/column, so that the 4 samples stay inside
+		int i = Math::Min(int(fi), ny - 2);
+		int j = Math::Min(int(fj), nx - 2);
+		float u = fi - float(i);
+		float v = fj - float(j);
+
+		// Integer indices, rather than a pointer, let the compiler use gathers
+		int id = i * nx + j;
+		T p00 = data[id], p01 = data[id + 1];
+		T p10 = data[id + nx], p11 = data[id + nx + 1];
+		T a = p00 + (p01 - p00) * v;
+		T b = p10 + (p11 - p10) * v;
+		return a + (b - a) * u;
+	}
+
+	T Sample(const Vector2& p) const
+	{
+		return Sample(p.x, p.y);
+	}
+
+	/*
+	\brief Sample an array of positions, by blocks whose coordinates are copied to separate arrays and whose results
+	go to a local array that cannot alias the field : the loop over a block is branch free, so it vectorizes for float fields.
+	*/
+	void Sample(const Vector2* points, T* out, int count) const
+	{
+		const int block = 64;
+		float x[block], y[block];
+		T r[block];
+		for (int first = 0; first < count; first += block)
+		{
+			int n = Math::Min(block, count - first);
+			for (int k = 0; k < n; k++)
+			{
+				x[k] = points[first + k].x;
+				y[k] = points[first + k].y;
+			}
+			for (int k = 0; k < n; k++)
+				r[k] = Sample(x[k], y[k]);
+			std::copy(r, r + n, out + first);
+		}
+	}
 };
+
+template<typename T>
+T ValueField<T>::GetValueBilinear(const Vector2& p) const
+{
+	return BilinearSampler<T>(*this).Sample(p);
+}
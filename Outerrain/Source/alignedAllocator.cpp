@@ -0,0 +1,130 @@
+#include "alignedAllocator.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+/*
+\class AlignedMemory alignedAllocator.h
+\brief Allocation of memory aligned on cache lines, with counters of the bytes in use per subsystem.
+Allocations of at least HugePageSize bytes may also be backed by transparent huge pages, which are disabled by default :
+a 4096 x 4096 field of floats then needs 32 TLB entries instead of 16384. Huge pages are requested with madvise on Linux,
+where they depend on the transparent_hugepage setting of the kernel, the option is ignored on other systems.
+Counters are atomic, allocating from several threads is safe.
+*/
+
+static std::atomic<size_t> allocated[MemorySubsystemCount];
+static std::atomic<size_t> peak[MemorySubsystemCount];
+static std::atomic<size_t> allocationCount[MemorySubsystemCount];
+static std::atomic<bool> hugePages(false);
+
+/*
+\brief Allocate memory aligned on Alignment bytes, or on HugePageSize bytes for huge pages.
+\param bytes size
+\param subsystem counter of the allocation
+\return the memory, nullptr if it could not be allocated
+*/
+void* AlignedMemory::Allocate(size_t bytes, MemorySubsystem subsystem)
+{
+	size_t size = bytes > 0 ? bytes : 1;
+	bool huge = hugePages && size >= HugePageSize;
+	void* p = nullptr;
+#ifdef _WIN32
+	p = _aligned_malloc(size, huge ? HugePageSize : Alignment);
+#else
+	if (posix_memalign(&p, huge ? HugePageSize : Alignment, size) != 0)
+		p = nullptr;
+#ifdef MADV_HUGEPAGE
+	if (p != nullptr && huge)
+		madvise(p, size, MADV_HUGEPAGE);
+#endif
+#endif
+	if (p == nullptr)
+		return nullptr;
+
+	size_t current = (allocated[subsystem] += bytes);
+	size_t previous = peak[subsystem];
+	while (current > previous && !peak[subsystem].compare_exchange_weak(previous, current))
+	{
+	}
+	allocationCount[subsystem]++;
+	return p;
+}
+
+/*
+\brief Free memory given by Allocate().
+\param p memory
+\param bytes size given to Allocate()
+\param subsystem counter given to Allocate()
+*/
+void AlignedMemory::Free(void* p, size_t bytes, MemorySubsystem subsystem)
+{
+	if (p == nullptr)
+		return;
+	allocated[subsystem] -= bytes;
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+/*
+\brief Enable or disable transparent huge pages for the next large allocations.
+*/
+void AlignedMemory::SetHugePages(bool enabled)
+{
+	hugePages = enabled;
+}
+
+bool AlignedMemory::HugePages()
+{
+	return hugePages;
+}
+
+/*
+\brief Get the bytes currently allocated by a subsystem.
+*/
+size_t AlignedMemory::Allocated(MemorySubsystem subsystem)
+{
+	return allocated[subsystem];
+}
+
+/*
+\brief Get the largest number of bytes allocated at once by a subsystem.
+*/
+size_t AlignedMemory::Peak(MemorySubsystem subsystem)
+{
+	return peak[subsystem];
+}
+
+/*
+\brief Get the number of allocations made by a subsystem.
+*/
+size_t AlignedMemory::AllocationCount(MemorySubsystem subsystem)
+{
+	return allocationCount[subsystem];
+}
+
+const char* AlignedMemory::Name(MemorySubsystem subsystem)
+{
+	static const char* names[MemorySubsystemCount] = { "General", "Fields", "Mesh", "Scratch" };
+	return names[subsystem];
+}
+
+void AlignedMemory::PrintInfos()
+{
+	std::cout << "Printing memory usage..." << std::endl;
+	for (int s = 0; s < MemorySubsystemCount; s++)
+	{
+		MemorySubsystem subsystem = MemorySubsystem(s);
+		std::cout << Name(subsystem) << " : " << (Allocated(subsystem) >> 10) << " KB, peak " << (Peak(subsystem) >> 10)
+			<< " KB, " << AllocationCount(subsystem) << " allocations" << std::endl;
+	}
+}
@@ -43,6 +43,22 @@ bool Box2D::Contains(const Vector2& p) const
     return (p > a && p < b);
 }
 
+/*
+\brief Returns true if the two boxes overlap, false otherwise.
+*/
+bool Box2D::Intersect(const Box2D& box) const
+{
+	return a.x <= box.b.x && box.a.x <= b.x && a.y <= box.b.y && box.a.y <= b.y;
+}
+
+/*
+\brief Returns the smallest box containing this box and another one.
+*/
+Box2D Box2D::Merged(const Box2D& box) const
+{
+	return Box2D(Vector2(Math::Min(a.x, box.a.x), Math::Min(a.y, box.a.y)), Vector2(Math::Max(b.x, box.b.x), Math::Max(b.y, box.b.y)));
+}
+
 /*
 \brief Extend the box by r
 \param r extending factor
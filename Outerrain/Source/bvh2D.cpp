@@ -0,0 +1,122 @@
+#include "bvh2D.h"
+
+#include <algorithm>
+
+/*
+\class BVH2D bvh2D.h
+\brief Bounding volume hierarchy over 2D boxes, built by median splits along the largest extent of the box centers.
+Nodes are stored in depth first order, so that the left child of a node is the next node in the array.
+Items are reported in no particular order.
+*/
+
+/*
+\brief Default constructor, creates an empty hierarchy.
+*/
+BVH2D::BVH2D()
+{
+}
+
+/*
+\brief Build the hierarchy over a set of boxes. Items are the indices of the boxes.
+*/
+void BVH2D::Build(const std::vector<Box2D>& boxes)
+{
+	this->boxes = boxes;
+	nodes.clear();
+	items.resize(boxes.size());
+	if (boxes.empty())
+		return;
+
+	std::vector<Vector2> centers(boxes.size());
+	for (size_t i = 0; i < boxes.size(); i++)
+	{
+		items[i] = int(i);
+		centers[i] = boxes[i].Center();
+	}
+	nodes.reserve(2 * (boxes.size() / LeafSize + 1));
+	Build(centers, 0, int(boxes.size()));
+}
+
+/*
+\brief Build the sub tree of the items [first, last[, internal function.
+\return the index of the root node of the sub tree
+*/
+int BVH2D::Build(const std::vector<Vector2>& centers, int first, int last)
+{
+	int index = int(nodes.size());
+	nodes.push_back(Node());
+
+	Box2D box = boxes[items[first]];
+	Box2D centerBox = Box2D(centers[items[first]], centers[items[first]]);
+	for (int k = first + 1; k < last; k++)
+	{
+		box = box.Merged(boxes[items[k]]);
+		centerBox = centerBox.Merged(Box2D(centers[items[k]], centers[items[k]]));
+	}
+	nodes[index].box = box;
+
+	if (last - first <= LeafSize)
+	{
+		nodes[index].first = first;
+		nodes[index].count = last - first;
+		return index;
+	}
+
+	Vector2 extent = centerBox.TopRight() - centerBox.BottomLeft();
+	int axis = extent.x >= extent.y ? 0 : 1;
+	int middle = (first + last) / 2;
+	std::nth_element(items.begin() + first, items.begin() + middle, items.begin() + last, [&](int a, int b)
+	{
+		return axis == 0 ? centers[a].x < centers[b].x : centers[a].y < centers[b].y;
+	});
+
+	Build(centers, first, middle);
+	int right = Build(centers, middle, last);
+	nodes[index].first = right;
+	nodes[index].count = 0;
+	return index;
+}
+
+/*
+\brief Release the hierarchy.
+*/
+void BVH2D::Clear()
+{
+	nodes.clear();
+	items.clear();
+	boxes.clear();
+}
+
+/*
+\brief Returns true if the hierarchy holds no box.
+*/
+bool BVH2D::Empty() const
+{
+	return nodes.empty();
+}
+
+/*
+\brief Get the box containing all the items.
+*/
+Box2D BVH2D::GetBox() const
+{
+	return nodes.empty() ? Box2D() : nodes[0].box;
+}
+
+/*
+\brief Get the node count.
+*/
+int BVH2D::NodeCount() const
+{
+	return int(nodes.size());
+}
+
+/*
+\brief Gather the items whose box intersects a query box, sorted by increasing index.
+*/
+void BVH2D::Query(const Box2D& box, std::vector<int>& result) const
+{
+	result.clear();
+	Query(box, [&](int item) { result.push_back(item); });
+	std::sort(result.begin(), result.end());
+}
@@ -0,0 +1,122 @@
+#include "noise.h"
+#include "randomStream.h"
+
+/*
+\brief Cellular noise class, as described by Worley in http://www.rhythmiccanvas.com/research/papers/worley.pdf.
+Each lattice cell holds one jittered feature point, and the noise is the distance to the closest one (F1).
+The distance is remapped to [-1, 1] so that it can be used like the other noises in fractals.
+Batch evaluation is not vectorized : the 9 or 27 random feature point lookups of a point make gathers slower
+than scalar code, by about 50 % in 3D.
+*/
+
+/*
+\brief Constructor. Initialize the permutation table and the feature point offsets.
+\param seed noise seed
+*/
+CellularNoise::CellularNoise(unsigned int seed)
+{
+	InitPermutation(seed, perm);
+	RandomStream random(seed, RandomSubsystem::Noise, 3);
+	for (int i = 0; i < 256; i++)
+	{
+		jitterX[i] = random.NextFloat();
+		jitterY[i] = random.NextFloat();
+		jitterZ[i] = random.NextFloat();
+	}
+}
+
+/*
+\brief Compute Cellular noise in 2D. This is an internal function.
+*/
+inline float CellularNoise::At(float x, float y) const
+{
+	int x0 = FastFloor(x);
+	int y0 = FastFloor(y);
+	float fx = x - float(x0);
+	float fy = y - float(y0);
+
+	float d = 8.0f;
+	for (int k = -1; k <= 1; k++)
+	{
+		for (int l = -1; l <= 1; l++)
+		{
+			int h = perm[((x0 + k) & 255) + perm[(y0 + l) & 255]];
+			float dx = float(k) + jitterX[h] - fx;
+			float dy = float(l) + jitterY[h] - fy;
+			d = Math::Min(d, dx * dx + dy * dy);
+		}
+	}
+	return Math::Clamp(2.0f * sqrtf(d) - 1.0f, -1.0f, 1.0f);
+}
+
+/*
+\brief Compute Cellular noise in 3D. This is an internal function.
+*/
+inline float CellularNoise::At(float x, float y, float z) const
+{
+	int x0 = FastFloor(x);
+	int y0 = FastFloor(y);
+	int z0 = FastFloor(z);
+	float fx = x - float(x0);
+	float fy = y - float(y0);
+	float fz = z - float(z0);
+
+	float d = 8.0f;
+	for (int k = -1; k <= 1; k++)
+	{
+		for (int l = -1; l <= 1; l++)
+		{
+			for (int m = -1; m <= 1; m++)
+			{
+				int h = perm[((x0 + k) & 255) + perm[((y0 + l) & 255) + perm[(z0 + m) & 255]]];
+				float dx = float(k) + jitterX[h] - fx;
+				float dy = float(l) + jitterY[h] - fy;
+				float dz = float(m) + jitterZ[h] - fz;
+				d = Math::Min(d, dx * dx + dy * dy + dz * dz);
+			}
+		}
+	}
+	return Math::Clamp(2.0f * sqrtf(d) - 1.0f, -1.0f, 1.0f);
+}
+
+/*
+\brief Compute Cellular noise in 2D.
+\param point position
+*/
+float CellularNoise::GetValue(const Vector2& point) const
+{
+	return At(point.x, point.y);
+}
+
+/*
+\brief Compute Cellular noise in 3D.
+\param point position
+*/
+float CellularNoise::GetValue(const Vector3& point) const
+{
+	return At(point.x, point.y, point.z);
+}
+
+/*
+\brief Compute Cellular noise in 2D for an array of points.
+\param points positions
+\param values returned noise values
+\param count point count
+*/
+void CellularNoise::GetValues(const Vector2* points, float* values, int count) const
+{
+	for (int i = 0; i < count; i++)
+		values[i] = At(points[i].x, points[i].y);
+}
+
+/*
+\brief Compute Cellular noise in 3D for an array of points.
+\param points positions
+\param values returned noise values
+\param count point count
+*/
+void CellularNoise::GetValues(const Vector3* points, float* values, int count) const
+{
+	for (int i = 0; i < count; i++)
+		values[i] = At(points[i].x, points[i].y, points[i].z);
+}
@@ -0,0 +1,276 @@
+#include "constructionTree.h"
+
+/*
+\class ConstructionTree constructionTree.h
+\brief Terrain built by stacking local stamps : mountains, craters, plateaus, river beds or copies of fields.
+The tree is left deep : every stamp is an operator node whose left child is the tree of the previous stamps,
+so that stamps apply in insertion order. Stamps have a compact support, indexed by a BVH : rasterizing a
+heightfield processes square tiles in parallel, and every tile only visits the stamps overlapping it,
+so that the cost grows with the stamp density instead of the stamp count.
+*/
+
+/*
+\brief Create a radial stamp, with a smooth (1 - d^2 / r^2)^3 falloff.
+\param center center of the stamp
+\param radius radius of the support
+\param height stamp height
+\param operation blend operator with the terrain below
+\param weight alpha multiplier
+*/
+TerrainStamp TerrainStamp::Circle(const Vector2& center, float radius, float height, BlendOperation operation, float weight)
+{
+	TerrainStamp ret;
+	ret.shape = StampCircle;
+	ret.operation = operation;
+	ret.a = ret.b = center;
+	ret.radius = radius;
+	ret.height = height;
+	ret.weight = weight;
+	ret.field = nullptr;
+	return ret;
+}
+
+/*
+\brief Create a stamp along a segment, with the radial falloff applied to the distance to the segment.
+\param a, b end points of the segment
+\param radius radius of the support
+\param height stamp height
+\param operation blend operator with the terrain below
+\param weight alpha multiplier
+*/
+TerrainStamp TerrainStamp::Segment(const Vector2& a, const Vector2& b, float radius, float height, BlendOperation operation, float weight)
+{
+	TerrainStamp ret = Circle(a, radius, height, operation, weight);
+	ret.shape = StampSegment;
+	ret.b = b;
+	return ret;
+}
+
+/*
+\brief Create a stamp copying a field over a box, with a linear falloff along the border of the box.
+The field is not copied, it must outlive the stamp.
+\param field stamped field
+\param box world box of the stamp
+\param height scale of the field values
+\param border width of the border falloff, 0 for none
+\param operation blend operator with the terrain below
+\param weight alpha multiplier
+*/
+TerrainStamp TerrainStamp::Field(const ScalarField2D* field, const Box2D& box, float height, float border, BlendOperation operation, float weight)
+{
+	TerrainStamp ret = Circle(box.Center(), border, height, operation, weight);
+	ret.shape = StampField;
+	ret.a = box.BottomLeft();
+	ret.b = box.TopRight();
+	ret.field = field;
+	return ret;
+}
+
+/*
+\brief Compute the box outside of which the stamp has no effect.
+*/
+Box2D TerrainStamp::Support() const
+{
+	if (shape == StampField)
+		return Box2D(a, b);
+	Vector2 r = Vector2(radius);
+	return Box2D(Vector2(Math::Min(a.x, b.x), Math::Min(a.y, b.y)) - r, Vector2(Math::Max(a.x, b.x), Math::Max(a.y, b.y)) + r);
+}
+
+/*
+\brief Evaluate the stamp at a point.
+\param p world point
+\param h returned stamp height
+\param alpha returned falloff, weight included
+\return false if the point is outside of the support
+*/
+bool TerrainStamp::Evaluate(const Vector2& p, float& h, float& alpha) const
+{
+	if (shape == StampField)
+	{
+		float e = Math::Min(Math::Min(p.x - a.x, b.x - p.x), Math::Min(p.y - a.y, b.y - p.y));
+		if (e < 0.0f)
+			return false;
+		alpha = weight * (radius > 0.0f ? Math::Min(e / radius, 1.0f) : 1.0f);
+
+		// Map the point from the stamp box onto the field box
+		Vector2 fa = field->BottomLeft();
+		Vector2 fd = field->TopRight() - fa;
+		Vector2 q = Vector2(fa.x + (p.x - a.x) / (b.x - a.x) * fd.x, fa.y + (p.y - a.y) / (b.y - a.y) * fd.y);
+		h = height * field->GetValueBilinear(q);
+		return true;
+	}
+
+	// Squared distance to the center, or to the segment
+	Vector2 d = p - a;
+	if (shape == StampSegment)
+	{
+		Vector2 ab = b - a;
+		float l = ab.x * ab.x + ab.y * ab.y;
+		float t = l > 0.0f ? Math::Clamp((d.x * ab.x + d.y * ab.y) / l, 0.0f, 1.0f) : 0.0f;
+		d = d - ab * t;
+	}
+	float r2 = radius * radius;
+	float d2 = d.x * d.x + d.y * d.y;
+	if (d2 >= r2)
+		return false;
+	float u = 1.0f - d2 / r2;
+	alpha = weight * u * u * u;
+	h = height;
+	return true;
+}
+
+/*
+\brief Blend the stamp with the height of the terrain below it.
+\param p world point
+\param h height of the terrain, updated
+*/
+void TerrainStamp::Apply(const Vector2& p, float& h) const
+{
+	float s, alpha;
+	if (Evaluate(p, s, alpha) == false)
+		return;
+	if (operation == BlendAdd)
+		h += alpha * s;
+	else if (operation == BlendSubtract)
+		h -= alpha * s;
+	else if (operation == BlendMultiply)
+		h *= 1.0f + alpha * (s - 1.0f);
+	else if (operation == BlendMin)
+		h += alpha * (Math::Min(h, s) - h);
+	else if (operation == BlendMax)
+		h += alpha * (Math::Max(h, s) - h);
+	else if (operation == BlendLerp)
+		h += alpha * (s - h);
+}
+
+/*
+\brief Default constructor, creates an empty tree.
+*/
+ConstructionTree::ConstructionTree() : dirty(false)
+{
+}
+
+/*
+\brief Add a stamp on top of the tree.
+\return index of the stamp
+*/
+int ConstructionTree::Add(const TerrainStamp& stamp)
+{
+	stamps.push_back(stamp);
+	dirty = true;
+	return int(stamps.size()) - 1;
+}
+
+/*
+\brief Remove all the stamps.
+*/
+void ConstructionTree::Clear()
+{
+	stamps.clear();
+	bvh.Clear();
+	dirty = false;
+}
+
+/*
+\brief Get the stamp count.
+*/
+int ConstructionTree::StampCount() const
+{
+	return int(stamps.size());
+}
+
+/*
+\brief Get a stamp.
+*/
+const TerrainStamp& ConstructionTree::GetStamp(int i) const
+{
+	return stamps[i];
+}
+
+/*
+\brief Rebuild the BVH over the stamp supports if stamps were added, internal function.
+*/
+void ConstructionTree::Build()
+{
+	if (dirty == false)
+		return;
+	std::vector<Box2D> boxes(stamps.size());
+	for (size_t i = 0; i < stamps.size(); i++)
+		boxes[i] = stamps[i].Support();
+	bvh.Build(boxes);
+	dirty = false;
+}
+
+/*
+\brief Get the box containing the supports of all the stamps.
+*/
+Box2D ConstructionTree::Support()
+{
+	Build();
+	return bvh.GetBox();
+}
+
+/*
+\brief Evaluate the tree at a point.
+\param p world point
+\param base height of the terrain below the stamps
+*/
+float ConstructionTree::Evaluate(const Vector2& p, float base)
+{
+	Build();
+	std::vector<int> candidates;
+	bvh.Query(Box2D(p, p), candidates);
+	float h = base;
+	for (size_t k = 0; k < candidates.size(); k++)
+		stamps[candidates[k]].Apply(p, h);
+	return h;
+}
+
+/*
+\brief Apply the stamps to a heightfield, whose heights are the base of the tree.
+Tiles are processed in parallel, and the stamps of a tile are gathered once from the BVH, in tree order.
+\param hf heightfield
+\param tileSize tile side, in cells
+*/
+void ConstructionTree::Rasterize(HeightField& hf, int tileSize)
+{
+	Build();
+	if (bvh.Empty())
+		return;
+
+	int nx = hf.SizeX();
+	int ny = hf.SizeY();
+	float* data = hf.Data();
+	TaskScheduler::Global().ParallelFor2D(0, ny, 0, nx, [&](int i0, int i1, int j0, int j1)
+	{
+		std::vector<int> candidates;
+		Vector2 a = hf.ValueField::Vertex(i0, j0);
+		Vector2 b = hf.ValueField::Vertex(i1 - 1, j1 - 1);
+		bvh.Query(Box2D(a, b), candidates);
+		if (candidates.empty())
+			return;
+
+		std::vector<const TerrainStamp*> local(candidates.size());
+		std::vector<Box2D> supports(candidates.size());
+		for (size_t k = 0; k < candidates.size(); k++)
+		{
+			local[k] = &stamps[candidates[k]];
+			supports[k] = local[k]->Support();
+		}
+		for (int i = i0; i < i1; i++)
+		{
+			for (int j = j0; j < j1; j++)
+			{
+				Vector2 p = hf.ValueField::Vertex(i, j);
+				float h = data[i * nx + j];
+				for (size_t k = 0; k < local.size(); k++)
+				{
+					if (supports[k].Intersect(Box2D(p, p)))
+						local[k]->Apply(p, h);
+				}
+				data[i * nx + j] = h;
+			}
+		}
+	}, tileSize, tileSize);
+}
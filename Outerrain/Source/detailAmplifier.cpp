@@ -0,0 +1,97 @@
+#include "detailAmplifier.h"
+#include "fractal.h"
+#include "flowAccumulation.h"
+
+/*
+\class DetailAmplifier detailAmplifier.h
+\brief Super-resolution of an eroded heightfield : a terrain eroded at a low resolution is upsampled bilinearly,
+and fBm detail is added to it, with an amplitude guided by the low resolution terrain. Steep slopes get the most detail,
+while drainage channels and valley floors, where sediments deposit, stay smooth.
+Samples only depend on their world position, so any tile of the high resolution terrain can be computed on its own,
+for instance while streaming, and neighbour tiles match along their shared border up to rounding.
+*/
+
+/*
+\brief Constructor. Computes the detail mask from the slope and the drainage area of the low resolution terrain.
+\param coarse low resolution terrain, usually eroded, copied by the amplifier
+\param noise noise used for the detail, must outlive the amplifier
+\param amplitude amplitude of the detail
+\param frequency frequency of the first detail octave, usually about the inverse of the coarse cell size
+\param octaves detail octave count
+\param slopeWeight influence of the slope on the detail amplitude, between 0 and 1
+\param drainageWeight attenuation of the detail along drainage channels, between 0 and 1
+*/
+DetailAmplifier::DetailAmplifier(const HeightField& coarse, const Noise& noise, float amplitude, float frequency, int octaves, float slopeWeight, float drainageWeight)
+	: coarse(coarse), noise(noise), amplitude(amplitude), frequency(frequency), octaves(octaves)
+{
+	ScalarField2D slope = coarse.Slope();
+	slope.NormalizeField();
+
+	// Drainage on a logarithmic scale : channels gather orders of magnitude more cells than hillslopes
+	FlowAccumulation flow(coarse);
+	ScalarField2D drainage = flow.DrainageArea();
+	drainage = log(1.0f + drainage);
+	drainage.NormalizeField();
+
+	detail = (1.0f - slopeWeight + slopeWeight * slope) * (1.0f - drainageWeight * drainage);
+}
+
+/*
+\brief Compute a block of samples of a high resolution field, internal function.
+\param shape high resolution field, giving the sample positions
+\param heights returned heights, with the layout of the shape
+\param i0, i1, j0, j1 block of samples, last ones excluded
+*/
+void DetailAmplifier::AmplifyBlock(const HeightField& shape, float* heights, int i0, int i1, int j0, int j1) const
+{
+	BilinearSampler<float> base(coarse);
+	BilinearSampler<float> mask(detail);
+	int n = j1 - j0;
+	std::vector<Vector2> points(n);
+	std::vector<float> h(n), m(n), d(n);
+	for (int i = i0; i < i1; i++)
+	{
+		for (int j = j0; j < j1; j++)
+			points[j - j0] = shape.ValueField::Vertex(i, j);
+		base.Sample(points.data(), h.data(), n);
+		mask.Sample(points.data(), m.data(), n);
+		Fractal::fBm(noise, points.data(), d.data(), n, amplitude, frequency, octaves);
+
+		float* row = heights + i * shape.SizeX() + j0;
+		for (int k = 0; k < n; k++)
+			row[k] = h[k] + m[k] * d[k];
+	}
+}
+
+/*
+\brief Compute a tile of the high resolution terrain.
+\param tile returned tile, allocated with the resolution and the box of the tile
+*/
+void DetailAmplifier::Amplify(HeightField& tile) const
+{
+	AmplifyBlock(tile, tile.Data(), 0, tile.SizeY(), 0, tile.SizeX());
+}
+
+/*
+\brief Compute the high resolution terrain over the box of the low resolution one. Tiles are processed in parallel.
+\param nx, ny resolution of the returned terrain
+\param tileSize tile side, in samples
+*/
+HeightField DetailAmplifier::Amplify(int nx, int ny, int tileSize) const
+{
+	HeightField ret(nx, ny, coarse.GetBox());
+	float* heights = ret.Data();
+	TaskScheduler::Global().ParallelFor2D(0, ny, 0, nx, [&](int i0, int i1, int j0, int j1)
+	{
+		AmplifyBlock(ret, heights, i0, i1, j0, j1);
+	}, tileSize, tileSize);
+	return ret;
+}
+
+/*
+\brief Get the detail amplitude factor, between 0 and 1, at the resolution of the low resolution terrain.
+*/
+const ScalarField2D& DetailAmplifier::DetailMask() const
+{
+	return detail;
+}
@@ -0,0 +1,237 @@
+#include "distanceTransform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+/*
+\class DistanceTransform distanceTransform.h
+\brief Exact Euclidean distance transform, in linear time : computes the distance from every cell to the nearest
+cell of a selection, such as water, rivers or ridges.
+The transform is separable (Felzenszwalb and Huttenlocher, Meijster et al.). The first pass computes the distance
+to the nearest selected cell of the same column, with a downward and an upward sweep, processed in parallel by strips
+of columns and vectorized along the rows. The second pass computes, for every row in parallel, the lower envelope
+of the parabolas rooted at the cells of the row, whose height is the squared column distance.
+Distances are in world units : cells are CellSize().x apart along i and CellSize().y apart along j.
+BruteForce() computes the same distances by testing every selected cell, to check the transform on small fields.
+*/
+
+// Column distance of the cells without any selected cell in their column, in cells
+static const float Far = 1.0e10f;
+
+/*
+\brief Compute the distance from every cell to the nearest selected cell of its column, in cells, internal function.
+\param mask selected cells
+\param nx, ny resolution
+\param g returned distances
+*/
+void DistanceTransform::Columns(const std::vector<char>& mask, int nx, int ny, float* g)
+{
+	int strips = (nx + StripWidth - 1) / StripWidth;
+	TaskScheduler::Global().ParallelFor(0, strips, [&](int first, int last)
+	{
+		for (int s = first; s < last; s++)
+		{
+			int j0 = s * StripWidth;
+			int j1 = Math::Min(j0 + StripWidth, nx);
+			for (int j = j0; j < j1; j++)
+				g[j] = mask[j] ? 0.0f : Far;
+			for (int i = 1; i < ny; i++)
+			{
+				const char* m = mask.data() + size_t(i) * nx;
+				const float* above = g + size_t(i - 1) * nx;
+				float* row = g + size_t(i) * nx;
+				for (int j = j0; j < j1; j++)
+					row[j] = m[j] ? 0.0f : above[j] + 1.0f;
+			}
+			for (int i = ny - 2; i >= 0; i--)
+			{
+				const float* below = g + size_t(i + 1) * nx;
+				float* row = g + size_t(i) * nx;
+				for (int j = j0; j < j1; j++)
+					row[j] = Math::Min(row[j], below[j] + 1.0f);
+			}
+		}
+	}, 1);
+}
+
+/*
+\brief Turn the column distances of every row into Euclidean distances, internal function.
+Abscissae are in cells and the parabolas are intersected in double precision, so that the transform stays exact on large fields.
+Columns without any selected cell are skipped, as there is at least one selected cell in the field.
+\param g column distances in cells, replaced by the distances in world units
+\param nx, ny resolution
+\param cellJ, cellI cell size along j and i
+*/
+void DistanceTransform::Rows(float* g, int nx, int ny, float cellJ, float cellI)
+{
+	TaskScheduler::Global().ParallelFor(0, ny, [&](int first, int last)
+	{
+		std::vector<double> h(nx), z(nx + 1);
+		std::vector<int> v(nx), nearest(nx);
+		double scale = double(cellI) / double(cellJ);
+		for (int i = first; i < last; i++)
+		{
+			float* row = g + size_t(i) * nx;
+
+			// Lower envelope of the parabolas y = f(q) + (x - q)^2, stored as h(q) = f(q) + q^2
+			int k = -1;
+			for (int q = 0; q < nx; q++)
+			{
+				if (row[q] >= Far)
+					continue;
+				double d = row[q] * scale;
+				h[q] = d * d + double(q) * double(q);
+				if (k < 0)
+				{
+					k = 0;
+					v[0] = q;
+					z[0] = -std::numeric_limits<double>::infinity();
+					z[1] = std::numeric_limits<double>::infinity();
+					continue;
+				}
+				double s = (h[q] - h[v[k]]) / (2.0 * (q - v[k]));
+				while (s <= z[k])
+				{
+					k--;
+					s = (h[q] - h[v[k]]) / (2.0 * (q - v[k]));
+				}
+				k++;
+				v[k] = q;
+				z[k] = s;
+				z[k + 1] = std::numeric_limits<double>::infinity();
+			}
+
+			// Nearest root of every cell, then distances in a vectorized loop
+			k = 0;
+			for (int j = 0; j < nx; j++)
+			{
+				while (z[k + 1] < j)
+					k++;
+				nearest[j] = v[k];
+			}
+			for (int j = 0; j < nx; j++)
+			{
+				int p = nearest[j];
+				float dx = float(j - p);
+				row[j] = cellJ * sqrtf(float(h[p] - double(p) * double(p)) + dx * dx);
+			}
+		}
+	}, Math::Max(1, 4096 / nx));
+}
+
+/*
+\brief Compute the distance to the selected cells of a mask.
+Cells are left at the largest float value if the mask is empty.
+\param shape field giving the resolution and the extent
+\param mask selected cells, one per cell of the field, non zero if selected
+*/
+ScalarField2D DistanceTransform::Compute(const ScalarField2D& shape, const std::vector<char>& mask)
+{
+	int nx = shape.SizeX();
+	int ny = shape.SizeY();
+	ScalarField2D ret(nx, ny, shape.GetBox(), std::numeric_limits<float>::max());
+	if (std::find_if(mask.begin(), mask.end(), [](char m) { return m != 0; }) == mask.end())
+	{
+		std::cout << "Distance transform of an empty selection" << std::endl;
+		return ret;
+	}
+	Vector2 cell = shape.CellSize();
+	Columns(mask, nx, ny, ret.Data());
+	Rows(ret.Data(), nx, ny, cell.y, cell.x);
+	return ret;
+}
+
+/*
+\brief Compute the distance to the cells whose values are > threshold, such as FilterSuperiorTo.
+\param field field
+\param threshold selection threshold
+*/
+ScalarField2D DistanceTransform::Compute(const ScalarField2D& field, float threshold)
+{
+	std::vector<char> mask(size_t(field.SizeX()) * field.SizeY());
+	const float* values = field.Data();
+	TaskScheduler::Global().ParallelFor(0, int(mask.size()), [&](int first, int last)
+	{
+		for (int k = first; k < last; k++)
+			mask[k] = values[k] > threshold ? 1 : 0;
+	}, 16384);
+	return Compute(field, mask);
+}
+
+/*
+\brief Compute the distance to a selection of cells, such as returned by FilterSuperiorTo, FilterInferiorTo or FilterBetween.
+\param shape field giving the resolution and the extent
+\param cells selected cells
+*/
+ScalarField2D DistanceTransform::Compute(const ScalarField2D& shape, const std::vector<ScalarValue>& cells)
+{
+	std::vector<char> mask(size_t(shape.SizeX()) * shape.SizeY(), 0);
+	for (size_t k = 0; k < cells.size(); k++)
+		mask[shape.ToIndex1D(cells[k].x, cells[k].y)] = 1;
+	return Compute(shape, mask);
+}
+
+/*
+\brief Compute the distance to the selected cells of a mask by testing all of them, in O(cells x selected cells).
+Only meant to check Compute() on small fields, see Check().
+\param shape field giving the resolution and the extent
+\param mask selected cells, one per cell of the field, non zero if selected
+*/
+ScalarField2D DistanceTransform::BruteForce(const ScalarField2D& shape, const std::vector<char>& mask)
+{
+	int nx = shape.SizeX();
+	int ny = shape.SizeY();
+	Vector2 cell = shape.CellSize();
+	std::vector<Vector2i> selected;
+	for (int i = 0; i < ny; i++)
+	{
+		for (int j = 0; j < nx; j++)
+		{
+			if (mask[shape.ToIndex1D(i, j)])
+				selected.push_back(Vector2i(i, j));
+		}
+	}
+
+	ScalarField2D ret(nx, ny, shape.GetBox(), std::numeric_limits<float>::max());
+	TaskScheduler::Global().ParallelFor(0, ny, [&](int first, int last)
+	{
+		for (int i = first; i < last; i++)
+		{
+			for (int j = 0; j < nx; j++)
+			{
+				double d2 = std::numeric_limits<double>::max();
+				for (size_t k = 0; k < selected.size(); k++)
+				{
+					double di = double(i - selected[k].x) * cell.x;
+					double dj = double(j - selected[k].y) * cell.y;
+					d2 = Math::Min(d2, di * di + dj * dj);
+				}
+				if (selected.empty() == false)
+					ret.Set(i, j, float(sqrt(d2)));
+			}
+		}
+	});
+	return ret;
+}
+
+/*
+\brief Compare Compute() with BruteForce() on a mask.
+\param shape field giving the resolution and the extent, preferably with different cell sizes along i and j
+\param mask selected cells
+\return largest distance error, relative to the largest distance
+*/
+float DistanceTransform::Check(const ScalarField2D& shape, const std::vector<char>& mask)
+{
+	ScalarField2D fast = Compute(shape, mask);
+	ScalarField2D reference = BruteForce(shape, mask);
+	float error = 0.0f;
+	float range = 0.0f;
+	for (int k = 0; k < shape.SizeX() * shape.SizeY(); k++)
+	{
+		error = Math::Max(error, fabsf(fast.Get(k) - reference.Get(k)));
+		range = Math::Max(range, reference.Get(k));
+	}
+	return range > 0.0f ? error / range : error;
+}
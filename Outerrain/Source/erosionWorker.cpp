@@ -0,0 +1,255 @@
+#include "erosionWorker.h"
+
+#include <chrono>
+
+/*
+\class ErosionWorker erosionWorker.h
+\brief Runs erosion simulations on a background thread, so that the render loop never waits for them.
+The worker only runs the CPU passes : the compute shader of GPUHeightfield needs the OpenGL context of the render thread.
+The worker owns its own copy of the terrain. Progress is published into two snapshot buffers : the worker
+writes the back buffer while readers copy the front one, and publishing is a single atomic index swap.
+Readers register on the front buffer with an atomic counter, and the worker only overwrites a buffer once
+nobody reads it anymore, so neither side ever takes a lock on the snapshots.
+*/
+
+/*
+\brief Constructor. Copies the terrain and starts the worker thread, paused until Run() is called.
+\param hf initial terrain
+*/
+ErosionWorker::ErosionWorker(const HeightField& hf) : field(hf), evolution(nullptr),
+	buffers{ HeightField(hf.SizeX(), hf.SizeY(), hf.GetBox()), HeightField(hf.SizeX(), hf.SizeY(), hf.GetBox()) },
+	front(0), version(0), activeCellCount(0), activeRequest(0), type(ErosionThermal), request(0), remainingSteps(0), completedSteps(0), paused(false), quit(false)
+{
+	readers[0] = 0;
+	readers[1] = 0;
+	Publish();
+	thread = std::thread(&ErosionWorker::ThreadLoop, this);
+}
+
+/*
+\brief Destructor. Cancels the remaining steps and joins the worker thread.
+*/
+ErosionWorker::~ErosionWorker()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+		remainingSteps = 0;
+	}
+	condition.notify_all();
+	thread.join();
+	delete evolution;
+}
+
+/*
+\brief Worker thread main loop, internal function.
+Snapshots are published at most every 30ms, and when the requested steps are done.
+*/
+void ErosionWorker::ThreadLoop()
+{
+	std::chrono::steady_clock::time_point lastPublish = std::chrono::steady_clock::now();
+	while (true)
+	{
+		ErosionType stepType;
+		unsigned int stepRequest;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [this] { return quit || (remainingSteps > 0 && !paused); });
+			if (quit)
+				return;
+			stepType = type;
+			stepRequest = request;
+		}
+
+		// A new request restarts the active set with all the cells, the terrain may have changed in any way since
+		if (stepRequest != activeRequest)
+		{
+			active.Reset(field.SizeX() * field.SizeY());
+			activeRequest = stepRequest;
+		}
+		bool stable = (Step(stepType) == false);
+		completedSteps++;
+
+		// The step is only counted against its own request : a Run() issued meanwhile keeps all its steps
+		bool finished;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (request == stepRequest)
+				remainingSteps = stable ? 0 : remainingSteps - 1;
+			finished = (remainingSteps <= 0);
+		}
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (finished || paused || now - lastPublish > std::chrono::milliseconds(30))
+		{
+			Publish();
+			lastPublish = now;
+		}
+	}
+}
+
+/*
+\brief Perform one step of erosion on the private terrain.
+\param stepType erosion type. See enum.
+\return false if the terrain has converged and further steps would not change it
+*/
+bool ErosionWorker::Step(ErosionType stepType)
+{
+	// Thermal weathering only processes the cells which may still move, and stops once the terrain is stable
+	if (stepType == ErosionThermal)
+	{
+		activeCellCount = active.Count();
+		return field.SparseThermalWeathering(1.0f, 0.6f, active) > 0;
+	}
+	else if (stepType == ErosionHydraulic)
+		field.HydraulicErosion();
+	else if (stepType == ErosionStreamPower)
+	{
+		// Depressions are filled once, so that the whole terrain drains to the borders
+		if (evolution == nullptr)
+		{
+			evolution = new LandscapeEvolution(field);
+			evolution->FillDepressions();
+		}
+		evolution->Step(1.0e4f);
+	}
+	return true;
+}
+
+/*
+\brief Copy the private terrain in the back buffer and swap it with the front buffer.
+Waits for the readers still copying the old back buffer, which only happens if a reader
+started right before the previous swap.
+*/
+void ErosionWorker::Publish()
+{
+	int back = 1 - front;
+	while (readers[back] > 0)
+		std::this_thread::yield();
+	std::copy(field.Data(), field.Data() + field.SizeX() * field.SizeY(), buffers[back].Data());
+	front = back;
+	version++;
+}
+
+/*
+\brief Request a number of steps of a given erosion type, replacing the pending ones.
+A step being computed completes, and is not counted against the new request.
+\param erosionType erosion type. See enum.
+\param stepCount step count. Thermal and hydraulic steps are single iterations, stream power steps simulate 10000 years.
+*/
+void ErosionWorker::Run(ErosionType erosionType, int stepCount)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		type = erosionType;
+		remainingSteps = stepCount;
+		request++;
+		paused = false;
+	}
+	condition.notify_all();
+}
+
+/*
+\brief Pause the simulation after the current step. The pending steps are kept.
+*/
+void ErosionWorker::Pause()
+{
+	paused = true;
+}
+
+/*
+\brief Resume a paused simulation.
+*/
+void ErosionWorker::Resume()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		paused = false;
+	}
+	condition.notify_all();
+}
+
+/*
+\brief Cancel the pending steps. The step being computed completes and is published.
+*/
+void ErosionWorker::Cancel()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	remainingSteps = 0;
+}
+
+/*
+\brief Returns true if the simulation is paused.
+*/
+bool ErosionWorker::IsPaused() const
+{
+	return paused;
+}
+
+/*
+\brief Returns true if steps remain to be computed.
+*/
+bool ErosionWorker::IsRunning() const
+{
+	return remainingSteps > 0;
+}
+
+/*
+\brief Get the number of steps left.
+*/
+int ErosionWorker::RemainingSteps() const
+{
+	return Math::Max(int(remainingSteps), 0);
+}
+
+/*
+\brief Get the number of steps computed since the creation of the worker.
+*/
+int ErosionWorker::CompletedSteps() const
+{
+	return completedSteps;
+}
+
+/*
+\brief Get the active cell count of the last thermal weathering step.
+*/
+int ErosionWorker::ActiveCellCount() const
+{
+	return activeCellCount;
+}
+
+/*
+\brief Get the version of the last published snapshot, incremented at each publication.
+*/
+unsigned int ErosionWorker::Version() const
+{
+	return version;
+}
+
+/*
+\brief Copy the last published snapshot if it is newer than a given version. Never blocks.
+\param hf returned terrain, with the resolution of the simulated one
+\param lastVersion version of hf, updated
+\return true if hf was updated
+*/
+bool ErosionWorker::CopySnapshot(HeightField& hf, unsigned int& lastVersion)
+{
+	unsigned int current = version;
+	if (current == lastVersion)
+		return false;
+
+	// Register on the front buffer, and check that it was not swapped meanwhile.
+	// The front buffer is swapped before the version is incremented, so it is at least as recent as current.
+	int index;
+	while (true)
+	{
+		index = front;
+		readers[index]++;
+		if (front == index)
+			break;
+		readers[index]--;
+	}
+	lastVersion = current;
+	std::copy(buffers[index].Data(), buffers[index].Data() + hf.SizeX() * hf.SizeY(), hf.Data());
+	readers[index]--;
+	return true;
+}
@@ -0,0 +1,285 @@
+#include "fft.h"
+#include "taskScheduler.h"
+#include "frameArena.h"
+#include "vec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+/*
+\class FFT2D fft.h
+\brief Two dimensional complex fast Fourier transform, for fields of nx x ny values with power of two resolutions.
+Real and imaginary parts are stored in two separate arrays, row major like the fields : entry (i, j) is at i * nx + j.
+The transform is separable : one dimensional iterative radix 2 transforms run along the columns, then along the rows.
+Transforms always run over Lanes independent sequences at once, interleaved so that the k-th values of all sequences
+are contiguous : every butterfly is then a short loop over the lanes, which vectorizes.
+Strips of columns are copied into this layout row by row, and Lanes rows are gathered by reading them side by side,
+so memory is always read sequentially. Strips and groups of rows are transformed in parallel, in buffers of the FrameArena
+of the thread.
+The forward transform uses exp(-2 i pi k n / N), the inverse transform is normalized by 1 / (nx ny).
+*/
+
+/*
+\brief Create a transform for a given resolution, which must be a power of two along both axes.
+\param nx, ny resolution
+*/
+FFT2D::FFT2D(int nx, int ny) : nx(nx), ny(ny)
+{
+	if (!IsPowerOfTwo(nx) || !IsPowerOfTwo(ny))
+	{
+		std::cout << "FFT resolution must be a power of two, got " << nx << " x " << ny << std::endl;
+		return;
+	}
+	rows = MakePlan(nx);
+	columns = MakePlan(ny);
+}
+
+/*
+\brief Check if an integer is a strictly positive power of two.
+*/
+bool FFT2D::IsPowerOfTwo(int n)
+{
+	return n > 0 && (n & (n - 1)) == 0;
+}
+
+/*
+\brief Check if the resolution of the transform is supported.
+*/
+bool FFT2D::IsValid() const
+{
+	return IsPowerOfTwo(nx) && IsPowerOfTwo(ny);
+}
+
+/*
+\brief Compute the tables of a one dimensional transform, internal function.
+Twiddle factors are computed in double precision.
+\param n size, a power of two
+*/
+FFT2D::Plan FFT2D::MakePlan(int n)
+{
+	Plan plan;
+	plan.n = n;
+	int bits = 0;
+	while ((1 << bits) < n)
+		bits++;
+	plan.reversed.resize(n);
+	for (int k = 0; k < n; k++)
+	{
+		int r = 0;
+		for (int b = 0; b < bits; b++)
+			r |= ((k >> b) & 1) << (bits - 1 - b);
+		plan.reversed[k] = r;
+	}
+	plan.cosine.resize(Math::Max(n / 2, 1));
+	plan.sine.resize(Math::Max(n / 2, 1));
+	for (int k = 0; k < n / 2; k++)
+	{
+		double a = -2.0 * Math::PI<double> * double(k) / double(n);
+		plan.cosine[k] = float(cos(a));
+		plan.sine[k] = float(sin(a));
+	}
+	return plan;
+}
+
+/*
+\brief Transform Lanes interleaved sequences in place, internal function.
+Value k of sequence w is stored at k * Lanes + w.
+\param plan tables of the transform
+\param re, im real and imaginary parts
+\param inverse inverse transform, without normalization
+*/
+void FFT2D::Transform(const Plan& plan, float* re, float* im, bool inverse)
+{
+	int n = plan.n;
+
+	// Bit reversal permutation
+	for (int k = 0; k < n; k++)
+	{
+		int r = plan.reversed[k];
+		if (r <= k)
+			continue;
+		float* a = re + k * Lanes;
+		float* b = re + r * Lanes;
+		float* c = im + k * Lanes;
+		float* d = im + r * Lanes;
+		for (int w = 0; w < Lanes; w++)
+		{
+			std::swap(a[w], b[w]);
+			std::swap(c[w], d[w]);
+		}
+	}
+
+	// Butterflies : the first stages only combine values inside blocks, which stay in the L1 cache and are transformed
+	// through these stages one after the other, the last stages sweep the whole sequences
+	float sign = inverse ? -1.0f : 1.0f;
+	int block = Math::Min(n, BlockSize);
+	for (int first = 0; first < n; first += block)
+	{
+		for (int half = 1; half < block; half *= 2)
+			Butterflies(plan, re, im, first, first + block, half, sign);
+	}
+	for (int half = block; half < n; half *= 2)
+		Butterflies(plan, re, im, 0, n, half, sign);
+}
+
+/*
+\brief Apply the butterflies of a stage of the transform to a range of interleaved sequences, internal function.
+\param plan tables of the transform
+\param re, im real and imaginary parts
+\param first, last range of values, aligned on 2 half values
+\param half distance between the two values of a butterfly
+\param sign sign of the imaginary part of the twiddle factors
+*/
+void FFT2D::Butterflies(const Plan& plan, float* re, float* im, int first, int last, int half, float sign)
+{
+	int step = plan.n / (2 * half);
+	for (int start = first; start < last; start += 2 * half)
+	{
+		for (int k = 0; k < half; k++)
+		{
+			float wr = plan.cosine[k * step];
+			float wi = sign * plan.sine[k * step];
+			float* ar = re + (start + k) * Lanes;
+			float* ai = im + (start + k) * Lanes;
+			float* br = ar + half * Lanes;
+			float* bi = ai + half * Lanes;
+			for (int w = 0; w < Lanes; w++)
+			{
+				float tr = wr * br[w] - wi * bi[w];
+				float ti = wr * bi[w] + wi * br[w];
+				br[w] = ar[w] - tr;
+				bi[w] = ai[w] - ti;
+				ar[w] += tr;
+				ai[w] += ti;
+			}
+		}
+	}
+}
+
+/*
+\brief Transform the columns of the field, by strips of StripLanes groups of Lanes columns, internal function.
+Strips are wider than a group so that every row is read by long runs, which limits TLB and cache conflict misses
+between the rows, whose distance is a power of two.
+*/
+void FFT2D::TransformColumns(float* re, float* im, bool inverse) const
+{
+	const int strip = Lanes * StripLanes;
+	int strips = (nx + strip - 1) / strip;
+	TaskScheduler::Global().ParallelFor(0, strips, [&](int first, int last)
+	{
+		FrameArena::Scope scope;
+		float* sr = FrameArena::Local().Allocate<float>(size_t(ny) * strip);
+		float* si = FrameArena::Local().Allocate<float>(size_t(ny) * strip);
+		for (int s = first; s < last; s++)
+		{
+			int j0 = s * strip;
+			int groups = (Math::Min(strip, nx - j0) + Lanes - 1) / Lanes;
+
+			// Group g of the strip is stored as Lanes interleaved columns, from g * ny * Lanes
+			for (int i = 0; i < ny; i++)
+			{
+				for (int g = 0; g < groups; g++)
+				{
+					int width = Math::Min(Lanes, nx - j0 - g * Lanes);
+					size_t from = size_t(i) * nx + j0 + g * Lanes;
+					size_t to = (size_t(g) * ny + i) * Lanes;
+					for (int w = 0; w < width; w++)
+					{
+						sr[to + w] = re[from + w];
+						si[to + w] = im[from + w];
+					}
+				}
+			}
+			for (int g = 0; g < groups; g++)
+				Transform(columns, sr + size_t(g) * ny * Lanes, si + size_t(g) * ny * Lanes, inverse);
+			for (int i = 0; i < ny; i++)
+			{
+				for (int g = 0; g < groups; g++)
+				{
+					int width = Math::Min(Lanes, nx - j0 - g * Lanes);
+					size_t to = size_t(i) * nx + j0 + g * Lanes;
+					size_t from = (size_t(g) * ny + i) * Lanes;
+					for (int w = 0; w < width; w++)
+					{
+						re[to + w] = sr[from + w];
+						im[to + w] = si[from + w];
+					}
+				}
+			}
+		}
+	}, 1);
+}
+
+/*
+\brief Transform the rows of the field, by groups of Lanes rows, internal function.
+*/
+void FFT2D::TransformRows(float* re, float* im, bool inverse) const
+{
+	int groups = (ny + Lanes - 1) / Lanes;
+	TaskScheduler::Global().ParallelFor(0, groups, [&](int first, int last)
+	{
+		FrameArena::Scope scope;
+		float* sr = FrameArena::Local().Allocate<float>(size_t(nx) * Lanes);
+		float* si = FrameArena::Local().Allocate<float>(size_t(nx) * Lanes);
+		for (int g = first; g < last; g++)
+		{
+			int i0 = g * Lanes;
+			int width = Math::Min(Lanes, ny - i0);
+			for (int w = 0; w < width; w++)
+			{
+				const float* r = re + size_t(i0 + w) * nx;
+				const float* m = im + size_t(i0 + w) * nx;
+				for (int j = 0; j < nx; j++)
+				{
+					sr[size_t(j) * Lanes + w] = r[j];
+					si[size_t(j) * Lanes + w] = m[j];
+				}
+			}
+			Transform(rows, sr, si, inverse);
+			for (int w = 0; w < width; w++)
+			{
+				float* r = re + size_t(i0 + w) * nx;
+				float* m = im + size_t(i0 + w) * nx;
+				for (int j = 0; j < nx; j++)
+				{
+					r[j] = sr[size_t(j) * Lanes + w];
+					m[j] = si[size_t(j) * Lanes + w];
+				}
+			}
+		}
+	}, 1);
+}
+
+/*
+\brief Forward transform, in place.
+\param re, im real and imaginary parts, nx x ny values each
+*/
+void FFT2D::Forward(float* re, float* im) const
+{
+	if (!IsValid())
+		return;
+	TransformColumns(re, im, false);
+	TransformRows(re, im, false);
+}
+
+/*
+\brief Inverse transform, in place, normalized so that it inverts the forward transform.
+\param re, im real and imaginary parts, nx x ny values each
+*/
+void FFT2D::Inverse(float* re, float* im) const
+{
+	if (!IsValid())
+		return;
+	TransformColumns(re, im, true);
+	TransformRows(re, im, true);
+	float scale = 1.0f / (float(nx) * float(ny));
+	TaskScheduler::Global().ParallelFor(0, ny, [&](int first, int last)
+	{
+		for (size_t k = size_t(first) * nx; k < size_t(last) * nx; k++)
+		{
+			re[k] *= scale;
+			im[k] *= scale;
+		}
+	});
+}
@@ -0,0 +1,355 @@
+#include "fieldFilter.h"
+#include "stencil.h"
+#include "frameArena.h"
+
+#include <algorithm>
+#include <cmath>
+
+/*
+\class FieldFilter fieldFilter.h
+\brief Smoothing filters over float fields : Gaussian, box, bilateral and median.
+Gaussian and box filters are separable. The horizontal pass filters rows in parallel, from a copy of every row
+padded with its border values, so that the inner loops have no bound checks and vectorize.
+The vertical pass sweeps down strips of columns in parallel : the source rows of the strip covered by the kernel
+are kept in a small ring buffer, and every output row is a combination of the rows of the ring, vectorized along the strip.
+Memory is only read and written row by row, and no temporary field is needed, so the result may be the source field.
+Padded rows are taken from the FrameArena of the thread.
+Bilateral and median filters are not separable, they run as tiled stencils, see Stencil.
+Borders are clamped. The result must have the same resolution as the source field.
+*/
+
+// Cells per parallel chunk of rows
+static const int ChunkCells = 16384;
+
+/*
+\brief Copy a row of n values into a buffer with r clamped values on each side.
+*/
+static inline void PadRow(const float* row, int n, int r, float* padded)
+{
+	for (int k = 0; k < r; k++)
+	{
+		padded[k] = row[0];
+		padded[r + n + k] = row[n - 1];
+	}
+	std::copy(row, row + n, padded + r);
+}
+
+/*
+\brief Ring buffer of the last rows of a strip of columns, with clamped row indices, internal class.
+*/
+class RowRing
+{
+protected:
+	const float* field;
+	int nx, ny;
+	int j0, width;
+	int count;
+	std::vector<float> rows;
+
+public:
+	RowRing(const float* field, int nx, int ny, int j0, int width, int count) : field(field), nx(nx), ny(ny), j0(j0), width(width), count(count), rows(size_t(count) * width)
+	{
+	}
+
+	/*
+	\brief Copy source row t into the ring, replacing row t - count.
+	*/
+	void Load(int t)
+	{
+		const float* row = field + size_t(Math::Min(Math::Max(t, 0), ny - 1)) * nx + j0;
+		std::copy(row, row + width, Row(t));
+	}
+
+	/*
+	\brief Get source row t, which must be one of the last count loaded rows.
+	*/
+	float* Row(int t)
+	{
+		return rows.data() + size_t(((t % count) + count) % count) * width;
+	}
+};
+
+/*
+\brief Compute the weighted sum of rows, internal function.
+The output is processed by blocks which stay in the L1 cache, and the weights are applied one at a time
+over a block, which vectorizes the inner loop.
+\param rows source rows
+\param weights weights of the rows
+\param count row count
+\param out returned row
+\param n row size
+*/
+void FieldFilter::WeightedSum(const float* const* rows, const float* weights, int count, float* out, int n)
+{
+	const int block = 256;
+	for (int j0 = 0; j0 < n; j0 += block)
+	{
+		int m = Math::Min(block, n - j0);
+		float* sum = out + j0;
+		float w = weights[0];
+		const float* q = rows[0] + j0;
+		for (int j = 0; j < m; j++)
+			sum[j] = w * q[j];
+		for (int k = 1; k < count; k++)
+		{
+			w = weights[k];
+			q = rows[k] + j0;
+			for (int j = 0; j < m; j++)
+				sum[j] += w * q[j];
+		}
+	}
+}
+
+/*
+\brief Convolve the rows of a field with a symmetric kernel of 2r + 1 weights, in parallel, internal function.
+\param src source values
+\param dst returned values, may be the source
+\param nx, ny resolution
+\param kernel weights
+*/
+void FieldFilter::ConvolveRows(const float* src, float* dst, int nx, int ny, const std::vector<float>& kernel)
+{
+	int r = int(kernel.size()) / 2;
+	TaskScheduler::Global().ParallelFor(0, ny, [&](int first, int last)
+	{
+		FrameArena::Scope scope;
+		float* padded = FrameArena::Local().Allocate<float>(nx + 2 * r);
+		const float** taps = FrameArena::Local().Allocate<const float*>(2 * r + 1);
+		for (int k = 0; k <= 2 * r; k++)
+			taps[k] = padded + k;
+		for (int i = first; i < last; i++)
+		{
+			PadRow(src + size_t(i) * nx, nx, r, padded);
+			WeightedSum(taps, kernel.data(), 2 * r + 1, dst + size_t(i) * nx, nx);
+		}
+	}, Math::Max(1, ChunkCells / nx));
+}
+
+/*
+\brief Convolve the columns of a field with a symmetric kernel of 2r + 1 weights, in place, internal function.
+\param data values
+\param nx, ny resolution
+\param kernel weights
+*/
+void FieldFilter::ConvolveColumns(float* data, int nx, int ny, const std::vector<float>& kernel)
+{
+	int r = int(kernel.size()) / 2;
+	int strips = (nx + StripWidth - 1) / StripWidth;
+	TaskScheduler::Global().ParallelFor(0, strips, [&](int first, int last)
+	{
+		std::vector<const float*> taps(2 * r + 1);
+		for (int s = first; s < last; s++)
+		{
+			int j0 = s * StripWidth;
+			int width = Math::Min(StripWidth, nx - j0);
+			RowRing ring(data, nx, ny, j0, width, 2 * r + 1);
+			for (int t = -r; t < r; t++)
+				ring.Load(t);
+			for (int i = 0; i < ny; i++)
+			{
+				// Row i has been copied into the ring before being overwritten
+				ring.Load(i + r);
+				for (int k = 0; k <= 2 * r; k++)
+					taps[k] = ring.Row(i - r + k);
+				WeightedSum(taps.data(), kernel.data(), 2 * r + 1, data + size_t(i) * nx + j0, width);
+			}
+		}
+	}, 1);
+}
+
+/*
+\brief Average the rows of a field over windows of 2r + 1 values with running sums, in parallel, internal function.
+Sums are kept in double precision, so that long rows do not drift.
+\param src source values
+\param dst returned values, may be the source
+\param nx, ny resolution
+\param r window radius
+*/
+void FieldFilter::BoxRows(const float* src, float* dst, int nx, int ny, int r)
+{
+	float inv = 1.0f / float(2 * r + 1);
+	TaskScheduler::Global().ParallelFor(0, ny, [&](int first, int last)
+	{
+		FrameArena::Scope scope;
+		float* padded = FrameArena::Local().Allocate<float>(nx + 2 * r + 1);
+		for (int i = first; i < last; i++)
+		{
+			PadRow(src + size_t(i) * nx, nx, r, padded);
+			const float* p = padded;
+			float* out = dst + size_t(i) * nx;
+			double s = 0.0;
+			for (int k = 0; k <= 2 * r; k++)
+				s += p[k];
+			for (int j = 0; j < nx; j++)
+			{
+				out[j] = float(s) * inv;
+				s += double(p[j + 2 * r + 1]) - double(p[j]);
+			}
+		}
+	}, Math::Max(1, ChunkCells / nx));
+}
+
+/*
+\brief Average the columns of a field over windows of 2r + 1 values with running sums, in place, internal function.
+The sums of a strip are updated together, which vectorizes the inner loop.
+\param data values
+\param nx, ny resolution
+\param r window radius
+*/
+void FieldFilter::BoxColumns(float* data, int nx, int ny, int r)
+{
+	float inv = 1.0f / float(2 * r + 1);
+	int strips = (nx + StripWidth - 1) / StripWidth;
+	TaskScheduler::Global().ParallelFor(0, strips, [&](int first, int last)
+	{
+		std::vector<double> sum(StripWidth);
+		for (int s = first; s < last; s++)
+		{
+			int j0 = s * StripWidth;
+			int width = Math::Min(StripWidth, nx - j0);
+
+			// The ring also keeps the row leaving the window
+			RowRing ring(data, nx, ny, j0, width, 2 * r + 2);
+			std::fill(sum.begin(), sum.end(), 0.0);
+			for (int t = -r - 1; t < r; t++)
+			{
+				ring.Load(t);
+				const float* row = ring.Row(t);
+				for (int j = 0; j < width; j++)
+					sum[j] += row[j];
+			}
+			for (int i = 0; i < ny; i++)
+			{
+				ring.Load(i + r);
+				const float* in = ring.Row(i + r);
+				const float* outgoing = ring.Row(i - r - 1);
+				float* out = data + size_t(i) * nx + j0;
+				for (int j = 0; j < width; j++)
+				{
+					sum[j] += double(in[j]) - double(outgoing[j]);
+					out[j] = float(sum[j]) * inv;
+				}
+			}
+		}
+	}, 1);
+}
+
+/*
+\brief Gaussian blur, with a kernel truncated at three standard deviations.
+\param field source field
+\param result returned field
+\param sigma standard deviation, in cells
+*/
+void FieldFilter::Gaussian(const ValueField<float>& field, ValueField<float>& result, float sigma)
+{
+	int r = int(ceilf(3.0f * sigma));
+	if (r <= 0)
+	{
+		std::copy(field.Data(), field.Data() + field.SizeX() * field.SizeY(), result.Data());
+		return;
+	}
+	std::vector<float> kernel(2 * r + 1);
+	float sum = 0.0f;
+	for (int k = -r; k <= r; k++)
+	{
+		kernel[k + r] = expf(-float(k * k) / (2.0f * sigma * sigma));
+		sum += kernel[k + r];
+	}
+	for (int k = 0; k <= 2 * r; k++)
+		kernel[k] /= sum;
+	ConvolveRows(field.Data(), result.Data(), field.SizeX(), field.SizeY(), kernel);
+	ConvolveColumns(result.Data(), result.SizeX(), result.SizeY(), kernel);
+}
+
+/*
+\brief Box blur, in constant time per cell whatever the radius.
+\param field source field
+\param result returned field
+\param radius window radius, in cells
+*/
+void FieldFilter::Box(const ValueField<float>& field, ValueField<float>& result, int radius)
+{
+	if (radius <= 0)
+	{
+		std::copy(field.Data(), field.Data() + field.SizeX() * field.SizeY(), result.Data());
+		return;
+	}
+	BoxRows(field.Data(), result.Data(), field.SizeX(), field.SizeY(), radius);
+	BoxColumns(result.Data(), result.SizeX(), result.SizeY(), radius);
+}
+
+/*
+\brief Edge preserving bilateral filter : neighbours are weighted by their distance and by their value difference,
+so that steep features such as cliffs and river banks are kept while flat areas are smoothed.
+\param field source field
+\param result returned field
+\param sigmaSpatial spatial standard deviation, in cells, the field is copied if it is not positive
+\param sigmaRange value standard deviation, the field is copied if it is not positive
+*/
+void FieldFilter::Bilateral(const ValueField<float>& field, ValueField<float>& result, float sigmaSpatial, float sigmaRange)
+{
+	if (sigmaSpatial <= 0.0f || sigmaRange <= 0.0f)
+	{
+		std::copy(field.Data(), field.Data() + field.SizeX() * field.SizeY(), result.Data());
+		return;
+	}
+	int r = Math::Max(int(ceilf(2.0f * sigmaSpatial)), 1);
+	int w = 2 * r + 1;
+	std::vector<float> spatial(w * w);
+	for (int k = -r; k <= r; k++)
+	{
+		for (int l = -r; l <= r; l++)
+			spatial[(k + r) * w + l + r] = expf(-float(k * k + l * l) / (2.0f * sigmaSpatial * sigmaSpatial));
+	}
+	float invRange = 1.0f / (2.0f * sigmaRange * sigmaRange);
+
+	ValueField<float> source = &field == &result ? field : ValueField<float>();
+	const ValueField<float>& src = &field == &result ? source : field;
+	Stencil::Apply(src, result, r, [&](const auto& n, int, int)
+	{
+		float c = n(0, 0);
+		float sum = 0.0f, weight = 0.0f;
+		for (int k = -r; k <= r; k++)
+		{
+			for (int l = -r; l <= r; l++)
+			{
+				float v = n(k, l);
+				float d = v - c;
+				float wkl = spatial[(k + r) * w + l + r] * expf(-d * d * invRange);
+				sum += wkl * v;
+				weight += wkl;
+			}
+		}
+		return sum / weight;
+	});
+}
+
+/*
+\brief Median filter, removing isolated spikes and pits.
+\param field source field
+\param result returned field
+\param radius window radius, in cells, clamped to MaxMedianRadius, the field is copied if it is not positive
+*/
+void FieldFilter::Median(const ValueField<float>& field, ValueField<float>& result, int radius)
+{
+	if (radius <= 0)
+	{
+		std::copy(field.Data(), field.Data() + field.SizeX() * field.SizeY(), result.Data());
+		return;
+	}
+	int r = Math::Min(radius, MaxMedianRadius);
+	ValueField<float> source = &field == &result ? field : ValueField<float>();
+	const ValueField<float>& src = &field == &result ? source : field;
+	Stencil::Apply(src, result, r, [&](const auto& n, int, int)
+	{
+		float window[(2 * MaxMedianRadius + 1) * (2 * MaxMedianRadius + 1)];
+		int count = 0;
+		for (int k = -r; k <= r; k++)
+		{
+			for (int l = -r; l <= r; l++)
+				window[count++] = n(k, l);
+		}
+		std::nth_element(window, window + count / 2, window + count);
+		return window[count / 2];
+	});
+}
@@ -0,0 +1,148 @@
+#include "fieldPyramid.h"
+
+/*
+\class FieldPyramid fieldPyramid.h
+\brief Multi-resolution pyramid of a field : level 0 is the field, and every level halves the resolution of the previous one.
+Levels cover the same box. Samples are treated as cells : coarse cell (i, j) averages the fine cells (2i, 2j) to
+(2i + 1, 2j + 1), and upsampling interpolates bilinearly between cell centers, so that going down and back up
+does not shift the field.
+*/
+
+// Cells per parallel chunk of rows
+static const int ChunkCells = 16384;
+
+/*
+\brief Default constructor, creates an empty pyramid.
+*/
+FieldPyramid::FieldPyramid()
+{
+}
+
+/*
+\brief Constructor from a field.
+\param field finest level
+\param levelCount level count, including the field
+*/
+FieldPyramid::FieldPyramid(const ScalarField2D& field, int levelCount)
+{
+	Build(field, levelCount);
+}
+
+/*
+\brief Build the pyramid of a field. Levels stop before the resolution gets below 2 x 2.
+\param field finest level
+\param levelCount level count, including the field
+*/
+void FieldPyramid::Build(const ScalarField2D& field, int levelCount)
+{
+	levels.clear();
+	levels.reserve(levelCount);
+	levels.push_back(field);
+	while (int(levels.size()) < levelCount && levels.back().SizeX() >= 4 && levels.back().SizeY() >= 4)
+		levels.push_back(Downsample(levels.back()));
+}
+
+/*
+\brief Get the level count.
+*/
+int FieldPyramid::LevelCount() const
+{
+	return int(levels.size());
+}
+
+/*
+\brief Get a level, 0 being the finest.
+*/
+const ScalarField2D& FieldPyramid::Level(int l) const
+{
+	return levels[l];
+}
+
+/*
+\brief Get a level, 0 being the finest.
+*/
+ScalarField2D& FieldPyramid::Level(int l)
+{
+	return levels[l];
+}
+
+/*
+\brief Halve the resolution of a field by averaging blocks of 2 x 2 cells, rounding the resolution up.
+Rows are processed in parallel.
+*/
+ScalarField2D FieldPyramid::Downsample(const ScalarField2D& field)
+{
+	int nx = field.SizeX();
+	int ny = field.SizeY();
+	int cx = (nx + 1) / 2;
+	int cy = (ny + 1) / 2;
+	ScalarField2D ret(cx, cy, field.GetBox());
+	const float* src = field.Data();
+	float* dst = ret.Data();
+	TaskScheduler::Global().ParallelFor(0, cy, [&](int first, int last)
+	{
+		for (int i = first; i < last; i++)
+		{
+			const float* a = src + size_t(2 * i) * nx;
+			const float* b = src + size_t(Math::Min(2 * i + 1, ny - 1)) * nx;
+			float* out = dst + size_t(i) * cx;
+			int even = nx / 2;
+			for (int j = 0; j < even; j++)
+				out[j] = 0.25f * (a[2 * j] + a[2 * j + 1] + b[2 * j] + b[2 * j + 1]);
+			if (even < cx)
+				out[even] = 0.5f * (a[nx - 1] + b[nx - 1]);
+		}
+	}, Math::Max(1, ChunkCells / nx));
+	return ret;
+}
+
+/*
+\brief Double the resolution of a field by bilinear interpolation between cell centers, with clamped borders,
+which inverts Downsample() for linear fields. Every output row blends two source rows, then interpolates along
+the row from precomputed indices and weights.
+\param field coarse field
+\param nx, ny resolution of the returned field, twice the resolution of the field or one less for odd finer levels
+*/
+ScalarField2D FieldPyramid::Upsample(const ScalarField2D& field, int nx, int ny)
+{
+	int cx = field.SizeX();
+	int cy = field.SizeY();
+	ScalarField2D ret(nx, ny, field.GetBox());
+
+	// Source cells and weights along the rows
+	std::vector<int> left(nx), right(nx);
+	std::vector<float> weight(nx);
+	for (int j = 0; j < nx; j++)
+	{
+		float u = Math::Clamp(0.5f * j - 0.25f, 0.0f, float(cx - 1));
+		left[j] = int(u);
+		right[j] = Math::Min(left[j] + 1, cx - 1);
+		weight[j] = u - left[j];
+	}
+
+	const float* src = field.Data();
+	float* dst = ret.Data();
+	TaskScheduler::Global().ParallelFor(0, ny, [&](int first, int last)
+	{
+		std::vector<float> row(cx);
+		for (int i = first; i < last; i++)
+		{
+			float v = Math::Clamp(0.5f * i - 0.25f, 0.0f, float(cy - 1));
+			int i0 = int(v);
+			float w = v - i0;
+			const float* a = src + size_t(i0) * cx;
+			const float* b = src + size_t(Math::Min(i0 + 1, cy - 1)) * cx;
+			for (int j = 0; j < cx; j++)
+				row[j] = a[j] + w * (b[j] - a[j]);
+
+			float* out = dst + size_t(i) * nx;
+			for (int j = 0; j < nx; j++)
+			{
+				float x0 = row[left[j]];
+				float x1 = row[right[j]];
+				out[j] = x0 + weight[j] * (x1 - x0);
+			}
+		}
+	}, Math::Max(1, ChunkCells / nx));
+	return ret;
+}
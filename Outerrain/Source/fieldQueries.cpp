@@ -0,0 +1,277 @@
+#include "fieldQueries.h"
+
+#include <limits>
+
+/*
+\class SummedAreaTable fieldQueries.h
+\brief Summed area table : entry (i + 1, j + 1) holds the sum of the cells [0, i] x [0, j], in double precision
+so that large tables keep the precision of the field. Rectangle sums take four lookups.
+Rectangles are given by their first and last cells (i, j), included.
+*/
+
+/*
+\brief Default constructor, creates an empty table.
+*/
+SummedAreaTable::SummedAreaTable() : nx(0), ny(0)
+{
+}
+
+/*
+\brief Constructor from a field.
+*/
+SummedAreaTable::SummedAreaTable(const ScalarField2D& field) : nx(0), ny(0)
+{
+	Build(field);
+}
+
+/*
+\brief Build the table of a field.
+*/
+void SummedAreaTable::Build(const ScalarField2D& field)
+{
+	nx = field.SizeX();
+	ny = field.SizeY();
+	table.assign(size_t(nx + 1) * (ny + 1), 0.0);
+	Update(field, Vector2i(0, 0), Vector2i(ny - 1, nx - 1));
+}
+
+/*
+\brief Update the table after the cells of a rectangle changed. Every sum whose range covers the rectangle changes,
+so the entries below and right of its first cell are recomputed, in two parallel passes : prefix sums along the rows,
+then accumulation of the rows along the columns, processed by blocks of columns so that the inner loop vectorizes.
+\param field modified field
+\param min first cell (i, j) of the rectangle
+\param max last cell (i, j) of the rectangle, included
+*/
+void SummedAreaTable::Update(const ScalarField2D& field, const Vector2i& min, const Vector2i&)
+{
+	int i0 = Math::Max(min.x, 0);
+	int j0 = Math::Max(min.y, 0);
+	int stride = nx + 1;
+	const float* values = field.Data();
+	double* s = table.data();
+
+	// Row prefix sums, starting from the unchanged prefix of the row : S(i + 1, j0) - S(i, j0)
+	TaskScheduler::Global().ParallelFor(i0, ny, [&](int first, int last)
+	{
+		for (int i = first; i < last; i++)
+		{
+			double sum = s[(i + 1) * stride + j0] - s[i * stride + j0];
+			const float* row = values + i * nx;
+			double* out = s + (i + 1) * stride + 1;
+			for (int j = j0; j < nx; j++)
+			{
+				sum += row[j];
+				out[j] = sum;
+			}
+		}
+	});
+
+	// Column accumulation, starting from the unchanged row i0
+	const int block = 256;
+	TaskScheduler::Global().ParallelFor(j0 + 1, nx + 1, [&](int first, int last)
+	{
+		for (int i = i0 + 1; i <= ny; i++)
+		{
+			double* out = s + i * stride;
+			const double* above = s + (i - 1) * stride;
+			for (int j = first; j < last; j++)
+				out[j] += above[j];
+		}
+	}, block);
+}
+
+/*
+\brief Compute the sum of the cells of a rectangle.
+\param min first cell (i, j) of the rectangle
+\param max last cell (i, j) of the rectangle, included
+*/
+double SummedAreaTable::Sum(const Vector2i& min, const Vector2i& max) const
+{
+	int stride = nx + 1;
+	return table[(max.x + 1) * stride + max.y + 1] - table[min.x * stride + max.y + 1] - table[(max.x + 1) * stride + min.y] + table[min.x * stride + min.y];
+}
+
+/*
+\brief Compute the mean of the cells of a rectangle.
+\param min first cell (i, j) of the rectangle
+\param max last cell (i, j) of the rectangle, included
+*/
+float SummedAreaTable::Mean(const Vector2i& min, const Vector2i& max) const
+{
+	double count = double(max.x - min.x + 1) * double(max.y - min.y + 1);
+	return float(Sum(min, max) / count);
+}
+
+/*
+\class MinMaxPyramid fieldQueries.h
+\brief Hierarchy of the minimum and maximum values of a field : level l holds the range of blocks of 2^l x 2^l cells,
+level 0 being the field itself, up to a single block. It takes a third of the field memory per value.
+Range() returns the exact extrema of a rectangle by descending the blocks which overlap it partially : blocks fully inside
+are used as is, and blocks which cannot change the current extrema are skipped, so the cost depends on the rectangle
+perimeter instead of its area. Bounds() returns a conservative range in O(log n) from at most four blocks,
+which is enough for culling. Rectangles are given by their first and last cells (i, j), included.
+*/
+
+/*
+\brief Default constructor, creates an empty pyramid.
+*/
+MinMaxPyramid::MinMaxPyramid()
+{
+}
+
+/*
+\brief Constructor from a field.
+*/
+MinMaxPyramid::MinMaxPyramid(const ScalarField2D& field)
+{
+	Build(field);
+}
+
+/*
+\brief Build the pyramid of a field. Every level is computed in parallel from the previous one.
+*/
+void MinMaxPyramid::Build(const ScalarField2D& field)
+{
+	levels.clear();
+	Level base;
+	base.nx = field.SizeX();
+	base.ny = field.SizeY();
+	levels.push_back(base);
+	while (levels.back().nx > 1 || levels.back().ny > 1)
+	{
+		Level level;
+		level.nx = (levels.back().nx + 1) / 2;
+		level.ny = (levels.back().ny + 1) / 2;
+		level.min.resize(size_t(level.nx) * level.ny);
+		level.max.resize(size_t(level.nx) * level.ny);
+		levels.push_back(level);
+	}
+	Update(field, Vector2i(0, 0), Vector2i(base.ny - 1, base.nx - 1));
+}
+
+/*
+\brief Recompute the blocks [i0, i1] x [j0, j1] of a level from the level below, internal function.
+*/
+void MinMaxPyramid::Reduce(int l, int i0, int j0, int i1, int j1)
+{
+	Level& level = levels[l];
+	const Level& below = levels[l - 1];
+	const float* lo = below.min.data();
+	const float* hi = l == 1 ? below.min.data() : below.max.data();
+	TaskScheduler::Global().ParallelFor(i0, i1 + 1, [&](int first, int last)
+	{
+		for (int i = first; i < last; i++)
+		{
+			int a = 2 * i, b = Math::Min(2 * i + 1, below.ny - 1);
+			for (int j = j0; j <= j1; j++)
+			{
+				int c = 2 * j, d = Math::Min(2 * j + 1, below.nx - 1);
+				level.min[i * level.nx + j] = Math::Min(Math::Min(lo[a * below.nx + c], lo[a * below.nx + d]), Math::Min(lo[b * below.nx + c], lo[b * below.nx + d]));
+				level.max[i * level.nx + j] = Math::Max(Math::Max(hi[a * below.nx + c], hi[a * below.nx + d]), Math::Max(hi[b * below.nx + c], hi[b * below.nx + d]));
+			}
+		}
+	}, Math::Max(1, 4096 / Math::Max(j1 - j0 + 1, 1)));
+}
+
+/*
+\brief Update the pyramid after the cells of a rectangle changed : only the blocks containing the rectangle are recomputed.
+\param field modified field
+\param min first cell (i, j) of the rectangle
+\param max last cell (i, j) of the rectangle, included
+*/
+void MinMaxPyramid::Update(const ScalarField2D& field, const Vector2i& min, const Vector2i& max)
+{
+	Level& base = levels[0];
+	base.min.resize(size_t(base.nx) * base.ny);
+	for (int i = min.x; i <= max.x; i++)
+		std::copy(field.Data() + i * base.nx + min.y, field.Data() + i * base.nx + max.y + 1, base.min.data() + i * base.nx + min.y);
+
+	int i0 = min.x, j0 = min.y, i1 = max.x, j1 = max.y;
+	for (int l = 1; l < int(levels.size()); l++)
+	{
+		i0 /= 2;
+		j0 /= 2;
+		i1 /= 2;
+		j1 /= 2;
+		Reduce(l, i0, j0, i1, j1);
+	}
+}
+
+/*
+\brief Gather the extrema of the cells of a rectangle inside block (i, j) of level l, internal function.
+*/
+void MinMaxPyramid::Descend(int l, int i, int j, const Vector2i& a, const Vector2i& b, float& min, float& max) const
+{
+	const Level& level = levels[l];
+	int id = i * level.nx + j;
+	float lo = level.min[id];
+	float hi = l == 0 ? lo : level.max[id];
+	if (lo >= min && hi <= max)
+		return;
+
+	// Cells covered by the block
+	int ci0 = i << l, cj0 = j << l;
+	int ci1 = ((i + 1) << l) - 1, cj1 = ((j + 1) << l) - 1;
+	if (ci1 < a.x || ci0 > b.x || cj1 < a.y || cj0 > b.y)
+		return;
+	if (l == 0 || (ci0 >= a.x && ci1 <= b.x && cj0 >= a.y && cj1 <= b.y))
+	{
+		min = Math::Min(min, lo);
+		max = Math::Max(max, hi);
+		return;
+	}
+
+	const Level& below = levels[l - 1];
+	for (int k = 2 * i; k <= Math::Min(2 * i + 1, below.ny - 1); k++)
+	{
+		for (int m = 2 * j; m <= Math::Min(2 * j + 1, below.nx - 1); m++)
+			Descend(l - 1, k, m, a, b, min, max);
+	}
+}
+
+/*
+\brief Compute the exact extrema of the cells of a rectangle.
+\param a first cell (i, j) of the rectangle
+\param b last cell (i, j) of the rectangle, included
+\param min, max returned extrema
+*/
+void MinMaxPyramid::Range(const Vector2i& a, const Vector2i& b, float& min, float& max) const
+{
+	min = std::numeric_limits<float>::max();
+	max = -std::numeric_limits<float>::max();
+	Descend(int(levels.size()) - 1, 0, 0, a, b, min, max);
+}
+
+/*
+\brief Compute a conservative range of the cells of a rectangle, from the blocks of the finest level
+where the rectangle spans at most two blocks along each axis.
+\param a first cell (i, j) of the rectangle
+\param b last cell (i, j) of the rectangle, included
+\param min, max returned range, containing the extrema of the rectangle
+*/
+void MinMaxPyramid::Bounds(const Vector2i& a, const Vector2i& b, float& min, float& max) const
+{
+	int l = 0;
+	while ((b.x >> l) - (a.x >> l) > 1 || (b.y >> l) - (a.y >> l) > 1)
+		l++;
+	const Level& level = levels[l];
+	min = std::numeric_limits<float>::max();
+	max = -std::numeric_limits<float>::max();
+	for (int i = a.x >> l; i <= (b.x >> l); i++)
+	{
+		for (int j = a.y >> l; j <= (b.y >> l); j++)
+		{
+			min = Math::Min(min, level.min[i * level.nx + j]);
+			max = Math::Max(max, l == 0 ? level.min[i * level.nx + j] : level.max[i * level.nx + j]);
+		}
+	}
+}
+
+/*
+\brief Get the level count, the last level being a single block.
+*/
+int MinMaxPyramid::LevelCount() const
+{
+	return int(levels.size());
+}
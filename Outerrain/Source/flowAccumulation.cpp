@@ -0,0 +1,196 @@
+#include "flowAccumulation.h"
+#include "taskScheduler.h"
+
+/*
+\class FlowAccumulation flowAccumulation.h
+\brief Single flow direction drainage of a heightfield, kept up to date after local edits.
+Every cell drains to its steepest lower neighbour, its receiver, and accumulates the area of all the cells
+upstream, counted in cells like HeightField::DrainageArea(). The heightfield is referenced, not copied :
+after modifying a region, call Update() with this region and only the flow directions around it are
+recomputed, the accumulation changes being propagated downstream along the receiver chains.
+*/
+
+/*
+\brief Constructor, computes the whole drainage.
+\param hf heightfield, which must outlive the structure
+*/
+FlowAccumulation::FlowAccumulation(const HeightField& hf) : hf(hf), lastUpdateCount(0)
+{
+	Compute();
+}
+
+/*
+\brief Compute the receiver of a cell, or the cell itself for a local minimum.
+*/
+int FlowAccumulation::ComputeReceiver(int i, int j) const
+{
+	static const float invDiagonal = 1.0f / sqrt(2.0f);
+	int nx = hf.SizeX();
+	int id = i * nx + j;
+	float h = hf.Get(id);
+	float steepest = 0.0f;
+	int ret = id;
+	for (int k = -1; k <= 1; k++)
+	{
+		for (int l = -1; l <= 1; l++)
+		{
+			if ((k == 0 && l == 0) || hf.Inside(i + k, j + l) == false)
+				continue;
+			int n = id + k * nx + l;
+			float s = h - hf.Get(n);
+			if (k != 0 && l != 0)
+				s *= invDiagonal;
+			if (s > steepest)
+			{
+				steepest = s;
+				ret = n;
+			}
+		}
+	}
+	return ret;
+}
+
+/*
+\brief Compute the whole drainage : receivers in parallel, then accumulation in topological order, in linear time.
+*/
+void FlowAccumulation::Compute()
+{
+	int nx = hf.SizeX();
+	int ny = hf.SizeY();
+	int size = nx * ny;
+	receivers.resize(size);
+	accumulation.assign(size, 1.0f);
+	TaskScheduler::Global().ParallelFor(0, ny, [&](int first, int last)
+	{
+		for (int i = first; i < last; i++)
+		{
+			for (int j = 0; j < nx; j++)
+				receivers[i * nx + j] = ComputeReceiver(i, j);
+		}
+	}, 16);
+
+	// Cells are released once all their donors have been accumulated
+	std::vector<int> donorCount(size, 0);
+	for (int id = 0; id < size; id++)
+	{
+		if (receivers[id] != id)
+			donorCount[receivers[id]]++;
+	}
+	std::vector<int> ready;
+	ready.reserve(size);
+	for (int id = 0; id < size; id++)
+	{
+		if (donorCount[id] == 0)
+			ready.push_back(id);
+	}
+	for (size_t k = 0; k < ready.size(); k++)
+	{
+		int id = ready[k];
+		int r = receivers[id];
+		if (r == id)
+			continue;
+		accumulation[r] += accumulation[id];
+		if (--donorCount[r] == 0)
+			ready.push_back(r);
+	}
+	lastUpdateCount = size;
+}
+
+/*
+\brief Add a delta to the accumulation of a cell and of all the cells downstream.
+*/
+void FlowAccumulation::Propagate(int id, float delta)
+{
+	while (true)
+	{
+		accumulation[id] += delta;
+		lastUpdateCount++;
+		int r = receivers[id];
+		if (r == id)
+			return;
+		id = r;
+	}
+}
+
+/*
+\brief Update the drainage after the heights of a rectangle of cells changed.
+Receivers are recomputed in the rectangle and its one cell border. Every cell whose receiver changed is first
+detached, removing its accumulation from its old downstream chain, then attached to its new receiver.
+Both phases only ever use a subset of an acyclic receiver graph, so the chains always end, and the result
+is the same as a full Compute(), in time proportional to the changed cells and their downstream paths.
+\param min first cell (i, j) of the rectangle
+\param max last cell (i, j) of the rectangle, included
+*/
+void FlowAccumulation::Update(const Vector2i& min, const Vector2i& max)
+{
+	int nx = hf.SizeX();
+	int ny = hf.SizeY();
+	int i0 = Math::Max(min.x - 1, 0), i1 = Math::Min(max.x + 1, ny - 1);
+	int j0 = Math::Max(min.y - 1, 0), j1 = Math::Min(max.y + 1, nx - 1);
+	lastUpdateCount = 0;
+
+	std::vector<int> changed;
+	std::vector<int> newReceivers;
+	for (int i = i0; i <= i1; i++)
+	{
+		for (int j = j0; j <= j1; j++)
+		{
+			int id = i * nx + j;
+			int r = ComputeReceiver(i, j);
+			if (r != receivers[id])
+			{
+				changed.push_back(id);
+				newReceivers.push_back(r);
+			}
+		}
+	}
+
+	for (size_t k = 0; k < changed.size(); k++)
+	{
+		int id = changed[k];
+		if (receivers[id] != id)
+			Propagate(receivers[id], -accumulation[id]);
+		receivers[id] = id;
+	}
+	for (size_t k = 0; k < changed.size(); k++)
+	{
+		int id = changed[k];
+		receivers[id] = newReceivers[k];
+		if (receivers[id] != id)
+			Propagate(receivers[id], accumulation[id]);
+	}
+}
+
+/*
+\brief Get the receiver index of a cell, equal to the cell index for local minima.
+*/
+int FlowAccumulation::Receiver(int i, int j) const
+{
+	return receivers[i * hf.SizeX() + j];
+}
+
+/*
+\brief Get the accumulated drainage area of a cell, in cells.
+*/
+float FlowAccumulation::Get(int i, int j) const
+{
+	return accumulation[i * hf.SizeX() + j];
+}
+
+/*
+\brief Get the number of cells touched by the last Compute() or Update() call.
+*/
+int FlowAccumulation::LastUpdateCount() const
+{
+	return lastUpdateCount;
+}
+
+/*
+\brief Get the drainage area field.
+*/
+ScalarField2D FlowAccumulation::DrainageArea() const
+{
+	ScalarField2D ret(hf.SizeX(), hf.SizeY(), hf.GetBox());
+	std::copy(accumulation.begin(), accumulation.end(), ret.Data());
+	return ret;
+}
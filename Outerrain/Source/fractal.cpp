@@ -1,5 +1,8 @@
 #include "fractal.h"
 
+#include <vector>
+#include <algorithm>
+
 /*
 \brief Various custom fractal are implemented in this file, mostly from https://ordinatous.com/pdf/The_Fractal_Geometry_of_Nature.pdf.
 */
@@ -50,6 +53,73 @@ float Fractal::fBm(const Noise& n, const Vector2& point, float a, float f, int o
 	return ret;
 }
 
+/*
+\brief 2D Fractional Brownian motion evaluated on an array of points.
+Each octave is computed for all points at once through Noise::GetValues, which lets noises provide a vectorized path.
+\param n noise used for the fractal
+\param points points in 2D
+\param values returned fractal values
+\param count point count
+\param a noise amplitude
+\param f noise frequency
+\param octave octave count
+*/
+void Fractal::fBm(const Noise& n, const Vector2* points, float* values, int count, float a, float f, int octaves)
+{
+	std::vector<Vector2> scaled(count);
+	std::vector<float> octave(count);
+	std::fill(values, values + count, 0.0f);
+	float freq = f;
+	float amp = a;
+	for (int i = 0; i < octaves; i++)
+	{
+		for (int k = 0; k < count; k++)
+			scaled[k] = points[k] * freq;
+		n.GetValues(scaled.data(), octave.data(), count);
+		for (int k = 0; k < count; k++)
+			values[k] += octave[k] * amp;
+		amp *= 0.5f;
+		freq *= 2.0f;
+	}
+}
+
+/*
+\brief Evaluate a terrain fractal on an array of 2D points, with the amplitude mapping used by heightfields.
+\param n noise used for the fractal
+\param type fractal type. See enum.
+\param points points in 2D
+\param values returned heights
+\param count point count
+\param a noise amplitude
+\param f noise frequency
+\param octaves octave count
+*/
+void Fractal::Evaluate(const Noise& n, FractalType type, const Vector2* points, float* values, int count, float a, float f, int octaves)
+{
+	if (type == FractalType::fBm)
+	{
+		fBm(n, points, values, count, a, f, octaves);
+		return;
+	}
+
+	for (int k = 0; k < count; k++)
+	{
+		Vector2 p = points[k];
+		float h = 0.0f;
+		if (type == FractalType::Ridge)
+			h = RidgeNoise(n, p * f, a, f, octaves);
+		else if (type == FractalType::MusgravefBm)
+			h = (a / 2.0f) * MusgravefBm(n, p * f, 1.0f, 2.0f, float(octaves));
+		else if (type == FractalType::MusgraveHeteroTerrain)
+			h = a * (MusgraveHeteroTerrain(n, p * f, 1.0f, 2.0f, float(octaves), 1.0f) * 0.5f - 0.5f);
+		else if (type == FractalType::MusgraveHybridMultifractal)
+			h = a * MusgraveHybridMultifractal(n, p * f, 0.25f, 2.0f, float(octaves), 0.7f);
+		else if (type == FractalType::MusgraveRidgedMultifractal)
+			h = a * MusgraveRidgedMultifractal(n, p * f, 1.0f, 2.0f, float(octaves), 1.0f, 2.0f);
+		values[k] = h;
+	}
+}
+
 /*
 \brief Simple implementation of Ridge noise, which is defined as abs(noise(p)) * -1.0f.
 If you want to translate the noise, translate the point parameters before calling the function.
@@ -72,3 +142,26 @@ float Fractal::RidgeNoise(const Noise& n, const Vector3& point, float a, float f
 	}
 	return ret;
 }
+
+/*
+\brief 2D Ridge noise, defined as abs(noise(p)) * -1.0f.
+If you want to translate the noise, translate the point parameters before calling the function.
+\param n noise used for the fractal
+\param point point in 2D
+\param a noise amplitude
+\param f noise frequency
+\param octaves octave count
+*/
+float Fractal::RidgeNoise(const Noise& n, const Vector2& point, float a, float f, int octaves)
+{
+	float ret = 0.0f;
+	float freq = f;
+	float amp = a;
+	for (int i = 0; i < octaves; i++)
+	{
+		ret += amp * fabs(n.GetValue(point * freq)) * -1.0f;
+		amp *= 0.5f;
+		freq *= 2.0f;
+	}
+	return ret;
+}
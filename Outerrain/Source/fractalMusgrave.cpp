@@ -1,4 +1,4 @@
-#include <fractal.h>
+#include "fractal.h"
 
 /*
 \brief All these functions are copied/pasted from Musgrave article :
@@ -7,21 +7,31 @@ https://www.classes.cs.uchicago.edu/archive/2015/fall/23700-1/final-project/Musg
 And adapted a little to match with C++.
 */
 
-static float* exponent_array = nullptr;
+static const int MaxOctaves = 32;
 
-static void InitExponentArrays(float lacunarity, float octaves, float H)
+/*
+\brief Spectral weights of each octave, ie pow(lacunarity^i, -H).
+Kept on the stack so that the fractals can be evaluated from several threads.
+*/
+struct ExponentArray
 {
-	delete exponent_array;
+	float values[MaxOctaves + 1];
 
-	float frequency;
-	exponent_array = new float[int(octaves) + 1];
-	frequency = 1.0;
-	for (int i = 0; i <= octaves; i++)
+	ExponentArray(float lacunarity, float octaves, float H)
 	{
-		exponent_array[i] = pow(frequency, -H);
-		frequency *= lacunarity;
+		float frequency = 1.0;
+		for (int i = 0; i <= octaves && i <= MaxOctaves; i++)
+		{
+			values[i] = pow(frequency, -H);
+			frequency *= lacunarity;
+		}
 	}
-}
+
+	float operator[](int i) const
+	{
+		return values[i];
+	}
+};
 
 /*
  * Procedural fBm evaluated at "point"; returns value stored in "value".
@@ -33,18 +43,18 @@ static void InitExponentArrays(float lacunarity, float octaves, float H)
  *    ``lacunarity''  is the gap between successive frequencies
  *    ``octaves''  is the number of frequencies in the fBm
  */
-float Fractal::MusgravefBm(const Noise& n, Vector3 point, float H, float lacunarity, float octaves)
+template<typename Point>
+static float MusgravefBmT(const Noise& n, Point point, float H, float lacunarity, float octaves)
 {
-	InitExponentArrays(lacunarity, octaves, H);
+	octaves = Math::Min(octaves, float(MaxOctaves));
+	ExponentArray exponent_array(lacunarity, octaves, H);
 
 	float value = 0.0;
 	int i = 0;
 	for (; i < octaves; i++)
 	{
 		value += n.GetValue(point) * exponent_array[i];
-		point.x *= lacunarity;
-		point.y *= lacunarity;
-		point.z *= lacunarity;
+		point = point * lacunarity;
 	}
 
 	float remainder = octaves - int(octaves);
@@ -65,15 +75,15 @@ float Fractal::MusgravefBm(const Noise& n, Vector3 point, float H, float lacunar
  *       ``octaves''  is the number of frequencies in the fBm
  *       ``offset''  raises the terrain from `sea level'
  */
-float Fractal::MusgraveHeteroTerrain(const Noise& n, Vector3 point, float H, float lacunarity, float octaves, float offset)
+template<typename Point>
+static float MusgraveHeteroTerrainT(const Noise& n, Point point, float H, float lacunarity, float octaves, float offset)
 {
-	InitExponentArrays(lacunarity, octaves, H);
+	octaves = Math::Min(octaves, float(MaxOctaves));
+	ExponentArray exponent_array(lacunarity, octaves, H);
 
 	/* first unscaled octave of function; later octaves are scaled */
 	float value = offset + n.GetValue(point);
-	point.x *= lacunarity;
-	point.y *= lacunarity;
-	point.z *= lacunarity;
+	point = point * lacunarity;
 
 	/* spectral construction inner loop, where the fractal is built */
 	int i = 0;
@@ -93,9 +103,7 @@ float Fractal::MusgraveHeteroTerrain(const Noise& n, Vector3 point, float H, flo
 		value += increment;
 
 		/* raise spatial frequency */
-		point.x *= lacunarity;
-		point.y *= lacunarity;
-		point.z *= lacunarity;
+		point = point * lacunarity;
 	}
 
 	/* take care of remainder in ``octaves''  */
@@ -118,18 +126,18 @@ float Fractal::MusgraveHeteroTerrain(const Noise& n, Vector3 point, float H, flo
  *      H:           0.25
  *      offset:      0.7
  */
-float Fractal::MusgraveHybridMultifractal(const Noise& n, Vector3 point, float H, float lacunarity, float octaves, float offset)
+template<typename Point>
+static float MusgraveHybridMultifractalT(const Noise& n, Point point, float H, float lacunarity, float octaves, float offset)
 {
-	InitExponentArrays(lacunarity, octaves, H);
+	octaves = Math::Min(octaves, float(MaxOctaves));
+	ExponentArray exponent_array(lacunarity, octaves, H);
 
 	/* get first octave of function */
 	float result = (n.GetValue(point) + offset) * exponent_array[0];
 	float weight = result;
 
 	/* increase frequency */
-	point.x *= lacunarity;
-	point.y *= lacunarity;
-	point.z *= lacunarity;
+	point = point * lacunarity;
 
 	/* spectral construction inner loop, where the fractal is built */
 	int i = 1;
@@ -149,9 +157,7 @@ float Fractal::MusgraveHybridMultifractal(const Noise& n, Vector3 point, float H
 		weight *= signal;
 
 		/* increase frequency */
-		point.x *= lacunarity;
-		point.y *= lacunarity;
-		point.z *= lacunarity;
+		point = point * lacunarity;
 	}
 
 	/* take care of remainder in ``octaves''  */
@@ -171,9 +177,11 @@ float Fractal::MusgraveHybridMultifractal(const Noise& n, Vector3 point, float H
  *      offset:      1.0
  *      gain:        2.0
  */
-float Fractal::MusgraveRidgedMultifractal(const Noise& n, Vector3 point, float H, float lacunarity, float octaves, float offset, float gain)
+template<typename Point>
+static float MusgraveRidgedMultifractalT(const Noise& n, Point point, float H, float lacunarity, float octaves, float offset, float gain)
 {
-	InitExponentArrays(lacunarity, octaves, H);
+	octaves = Math::Min(octaves, float(MaxOctaves));
+	ExponentArray exponent_array(lacunarity, octaves, H);
 
 	/* get first octave */
 	float signal = n.GetValue(point);
@@ -195,9 +203,7 @@ float Fractal::MusgraveRidgedMultifractal(const Noise& n, Vector3 point, float H
 	for (; i < octaves; i++)
 	{
 		/* increase the frequency */
-		point.x *= lacunarity;
-		point.y *= lacunarity;
-		point.z *= lacunarity;
+		point = point * lacunarity;
 		/* weight successive contributions by previous signal */
 		weight = signal * gain;
 		if (weight > 1.0)
@@ -217,3 +223,46 @@ float Fractal::MusgraveRidgedMultifractal(const Noise& n, Vector3 point, float H
 
 	return result;
 }
+
+/*
+\brief Public entry points. The 2D versions are meant for heightfields and avoid paying for 3D noise.
+*/
+float Fractal::MusgravefBm(const Noise& n, const Vector3& point, float H, float lacunarity, float octaves)
+{
+	return MusgravefBmT(n, point, H, lacunarity, octaves);
+}
+
+float Fractal::MusgravefBm(const Noise& n, const Vector2& point, float H, float lacunarity, float octaves)
+{
+	return MusgravefBmT(n, point, H, lacunarity, octaves);
+}
+
+float Fractal::MusgraveHeteroTerrain(const Noise& n, const Vector3& point, float H, float lacunarity, float octaves, float offset)
+{
+	return MusgraveHeteroTerrainT(n, point, H, lacunarity, octaves, offset);
+}
+
+float Fractal::MusgraveHeteroTerrain(const Noise& n, const Vector2& point, float H, float lacunarity, float octaves, float offset)
+{
+	return MusgraveHeteroTerrainT(n, point, H, lacunarity, octaves, offset);
+}
+
+float Fractal::MusgraveHybridMultifractal(const Noise& n, const Vector3& point, float H, float lacunarity, float octaves, float offset)
+{
+	return MusgraveHybridMultifractalT(n, point, H, lacunarity, octaves, offset);
+}
+
+float Fractal::MusgraveHybridMultifractal(const Noise& n, const Vector2& point, float H, float lacunarity, float octaves, float offset)
+{
+	return MusgraveHybridMultifractalT(n, point, H, lacunarity, octaves, offset);
+}
+
+float Fractal::MusgraveRidgedMultifractal(const Noise& n, const Vector3& point, float H, float lacunarity, float octaves, float offset, float gain)
+{
+	return MusgraveRidgedMultifractalT(n, point, H, lacunarity, octaves, offset, gain);
+}
+
+float Fractal::MusgraveRidgedMultifractal(const Noise& n, const Vector2& point, float H, float lacunarity, float octaves, float offset, float gain)
+{
+	return MusgraveRidgedMultifractalT(n, point, H, lacunarity, octaves, offset, gain);
+}
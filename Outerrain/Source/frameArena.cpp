@@ -0,0 +1,111 @@
+#include "frameArena.h"
+
+/*
+\class FrameArena frameArena.h
+\brief Bump allocator for the temporaries of a step, with chunks counted in the MemoryScratch subsystem.
+Allocations larger than ChunkSize get a chunk of their own, which is kept as well : the arena grows to the
+largest step it has served and stops allocating.
+*/
+
+FrameArena::FrameArena() : current(0), offset(0)
+{
+}
+
+FrameArena::~FrameArena()
+{
+	Release();
+}
+
+/*
+\brief Get the arena of the calling thread.
+*/
+FrameArena& FrameArena::Local()
+{
+	static thread_local FrameArena arena;
+	return arena;
+}
+
+/*
+\brief Get bytes from the current chunk, or from the next chunk large enough, internal function.
+Chunks too small for the request are skipped, they are used again once the arena is rewound.
+*/
+void* FrameArena::AllocateBytes(size_t bytes)
+{
+	size_t size = (bytes + AlignedMemory::Alignment - 1) & ~(AlignedMemory::Alignment - 1);
+	if (current < chunks.size() && offset + size <= chunks[current].size)
+	{
+		void* p = chunks[current].data + offset;
+		offset += size;
+		return p;
+	}
+
+	// The current chunk is full : move to the next chunk which holds the request, or insert a new one
+	size_t next = chunks.empty() ? 0 : current + 1;
+	while (next < chunks.size() && chunks[next].size < size)
+		next++;
+	if (next == chunks.size())
+	{
+		Chunk chunk;
+		chunk.size = size > ChunkSize ? size : ChunkSize;
+		chunk.data = static_cast<char*>(AlignedMemory::Allocate(chunk.size, MemoryScratch));
+		if (chunk.data == nullptr)
+			throw std::bad_alloc();
+		next = chunks.empty() ? 0 : current + 1;
+		chunks.insert(chunks.begin() + next, chunk);
+	}
+	current = next;
+	offset = size;
+	return chunks[current].data;
+}
+
+/*
+\brief Get the current position of the arena.
+*/
+FrameArena::Marker FrameArena::Mark() const
+{
+	Marker marker;
+	marker.chunk = current;
+	marker.offset = offset;
+	return marker;
+}
+
+/*
+\brief Free all the allocations made since a position was marked. Chunks are kept.
+*/
+void FrameArena::Rewind(const Marker& marker)
+{
+	current = marker.chunk;
+	offset = marker.offset;
+}
+
+/*
+\brief Free all the allocations. Chunks are kept.
+*/
+void FrameArena::Reset()
+{
+	current = 0;
+	offset = 0;
+}
+
+/*
+\brief Free all the allocations and give the chunks back to the system.
+*/
+void FrameArena::Release()
+{
+	for (const Chunk& chunk : chunks)
+		AlignedMemory::Free(chunk.data, chunk.size, MemoryScratch);
+	chunks.clear();
+	current = 0;
+	offset = 0;
+}
+
+/*
+\brief Get the memory held by the chunks, in bytes.
+*/
+size_t FrameArena::Capacity() const
+{
+	size_t bytes = 0;
+	for (const Chunk& chunk : chunks)
+		bytes += chunk.size;
+	return bytes;
+}
@@ -2,7 +2,10 @@
 #include "vec.h"
 #include "fractal.h"
 #include "mathUtils.h"
-#include "random.h"
+#include "randomStream.h"
+#include "flowAccumulation.h"
+#include "taskScheduler.h"
+#include "bufferPool.h"
 
 #include <iostream>
 #include <numeric>
@@ -10,8 +13,6 @@
 #include <queue>
 #include <array>
 
-using Random = effolkronium::random_static;
-
 /*
 \brief Main Class for representing 2D HeightField.
 Various functions and erosion processes are available (Wetness, Slope.. ; Thermal, Stream Power erosion...)
@@ -49,6 +50,19 @@ HeightField::HeightField(int nx, int ny, const Box2D& bbox, float value) : Scala
 
 }
 
+/*
+\brief Constructor, with values first touched in parallel for large fields on NUMA machines, see FieldAllocation.
+\param nx width size of field
+\param ny height size of field
+\param bbox bounding box of the domain
+\param value default value for the field
+\param allocation how values are written for the first time
+*/
+HeightField::HeightField(int nx, int ny, const Box2D& bbox, float value, FieldAllocation allocation) : ScalarField2D(nx, ny, bbox, value, allocation)
+{
+
+}
+
 /*
 \brief Constructor from a file
 \param file file path
@@ -117,27 +131,53 @@ HeightField::HeightField(const TerrainSettings& settings) : ScalarField2D(settin
 */
 void HeightField::InitFromNoise(const Noise& n, float amplitude, float freq, int oct, const Vector3& offset, FractalType type)
 {
-	for (int i = 0; i < ny; i++)
+	// Heightfields only need the noise in the plane : (x, z) world coordinates are used as 2D noise coordinates.
+	// Rows are independent and evaluated in parallel.
+	TaskScheduler::Global().ParallelFor(0, ny, [&](int first, int last)
 	{
-		for (int j = 0; j < nx; j++)
+		std::vector<Vector2> row(nx);
+		for (int i = first; i < last; i++)
 		{
-			Vector3 p = Vertex(i, j) + offset;
-			float h = 0.0f;
-			if (type == FractalType::fBm)
-				h = Fractal::fBm(n, p, amplitude, freq, oct);
-			else if (type == FractalType::Ridge)
-				h = Fractal::RidgeNoise(n, p * freq, amplitude, freq, oct);
-			else if (type == FractalType::MusgravefBm)
-				h = (amplitude / 2.0) * Fractal::MusgravefBm(n, p * freq, 1.0f, 2.0f, oct);
-			else if (type == FractalType::MusgraveHeteroTerrain)
-				h = amplitude * (Fractal::MusgraveHeteroTerrain(n, p * freq, 1.0f, 2.0f, oct, 1.0f) * 0.5f - 0.5f);
-			else if (type == FractalType::MusgraveHybridMultifractal)
-				h = amplitude * Fractal::MusgraveHybridMultifractal(n, p * freq, 0.25f, 2.0f, oct, 0.7f);
-			else if (type == FractalType::MusgraveRidgedMultifractal)
-				h = amplitude * Fractal::MusgraveRidgedMultifractal(n, p * freq, 1.0f, 2.0f, oct, 1.0f, 2.0f);
-			Set(i, j, h);
+			for (int j = 0; j < nx; j++)
+			{
+				Vector2 v = ValueField::Vertex(i, j);
+				row[j] = Vector2(v.x + offset.x, v.y + offset.z);
+			}
+			Fractal::Evaluate(n, type, row.data(), &values[ToIndex1D(i, 0)], nx, amplitude, freq, oct);
 		}
-	}
+	});
+}
+
+/*
+\brief Copy constructor.
+*/
+HeightField::HeightField(const HeightField& hf) : ScalarField2D(hf)
+{
+}
+
+/*
+\brief Move constructor, takes over the heights of the heightfield, which is left empty.
+*/
+HeightField::HeightField(HeightField&& hf) : ScalarField2D(std::move(hf))
+{
+}
+
+/*
+\brief Copy assignment.
+*/
+HeightField& HeightField::operator=(const HeightField& hf)
+{
+	ScalarField2D::operator=(hf);
+	return *this;
+}
+
+/*
+\brief Move assignment, takes over the heights of the heightfield, which is left empty.
+*/
+HeightField& HeightField::operator=(HeightField&& hf)
+{
+	ScalarField2D::operator=(std::move(hf));
+	return *this;
 }
 
 /*
@@ -149,41 +189,171 @@ HeightField::~HeightField()
 
 /*
 \brief Perform a thermal erosion step with maximum amplitude defined by user. Based on http://citeseerx.ist.psu.edu/viewdoc/download?doi=10.1.1.27.8939&rep=rep1&type=pdf.
+The step is evaluated in two parallel stencil passes : every cell first picks its steepest lower neighbour from the current heights,
+then every cell gives and receives matter according to these choices.
 \param amplitude maximum amount of matter moved from one point to another. Something between [0.05, 0.1] gives plausible results.
+\param tanThresholdAngle tangent of the talus angle
 */
 void HeightField::ThermalWeathering(float amplitude, float tanThresholdAngle)
 {
-	float cellDistX = CellSize().x;
-	for (int i = 0; i < ny; i++)
+	DenseThermalWeathering(amplitude, tanThresholdAngle, nullptr);
+}
+
+/*
+\brief Thermal erosion step over the whole field, see ThermalWeathering().
+\param amplitude maximum amount of matter moved from one point to another
+\param tanThresholdAngle tangent of the talus angle
+\param active if not null, receives the cells at distance 2 of the cells which moved matter
+\return number of cells which moved matter if active is not null, 0 otherwise
+*/
+int HeightField::DenseThermalWeathering(float amplitude, float tanThresholdAngle, ActiveCells* active)
+{
+	const char none = ThermalTargetKernel::None;
+	// Scratch fields come from the pool, every cell is written before being read
+	BufferPool<char>& pool = BufferPool<char>::Global();
+	ValueField<char> target(nx, ny, box, pool.Acquire(nx * ny));
+	char* t = target.Data();
+	ThermalTargetKernel kernel(tanThresholdAngle * CellSize().x);
+	Stencil::ForEach(*this, 1, [&](const auto& n, int i, int j)
 	{
-		for (int j = 0; j < nx; j++)
+		t[i * nx + j] = kernel(n, i, j);
+	});
+
+	// Each cell only writes its own height, and reads the targets of its neighbours
+	float* h = values.data();
+	ThermalTransferKernel transfer(amplitude);
+	Stencil::ForEach(target, 1, [&](const auto& n, int i, int j)
+	{
+		h[i * nx + j] += transfer(n, i, j);
+	});
+	if (active == nullptr)
+	{
+		pool.Release(target.ReleaseValues());
+		return 0;
+	}
+
+	// Listing the cells is only worth it once the next step can run sparse
+	int movedCount = 0;
+	for (int id = 0; id < nx * ny; id++)
+		movedCount += (t[id] != none);
+	if (movedCount > nx * ny / 64)
+	{
+		active->SetAll();
+		pool.Release(target.ReleaseValues());
+		return movedCount;
+	}
+
+	ValueField<char> mask(nx, ny, box, pool.Acquire(nx * ny));
+	char* m = mask.Data();
+	Stencil::ForEach(target, 2, [&](const auto& n, int i, int j)
+	{
+		bool moving = false;
+		for (int k = -2; k <= 2; k++)
 		{
-			float maxZDiff = 0.0f;
-			int neiI = -1;
-			int neiJ = -1;
-			for (int k = -1; k <= 1; k++)
-			{
-				for (int l = -1; l <= 1; l++)
-				{
-					if ((k == 0 && l == 0) || Inside(i + k, j + l) == false)
-						continue;
-					float z = Get(i, j) - Get(i + k, j + l);
-					if (z > maxZDiff)
-					{
-						maxZDiff = z;
-						neiI = i + k;
-						neiJ = j + l;
-					}
-				}
-			}
+			for (int l = -2; l <= 2; l++)
+				moving |= n.Inside(k, l) && n(k, l) != none;
+		}
+		m[i * nx + j] = moving;
+	});
+	active->Clear();
+	for (int id = 0; id < nx * ny; id++)
+	{
+		if (m[id])
+			active->Insert(id);
+	}
+	pool.Release(target.ReleaseValues());
+	pool.Release(mask.ReleaseValues());
+	return movedCount;
+}
 
-			if (neiI != -1 && maxZDiff / cellDistX > tanThresholdAngle)
-			{
-				Remove(i, j, amplitude);
-				Add(neiI, neiJ, amplitude);
-			}
+/*
+\brief Perform a thermal erosion step on the active cells only, and update the active set.
+Only the cells whose neighbourhood changed can start moving matter : the next active set gathers
+the cells around those which gave or received matter during this step. Every modified cell sums what it
+gives and receives in the same order as ThermalWeathering(), so the result is the same bit for bit,
+while the cost only depends on the active cell count.
+\param amplitude maximum amount of matter moved from one point to another
+\param tanThresholdAngle tangent of the talus angle
+\param active active cells, reset to the whole field if it does not match its size
+\return number of cells which moved matter, 0 meaning that the terrain is stable
+*/
+int HeightField::SparseThermalWeathering(float amplitude, float tanThresholdAngle, ActiveCells& active)
+{
+	if (active.IsInitialized(nx * ny) == false)
+		active.Reset(nx * ny);
+
+	// While most cells are active, the dense passes are faster : the next active set is the
+	// neighbourhood at distance 2 of the moving cells, which contains the neighbourhoods of their targets
+	if (active.All() || active.Count() > nx * ny / 8)
+		return DenseThermalWeathering(amplitude, tanThresholdAngle, &active);
+
+	// Targets of the active cells, from the current heights
+	const std::vector<int>& cells = active.Cells();
+	std::vector<int> targets(cells.size());
+	ThermalTargetKernel kernel(tanThresholdAngle * CellSize().x);
+	TaskScheduler::Global().ParallelFor(0, int(cells.size()), [&](int first, int last)
+	{
+		for (int c = first; c < last; c++)
+		{
+			int i = cells[c] / nx, j = cells[c] % nx;
+			char code = Stencil::At(*this, 1, i, j, kernel);
+			targets[c] = (code == ThermalTargetKernel::None) ? -1 : cells[c] + (code / 3 - 1) * nx + (code % 3 - 1);
 		}
+	});
+
+	// Gather what every modified cell gives and receives : keys are 2 * id for a given amplitude, 2 * id + 1 for a received one
+	std::vector<int> moves;
+	for (size_t c = 0; c < cells.size(); c++)
+	{
+		if (targets[c] == -1)
+			continue;
+		moves.push_back(2 * cells[c]);
+		moves.push_back(2 * targets[c] + 1);
+	}
+	int movedCount = int(moves.size() / 2);
+	std::sort(moves.begin(), moves.end());
+
+	// Move matter with the same float operations as the dense pass, then activate the neighbourhoods of the modified cells
+	active.Clear();
+	for (size_t c = 0; c < moves.size();)
+	{
+		int id = moves[c] / 2;
+		float dh = (moves[c] % 2 == 0) ? -amplitude : 0.0f;
+		for (c += (moves[c] % 2 == 0) ? 1 : 0; c < moves.size() && moves[c] == 2 * id + 1; c++)
+			dh += amplitude;
+		values[id] += dh;
+
+		int i = id / nx, j = id % nx;
+		for (int k = Math::Max(i - 1, 0); k <= Math::Min(i + 1, ny - 1); k++)
+		{
+			for (int l = Math::Max(j - 1, 0); l <= Math::Min(j + 1, nx - 1); l++)
+				active.Insert(k * nx + l);
+		}
+	}
+	return movedCount;
+}
+
+/*
+\brief Perform thermal erosion steps on active cells until the terrain is stable.
+\param amplitude maximum amount of matter moved from one point to another
+\param tanThresholdAngle tangent of the talus angle
+\param maxSteps maximum step count
+\param activeCounts if not null, receives the active cell count of each step
+\return number of steps performed
+*/
+int HeightField::ThermalWeatheringUntilStable(float amplitude, float tanThresholdAngle, int maxSteps, std::vector<int>* activeCounts)
+{
+	ActiveCells active;
+	int step = 0;
+	while (step < maxSteps)
+	{
+		if (activeCounts != nullptr)
+			activeCounts->push_back(active.IsInitialized(nx * ny) ? active.Count() : nx * ny);
+		step++;
+		if (SparseThermalWeathering(amplitude, tanThresholdAngle, active) == 0)
+			break;
 	}
+	return step;
 }
 
 /*
@@ -206,12 +376,13 @@ void HeightField::StreamPowerErosion(float amplitude)
 			Set(i, j, newH);
 		}
 	}
+	BufferPool<float>::Global().Release(SP.ReleaseValues());
 }
 
-#include <iostream>
-using namespace std;
 /*
-\brief
+\brief Perform a hydraulic erosion step. Every cell starts with one unit of water and one unit of sediment,
+and cells are visited in scan order : the water and sediment moved to a neighbour are carried on when that neighbour
+is visited, so this pass stays sequential instead of being a stencil pass.
 */
 void HeightField::HydraulicErosion()
 {
@@ -323,7 +494,8 @@ ScalarField2D HeightField::DrainageArea() const
 
 	std::array<float, 8> slopes;
 	std::array<Vector2i, 8> coords;
-	ScalarField2D DA = ScalarField2D(nx, ny, box, 1.0);
+	ScalarField2D DA(nx, ny, box, BufferPool<float>::Global().Acquire(nx * ny));
+	DA.Fill(1.0f);
 	while (!points.empty())
 	{
 		ScalarValue p = points.front();
@@ -368,12 +540,12 @@ ScalarField2D HeightField::DrainageArea() const
 */
 ScalarField2D HeightField::Slope() const
 {
-	ScalarField2D S = ScalarField2D(nx, ny, box);
-	for (int i = 0; i < ny; i++)
+	ScalarField2D S(nx, ny, box, BufferPool<float>::Global().Acquire(nx * ny));
+	GradientKernel gradient(CellSize());
+	Stencil::Apply(*this, S, 1, [&](const auto& n, int i, int j)
 	{
-		for (int j = 0; j < nx; j++)
-			S.Set(i, j, Magnitude(Gradient(i, j)));
-	}
+		return Magnitude(gradient(n, i, j));
+	});
 	return S;
 }
 
@@ -384,11 +556,8 @@ ScalarField2D HeightField::Wetness() const
 {
 	ScalarField2D DA = DrainageArea();
 	ScalarField2D S = Slope();
-	for (int i = 0; i < ny; i++)
-	{
-		for (int j = 0; j < nx; j++)
-			DA.Set(i, j, abs(log(DA.Get(i, j) / (1.0f + S.Get(i, j)))));
-	}
+	DA = abs(log(DA / (1.0f + S)));
+	BufferPool<float>::Global().Release(S.ReleaseValues());
 	return DA;
 }
 
@@ -398,43 +567,76 @@ ScalarField2D HeightField::Wetness() const
 ScalarField2D HeightField::StreamPower() const
 {
 	ScalarField2D DA = DrainageArea();
+	ScalarField2D S = Slope();
+	DA = sqrt(DA) * S;
+	BufferPool<float>::Global().Release(S.ReleaseValues());
+	return DA;
+}
+
+/*
+\brief Compute the Wetness Index Field from an up to date single flow drainage, see FlowAccumulation.
+\param flow drainage of this heightfield
+*/
+ScalarField2D HeightField::Wetness(const FlowAccumulation& flow) const
+{
 	ScalarField2D S = Slope();
 	for (int i = 0; i < ny; i++)
 	{
 		for (int j = 0; j < nx; j++)
-			DA.Set(i, j, sqrt(DA.Get(i, j)) * S.Get(i, j));
+			S.Set(i, j, abs(log(flow.Get(i, j) / (1.0f + S.Get(i, j)))));
 	}
-	return DA;
+	return S;
+}
+
+/*
+\brief Compute the StreamPower field from an up to date single flow drainage, see FlowAccumulation.
+\param flow drainage of this heightfield
+*/
+ScalarField2D HeightField::StreamPower(const FlowAccumulation& flow) const
+{
+	ScalarField2D S = Slope();
+	for (int i = 0; i < ny; i++)
+	{
+		for (int j = 0; j < nx; j++)
+			S.Set(i, j, sqrt(flow.Get(i, j)) * S.Get(i, j));
+	}
+	return S;
 }
 
 /*
 \brief Compute the 'Illumination' field, which is basically an approximation of Ambient Occlusion.
+Each cell draws its ray directions from its own random stream, so the result only depends on the seed.
+\param seed seed of the ray directions
 */
-ScalarField2D HeightField::Illumination() const
+ScalarField2D HeightField::Illumination(unsigned int seed) const
 {
 	const int rayCount = 32;		// Ray count for each world point
 	const float epsilon = 0.01f;	// Ray start up offset
 	const float K = Slope().Max();	// Lipschitz constant
 	ScalarField2D Illu = ScalarField2D(nx, ny, box);
-	Hit rayHit;
-	for (int i = 0; i < ny; i++)
+	TaskScheduler::Global().ParallelFor(0, ny, [&](int first, int last)
 	{
-		for (int j = 0; j < nx; j++)
+		Hit rayHit;
+		for (int i = first; i < last; i++)
 		{
-			Vector3 rayPos = Vertex(i, j) + Vector3(0.0, epsilon, 0.0);
-			int intersectionCount = 0;
-			for (int k = 0; k < rayCount; k++)
+			for (int j = 0; j < nx; j++)
 			{
-				float angleH = (Random::get() % 360) * 0.0174533f;
-				float angleV = Random::get() / float(Random::max());
-				Vector3 rayDir = Vector3(cos(angleH), 0.0f, sin(angleH));
-				rayDir = Slerp(rayDir, Vector3(0.0f, 1.0f, 0.0f), angleV);
-				if (Intersect(Ray(rayPos, rayDir), rayHit, K) == true)
-					intersectionCount++;
+				RandomStream random(seed, RandomSubsystem::Illumination, ToIndex1D(i, j));
+				Vector3 rayPos = Vertex(i, j) + Vector3(0.0, epsilon, 0.0);
+				int intersectionCount = 0;
+				for (int k = 0; k < rayCount; k++)
+				{
+					float angleH = random.Range(360) * 0.0174533f;
+					float angleV = random.NextFloat();
+					Vector3 rayDir = Vector3(cos(angleH), 0.0f, sin(angleH));
+					rayDir = Slerp(rayDir, Vector3(0.0f, 1.0f, 0.0f), angleV);
+					if (Intersect(Ray(rayPos, rayDir), rayHit, K) == true)
+						intersectionCount++;
+				}
+				Illu.Set(i, j, 1.0f - (intersectionCount / float(rayCount)));
 			}
-			Illu.Set(i, j, 1.0f - (intersectionCount / float(rayCount)));
 		}
-	}
+	});
 	return Illu;
 }
 
@@ -452,11 +654,12 @@ bool HeightField::Intersect(const Ray& ray, Hit& hit, float K) const
 	if (!bbox.Intersect(ray, a, b))
 		return false;
 
+	BilinearSampler<float> sampler(*this);
 	float t = Math::Max(a + 0.01f, 0.0f);
 	while (t < b)
 	{
 		Vector3 p = ray.At(t);
-		float y = GetValueBilinear(Vector2(p.x, p.z));
+		float y = sampler.Sample(p.x, p.z);
 		float h = p.y - y;
 		if (h < 0.01f)
 		{
@@ -517,41 +720,51 @@ std::vector<Frame> HeightField::GetVoxelFrames() const
 	return ret;
 }
 
+/*
+\brief Sum of the normals of the triangles of a quad, split along its (0, 0) - (1, 1) diagonal.
+\param h00, h10, h11, h01 corner heights, the first index being along the x axis
+\param cellSize size of the quad
+\param lower include the triangle (0, 0), (1, 0), (1, 1)
+\param upper include the triangle (0, 0), (1, 1), (0, 1)
+*/
+static inline Vector3 QuadNormal(float h00, float h10, float h11, float h01, const Vector2& cellSize, bool lower, bool upper)
+{
+	Vector3 A = Vector3(cellSize.x, h10 - h00, 0.0f);
+	Vector3 B = Vector3(cellSize.x, h11 - h00, cellSize.y);
+	Vector3 C = Vector3(0.0f, h01 - h00, cellSize.y);
+	Vector3 ret(0);
+	if (lower)
+		ret = ret + Normalize(-Cross(A, B));
+	if (upper)
+		ret = ret + Normalize(-Cross(B, C));
+	return ret;
+}
+
 /*
 \brief Compute the heightfield mesh for rendering
 */
 Mesh* HeightField::GetMesh() const
 {
 	Mesh* ret = new Mesh();
-	ValueField<Vector3> normals = ValueField<Vector3>(nx, ny, box, Vector3(0));
-	for (int i = 0; i < ny - 1; i++)
+	ValueField<Vector3> normals = ValueField<Vector3>(nx, ny, box);
+	Vector2 cellSize = CellSize();
+	Stencil::Apply(*this, normals, 1, [&](const auto& n, int, int)
 	{
-		for (int j = 0; j < nx - 1; j++)
-		{
-			Vector3 AB = (Vertex(i + 1, j) - Vertex(i, j));
-			Vector3 AC = (Vertex(i + 1, j + 1) - Vertex(i, j));
-			Vector3 normal = Normalize(-Cross(AB, AC));
-
-			normals.Set(i, j, normals.Get(i, j) + normal);
-			normals.Set(i + 1, j, normals.Get(i + 1, j) + normal);
-			normals.Set(i + 1, j + 1, normals.Get(i + 1, j + 1) + normal);
-
-			AB = AC;
-			AC = (Vertex(i, j + 1) - Vertex(i, j));
-			normal = Normalize(-Cross(AB, AC));
-
-			normals.Set(i, j, normals.Get(i, j) + normal);
-			normals.Set(i + 1, j + 1, normals.Get(i + 1, j + 1) + normal);
-			normals.Set(i, j + 1, normals.Get(i, j + 1) + normal);
-		}
-	}
-	for (int i = 0; i < ny; i++)
-	{
-		for (int j = 0; j < nx; j++)
-			normals.Set(i, j, Normalize(normals.Get(i, j)));
-	}
+		// Gather the normals of the triangles sharing the vertex, quads being split along their (0, 0) - (1, 1) diagonal
+		Vector3 normal(0);
+		if (n.Inside(1, 1))
+			normal = normal + QuadNormal(n(0, 0), n(1, 0), n(1, 1), n(0, 1), cellSize, true, true);
+		if (n.Inside(-1, 1))
+			normal = normal + QuadNormal(n(-1, 0), n(0, 0), n(0, 1), n(-1, 1), cellSize, true, false);
+		if (n.Inside(-1, -1))
+			normal = normal + QuadNormal(n(-1, -1), n(0, -1), n(0, 0), n(-1, 0), cellSize, true, true);
+		if (n.Inside(1, -1))
+			normal = normal + QuadNormal(n(0, -1), n(1, -1), n(1, 0), n(0, 0), cellSize, false, true);
+		return Normalize(normal);
+	});
 
 	// Vertices & Texcoords & Normals
+	ret->Reserve(size_t(nx) * ny, size_t(2) * (nx - 1) * (ny - 1));
 	for (int i = 0; i < ny; i++)
 	{
 		for (int j = 0; j < nx; j++)
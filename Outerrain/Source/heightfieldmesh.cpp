@@ -9,6 +9,7 @@ HeightfieldMesh::HeightfieldMesh(HeightField* h) : hf(h)
 	int ny = hf->SizeY();
 	float nxMinusOne = (float)hf->SizeX() - 1;
 	float nyMinusOne = (float)hf->SizeY() - 1;
+	Reserve(size_t(nx) * ny, size_t(2) * (nx - 1) * (ny - 1), false, true);
 	for (int i = 0; i < ny; i++)
 	{
 		for (int j = 0; j < nx; j++)
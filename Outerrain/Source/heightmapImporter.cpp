@@ -0,0 +1,311 @@
+#include "heightmapImporter.h"
+#include "scalarfield2D.h"
+#include "taskScheduler.h"
+
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cctype>
+#include <SDL2/SDL_image.h>
+
+/*
+\class HeightmapImporter heightmapImporter.h
+\brief Reads heightmap files straight into a float field with values in [0, 1], at their native precision :
+	- .pgm : binary 8 or 16 bits grayscale (P5)
+	- .pfm : 32 bits float grayscale (Pf)
+	- .raw / .r16 : square 16 bits little endian samples
+	- .r32 : square 32 bits float samples
+	- anything else is loaded by SDL_image, which only provides 8 bits. 16 bits PNG files are rejected,
+	since SDL_image would silently truncate them.
+Row 0 of the returned field is the bottom row of the image, as in Texture2D.
+*/
+
+/*
+\brief Get the lower case extension of a file path, without the dot.
+*/
+static std::string Extension(const std::string& filePath)
+{
+	size_t dot = filePath.rfind('.');
+	if (dot == std::string::npos)
+		return "";
+	std::string ext = filePath.substr(dot + 1);
+	for (size_t i = 0; i < ext.size(); i++)
+		ext[i] = char(tolower(ext[i]));
+	return ext;
+}
+
+/*
+\brief Read the next integer of a netpbm header, skipping comments.
+*/
+static int ReadHeaderInt(std::ifstream& in)
+{
+	int c = in.peek();
+	while (in && (isspace(c) || c == '#'))
+	{
+		if (c == '#')
+			in.ignore(1024, '\n');
+		else
+			in.get();
+		c = in.peek();
+	}
+	int ret = 0;
+	in >> ret;
+	return ret;
+}
+
+/*
+\brief Load a heightmap file, the format is deduced from the file extension.
+\param filePath image file path
+\param image returned field, normalized in [0, 1]
+\return false if the file could not be read
+*/
+bool HeightmapImporter::Load(const std::string& filePath, ValueField<float>& image)
+{
+	std::string ext = Extension(filePath);
+	bool ret = false;
+	if (ext == "pgm")
+		ret = LoadPGM(filePath, image);
+	else if (ext == "pfm")
+		ret = LoadPFM(filePath, image);
+	else if (ext == "raw" || ext == "r16")
+		ret = LoadRAW(filePath, 2, image);
+	else if (ext == "r32")
+		ret = LoadRAW(filePath, 4, image);
+	else
+		ret = LoadSDL(filePath, image);
+	if (ret == false)
+		std::cout << "Error loading heightmap " << filePath << std::endl;
+	return ret;
+}
+
+/*
+\brief Load a binary PGM file (P5), with 8 or 16 bits big endian samples.
+*/
+bool HeightmapImporter::LoadPGM(const std::string& filePath, ValueField<float>& image)
+{
+	std::ifstream in(filePath, std::ios::binary);
+	char magic[2] = { 0, 0 };
+	in.read(magic, 2);
+	if (!in || magic[0] != 'P' || magic[1] != '5')
+		return false;
+	int width = ReadHeaderInt(in);
+	int height = ReadHeaderInt(in);
+	int maxValue = ReadHeaderInt(in);
+	in.get();
+	if (!in || width <= 1 || height <= 1 || maxValue <= 0 || maxValue > 65535)
+		return false;
+
+	int bytesPerSample = maxValue < 256 ? 1 : 2;
+	std::vector<unsigned char> buffer(size_t(width) * height * bytesPerSample);
+	in.read((char*)buffer.data(), buffer.size());
+	if (!in)
+		return false;
+
+	image = ValueField<float>(width, height, Box2D(Vector2(0.0f), Vector2(1.0f)));
+	float* data = image.Data();
+	float scale = 1.0f / float(maxValue);
+	for (int y = 0; y < height; y++)
+	{
+		const unsigned char* src = buffer.data() + size_t(height - 1 - y) * width * bytesPerSample;
+		float* dst = data + size_t(y) * width;
+		if (bytesPerSample == 1)
+		{
+			for (int x = 0; x < width; x++)
+				dst[x] = src[x] * scale;
+		}
+		else
+		{
+			for (int x = 0; x < width; x++)
+				dst[x] = ((src[2 * x] << 8) | src[2 * x + 1]) * scale;
+		}
+	}
+	return true;
+}
+
+/*
+\brief Load a grayscale PFM file (Pf). PFM rows are already stored from bottom to top.
+*/
+bool HeightmapImporter::LoadPFM(const std::string& filePath, ValueField<float>& image)
+{
+	std::ifstream in(filePath, std::ios::binary);
+	char magic[2] = { 0, 0 };
+	in.read(magic, 2);
+	if (!in || magic[0] != 'P' || magic[1] != 'f')
+		return false;
+	int width = ReadHeaderInt(in);
+	int height = ReadHeaderInt(in);
+	float scale = 0.0f;
+	in >> scale;
+	in.get();
+	if (!in || width <= 1 || height <= 1 || scale == 0.0f)
+		return false;
+
+	image = ValueField<float>(width, height, Box2D(Vector2(0.0f), Vector2(1.0f)));
+	in.read((char*)image.Data(), size_t(width) * height * sizeof(float));
+	if (!in)
+		return false;
+
+	// Negative scale means little endian samples
+	bool swap = (scale < 0.0f) != (SDL_BYTEORDER == SDL_LIL_ENDIAN);
+	if (swap)
+	{
+		unsigned int* data = (unsigned int*)image.Data();
+		for (int i = 0; i < width * height; i++)
+			data[i] = SDL_Swap32(data[i]);
+	}
+	return true;
+}
+
+/*
+\brief Load a square RAW file of 16 bits unsigned or 32 bits float little endian samples.
+The side of the heightmap is deduced from the file size.
+*/
+bool HeightmapImporter::LoadRAW(const std::string& filePath, int bytesPerSample, ValueField<float>& image)
+{
+	std::ifstream in(filePath, std::ios::binary | std::ios::ate);
+	if (!in)
+		return false;
+	size_t sampleCount = size_t(in.tellg()) / bytesPerSample;
+	int side = int(sqrt(double(sampleCount)) + 0.5);
+	if (side <= 1 || size_t(side) * side != sampleCount)
+		return false;
+	in.seekg(0);
+
+	std::vector<unsigned char> buffer(sampleCount * bytesPerSample);
+	in.read((char*)buffer.data(), buffer.size());
+	if (!in)
+		return false;
+
+	image = ValueField<float>(side, side, Box2D(Vector2(0.0f), Vector2(1.0f)));
+	float* data = image.Data();
+	for (int y = 0; y < side; y++)
+	{
+		const unsigned char* src = buffer.data() + size_t(side - 1 - y) * side * bytesPerSample;
+		float* dst = data + size_t(y) * side;
+		if (bytesPerSample == 2)
+		{
+			for (int x = 0; x < side; x++)
+				dst[x] = (src[2 * x] | (src[2 * x + 1] << 8)) / 65535.0f;
+		}
+		else
+		{
+			for (int x = 0; x < side; x++)
+			{
+				unsigned int bits = src[4 * x] | (src[4 * x + 1] << 8) | (src[4 * x + 2] << 16) | ((unsigned int)src[4 * x + 3] << 24);
+				memcpy(&dst[x], &bits, sizeof(float));
+			}
+		}
+	}
+	return true;
+}
+
+/*
+\brief Read the bit depth of a PNG file from its IHDR chunk.
+\return the bit depth of the channels, 0 if the file is not a PNG file
+*/
+static int PNGBitDepth(const std::string& filePath)
+{
+	static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	unsigned char header[25];
+	std::ifstream in(filePath, std::ios::binary);
+	in.read((char*)header, sizeof(header));
+	if (!in || memcmp(header, signature, sizeof(signature)) != 0 || memcmp(header + 12, "IHDR", 4) != 0)
+		return 0;
+	return header[24];
+}
+
+/*
+\brief Load any image supported by SDL_image, reading the red channel of the surface directly.
+SDL_image converts 16 bits PNG files to 8 bits, so these are rejected instead of losing precision.
+*/
+bool HeightmapImporter::LoadSDL(const std::string& filePath, ValueField<float>& image)
+{
+	if (PNGBitDepth(filePath) == 16)
+	{
+		std::cout << "16 bits PNG heightmaps are not supported, convert " << filePath << " to .pgm or .r16" << std::endl;
+		return false;
+	}
+
+	SDL_Surface* surface = IMG_Load(filePath.c_str());
+	if (surface == NULL)
+		return false;
+
+	int width = surface->w;
+	int height = surface->h;
+	int bytesPerPixel = surface->format->BytesPerPixel;
+	int redOffset = surface->format->Rshift / 8;
+	image = ValueField<float>(width, height, Box2D(Vector2(0.0f), Vector2(1.0f)));
+	float* data = image.Data();
+	for (int y = 0; y < height; y++)
+	{
+		const Uint8* src = (const Uint8*)surface->pixels + size_t(height - 1 - y) * surface->pitch + redOffset;
+		float* dst = data + size_t(y) * width;
+		for (int x = 0; x < width; x++)
+			dst[x] = src[x * bytesPerPixel] / 255.0f;
+	}
+	SDL_FreeSurface(surface);
+	return true;
+}
+
+/*
+\brief Bilinear resampling of a normalized image to the field resolution, mapped to [blackValue, whiteValue].
+The filter is separable : image rows are first resampled to the field width with precomputed
+columns and weights, then field rows are blended from two of these rows. Rows are processed in parallel.
+\param image source image, see Load()
+\param field returned field
+\param blackValue value of black pixels
+\param whiteValue value of white pixels
+*/
+void HeightmapImporter::Resample(const ValueField<float>& image, ScalarField2D& field, float blackValue, float whiteValue)
+{
+	int width = image.SizeX();
+	int height = image.SizeY();
+	int nx = field.SizeX();
+	int ny = field.SizeY();
+	const float* src = image.Data();
+	float* dst = field.Data();
+	float range = whiteValue - blackValue;
+
+	// Horizontal pass weights, shared by all rows
+	std::vector<int> column(nx);
+	std::vector<float> weight(nx);
+	for (int j = 0; j < nx; j++)
+	{
+		float x = j * float(width - 1) / float(nx - 1);
+		column[j] = Math::Min(int(x), width - 2);
+		weight[j] = x - column[j];
+	}
+
+	// Horizontal pass : image rows at field width, pre-mapped to [blackValue, whiteValue]
+	std::vector<float> rows(size_t(height) * nx);
+	TaskScheduler::Global().ParallelFor(0, height, [&](int first, int last)
+	{
+		for (int y = first; y < last; y++)
+		{
+			const float* s = src + size_t(y) * width;
+			float* r = rows.data() + size_t(y) * nx;
+			for (int j = 0; j < nx; j++)
+			{
+				float a = s[column[j]];
+				float b = s[column[j] + 1];
+				r[j] = blackValue + (a + (b - a) * weight[j]) * range;
+			}
+		}
+	}, 16);
+
+	// Vertical pass
+	TaskScheduler::Global().ParallelFor(0, ny, [&](int first, int last)
+	{
+		for (int i = first; i < last; i++)
+		{
+			float y = i * float(height - 1) / float(ny - 1);
+			int y0 = Math::Min(int(y), height - 2);
+			float t = y - y0;
+			const float* a = rows.data() + size_t(y0) * nx;
+			const float* b = a + nx;
+			float* d = dst + size_t(i) * nx;
+			for (int j = 0; j < nx; j++)
+				d[j] = a[j] + (b[j] - a[j]) * t;
+		}
+	}, 16);
+}
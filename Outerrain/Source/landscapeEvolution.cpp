@@ -0,0 +1,428 @@
+#include "landscapeEvolution.h"
+#include "mathUtils.h"
+#include "taskScheduler.h"
+
+#include <queue>
+
+/*
+\class LandscapeEvolution landscapeEvolution.h
+\brief Landscape evolution model combining tectonic uplift, fluvial incision and hillslope diffusion :
+	dh/dt = U - K A^m S^n + kd Laplacian(h)
+Fluvial incision is solved implicitly in stack order along a single flow direction receiver graph,
+following Braun and Willett 2013 (https://doi.org/10.1016/j.geomorph.2012.10.008), so that each step
+runs in linear time and is stable for large time steps. Diffusion is solved implicitly by alternating
+directions, with one tridiagonal system per row and per column.
+Border cells are the base level : they neither uplift nor erode. Local minima inside the domain act as
+local base levels, see FillDepressions().
+Units are the heightfield units (metres) and years.
+Row passes run in the bands of TaskScheduler::ParallelBands(), so that on NUMA machines they stay local to fields
+allocated with AllocateFirstTouch : the simulation must be constructed and stepped from the same thread.
+*/
+
+/*
+\brief Constructor
+\param hf evolved heightfield
+\param u uniform uplift rate
+\param k stream power erodibility
+\param m drainage area exponent
+\param n slope exponent
+\param kd hillslope diffusion coefficient
+*/
+LandscapeEvolution::LandscapeEvolution(HeightField& hf, float u, float k, float m, float n, float kd)
+	: hf(hf), uplift(hf.SizeX(), hf.SizeY(), hf.GetBox(), u, AllocateFirstTouch), erodibility(k), areaExponent(m), slopeExponent(n), diffusion(kd)
+{
+	int size = hf.SizeX() * hf.SizeY();
+	receivers.resize(size);
+	receiverDistance.resize(size);
+	donorOffset.resize(size + 1);
+	donors.resize(size);
+	stack.resize(size);
+	area.resize(size);
+}
+
+/*
+\brief Set a uniform uplift rate.
+*/
+void LandscapeEvolution::SetUplift(float u)
+{
+	uplift.Fill(u);
+}
+
+/*
+\brief Set the uplift rate field, which should have the heightfield resolution.
+*/
+void LandscapeEvolution::SetUplift(const ScalarField2D& u)
+{
+	std::copy(u.Data(), u.Data() + uplift.SizeX() * uplift.SizeY(), uplift.Data());
+}
+
+/*
+\brief Set the stream power law parameters.
+\param k erodibility
+\param m drainage area exponent
+\param n slope exponent
+*/
+void LandscapeEvolution::SetStreamPower(float k, float m, float n)
+{
+	erodibility = k;
+	areaExponent = m;
+	slopeExponent = n;
+}
+
+/*
+\brief Set the hillslope diffusion coefficient.
+*/
+void LandscapeEvolution::SetDiffusion(float kd)
+{
+	diffusion = kd;
+}
+
+/*
+\brief Perform one time step of the model : uplift, receivers and stack update, implicit incision and diffusion.
+\param dt time step
+*/
+void LandscapeEvolution::Step(float dt)
+{
+	ApplyUplift(dt);
+	ComputeReceivers();
+	ComputeStack();
+	ComputeDrainageArea();
+	StreamPowerStep(dt);
+	if (diffusion > 0.0f)
+		DiffusionStep(dt);
+}
+
+/*
+\brief Run the model for a given duration.
+\param duration simulated duration
+\param dt time step, the last step is shortened to match the duration
+*/
+void LandscapeEvolution::Simulate(float duration, float dt)
+{
+	float t = 0.0f;
+	while (t < duration)
+	{
+		float step = Math::Min(dt, duration - t);
+		Step(step);
+		t += step;
+	}
+}
+
+/*
+\brief Raise interior cells by the uplift rate.
+*/
+void LandscapeEvolution::ApplyUplift(float dt)
+{
+	int nx = hf.SizeX();
+	int ny = hf.SizeY();
+	float* h = hf.Data();
+	const float* u = uplift.Data();
+	TaskScheduler::Global().ParallelBands(0, ny, [&](int first, int last)
+	{
+		for (int i = Math::Max(first, 1); i < Math::Min(last, ny - 1); i++)
+		{
+			for (int j = 1; j < nx - 1; j++)
+				h[i * nx + j] += u[i * nx + j] * dt;
+		}
+	});
+}
+
+/*
+\brief Compute the steepest descent receiver of every cell. Border cells and local minima are their own receiver.
+Rows are processed in parallel, by bands.
+*/
+void LandscapeEvolution::ComputeReceivers()
+{
+	int nx = hf.SizeX();
+	int ny = hf.SizeY();
+	const float* h = hf.Data();
+	Vector2 cellSize = hf.CellSize();
+
+	int offsets[8];
+	float distances[8];
+	int c = 0;
+	for (int k = -1; k <= 1; k++)
+	{
+		for (int l = -1; l <= 1; l++)
+		{
+			if (k == 0 && l == 0)
+				continue;
+			offsets[c] = k * nx + l;
+			distances[c] = sqrt(k * k * cellSize.x * cellSize.x + l * l * cellSize.y * cellSize.y);
+			c++;
+		}
+	}
+
+	TaskScheduler::Global().ParallelBands(0, ny, [&](int first, int last)
+	{
+		for (int i = first; i < last; i++)
+		{
+			for (int j = 0; j < nx; j++)
+			{
+				int id = i * nx + j;
+				receivers[id] = id;
+				receiverDistance[id] = 1.0f;
+				if (i == 0 || j == 0 || i == ny - 1 || j == nx - 1)
+					continue;
+
+				float steepest = 0.0f;
+				for (int k = 0; k < 8; k++)
+				{
+					float s = (h[id] - h[id + offsets[k]]) / distances[k];
+					if (s > steepest)
+					{
+						steepest = s;
+						receivers[id] = id + offsets[k];
+						receiverDistance[id] = distances[k];
+					}
+				}
+			}
+		}
+	});
+}
+
+/*
+\brief Order the cells so that every cell comes after its receiver, by a depth first traversal
+of the donor trees starting from the base level cells. Donors are gathered with a counting sort.
+*/
+void LandscapeEvolution::ComputeStack()
+{
+	int size = int(receivers.size());
+	std::fill(donorOffset.begin(), donorOffset.end(), 0);
+	for (int id = 0; id < size; id++)
+	{
+		if (receivers[id] != id)
+			donorOffset[receivers[id] + 1]++;
+	}
+	for (int id = 0; id < size; id++)
+		donorOffset[id + 1] += donorOffset[id];
+
+	std::vector<int> fill(donorOffset.begin(), donorOffset.end() - 1);
+	for (int id = 0; id < size; id++)
+	{
+		if (receivers[id] != id)
+			donors[fill[receivers[id]]++] = id;
+	}
+
+	// Traversal, reusing the fill array as the pending cell stack
+	int count = 0;
+	for (int root = 0; root < size; root++)
+	{
+		if (receivers[root] != root)
+			continue;
+		int pending = 0;
+		fill[pending++] = root;
+		while (pending > 0)
+		{
+			int id = fill[--pending];
+			stack[count++] = id;
+			for (int d = donorOffset[id]; d < donorOffset[id + 1]; d++)
+				fill[pending++] = donors[d];
+		}
+	}
+}
+
+/*
+\brief Accumulate the drainage area from the top of the stack down to the base level.
+*/
+void LandscapeEvolution::ComputeDrainageArea()
+{
+	Vector2 cellSize = hf.CellSize();
+	std::fill(area.begin(), area.end(), cellSize.x * cellSize.y);
+	for (int k = int(stack.size()) - 1; k >= 0; k--)
+	{
+		int id = stack[k];
+		if (receivers[id] != id)
+			area[receivers[id]] += area[id];
+	}
+}
+
+/*
+\brief Implicit stream power incision. Cells are processed in stack order, so that the new height
+of the receiver is already known. With n = 1 the update is exact :
+	h = (h + f hr) / (1 + f), with f = K dt A^m / L
+otherwise a few Newton iterations solve h - h0 + f (h - hr)^n = 0.
+*/
+void LandscapeEvolution::StreamPowerStep(float dt)
+{
+	float* h = hf.Data();
+	bool linear = (slopeExponent == 1.0f);
+	for (size_t k = 0; k < stack.size(); k++)
+	{
+		int id = stack[k];
+		int r = receivers[id];
+		if (r == id)
+			continue;
+		float hr = h[r];
+		float h0 = h[id];
+		if (h0 <= hr)
+			continue;
+
+		float f = erodibility * dt * pow(area[id], areaExponent) / pow(receiverDistance[id], slopeExponent);
+		if (linear)
+		{
+			h[id] = (h0 + f * hr) / (1.0f + f);
+			continue;
+		}
+
+		float x = h0 - hr;
+		for (int it = 0; it < 10; it++)
+		{
+			float xn = pow(x, slopeExponent);
+			float g = x - (h0 - hr) + f * xn;
+			float dx = g / (1.0f + slopeExponent * f * xn / x);
+			x = Math::Max(x - dx, 1.0e-6f * (h0 - hr));
+			if (abs(dx) < 1.0e-5f)
+				break;
+		}
+		h[id] = hr + x;
+	}
+}
+
+/*
+\brief Precompute the forward elimination factors of the constant coefficient tridiagonal system
+	-r h[k-1] + (1 + 2r) h[k] - r h[k+1] = d[k], k in [1, n - 2]
+with fixed values at both ends. They are shared by all the rows, or all the columns.
+*/
+void LandscapeEvolution::PrepareThomas(int n, float r)
+{
+	thomasFactor.assign(n, 0.0f);
+	thomasInverse.assign(n, 0.0f);
+	float previous = 0.0f;
+	for (int k = 1; k < n - 1; k++)
+	{
+		float m = 1.0f + 2.0f * r + r * previous;
+		thomasInverse[k] = 1.0f / m;
+		thomasFactor[k] = -r / m;
+		previous = thomasFactor[k];
+	}
+}
+
+/*
+\brief Implicit hillslope diffusion, split in a row pass and a column pass, each unconditionally stable.
+Rows are solved in parallel. Columns are swept all together row by row, so that memory stays contiguous,
+and in parallel by blocks of columns.
+*/
+void LandscapeEvolution::DiffusionStep(float dt)
+{
+	int nx = hf.SizeX();
+	int ny = hf.SizeY();
+	float* h = hf.Data();
+	Vector2 cellSize = hf.CellSize();
+
+	// Rows : index j, spacing along the field y axis
+	float r = diffusion * dt / (cellSize.y * cellSize.y);
+	PrepareThomas(nx, r);
+	TaskScheduler::Global().ParallelBands(0, ny, [&](int first, int last)
+	{
+		for (int i = Math::Max(first, 1); i < Math::Min(last, ny - 1); i++)
+		{
+			float* row = h + i * nx;
+			row[1] += r * row[0];
+			row[nx - 2] += r * row[nx - 1];
+			row[1] *= thomasInverse[1];
+			for (int j = 2; j < nx - 1; j++)
+				row[j] = (row[j] + r * row[j - 1]) * thomasInverse[j];
+			for (int j = nx - 3; j >= 1; j--)
+				row[j] -= thomasFactor[j] * row[j + 1];
+		}
+	});
+
+	// Columns : index i, spacing along the field x axis
+	r = diffusion * dt / (cellSize.x * cellSize.x);
+	PrepareThomas(ny, r);
+	TaskScheduler::Global().ParallelFor(1, nx - 1, [&](int first, int last)
+	{
+		for (int j = first; j < last; j++)
+		{
+			h[nx + j] += r * h[j];
+			h[(ny - 2) * nx + j] += r * h[(ny - 1) * nx + j];
+		}
+		for (int i = 1; i < ny - 1; i++)
+		{
+			float* row = h + i * nx;
+			const float* previous = row - nx;
+			float a = (i > 1) ? r : 0.0f;
+			for (int j = first; j < last; j++)
+				row[j] = (row[j] + a * previous[j]) * thomasInverse[i];
+		}
+		for (int i = ny - 3; i >= 1; i--)
+		{
+			float* row = h + i * nx;
+			const float* next = row + nx;
+			for (int j = first; j < last; j++)
+				row[j] -= thomasFactor[i] * next[j];
+		}
+	}, 64);
+}
+
+/*
+\brief Fill the depressions of the heightfield so that every cell drains to the border, using
+Priority-Flood+Epsilon (Barnes et al. 2014). Runs in O(n log n), and is meant to be called
+once on the initial terrain : the implicit incision does not create new depressions.
+\param epsilon minimum height increase along filled flow paths
+*/
+void LandscapeEvolution::FillDepressions(float epsilon)
+{
+	int nx = hf.SizeX();
+	int ny = hf.SizeY();
+	float* h = hf.Data();
+	std::vector<bool> closed(nx * ny, false);
+	auto greater = [](const ScalarValue& a, const ScalarValue& b) { return a.value > b.value; };
+	std::priority_queue<ScalarValue, std::vector<ScalarValue>, decltype(greater)> open(greater);
+	for (int i = 0; i < ny; i++)
+	{
+		for (int j = 0; j < nx; j++)
+		{
+			if (i == 0 || j == 0 || i == ny - 1 || j == nx - 1)
+			{
+				open.push(ScalarValue(i, j, h[i * nx + j]));
+				closed[i * nx + j] = true;
+			}
+		}
+	}
+
+	while (!open.empty())
+	{
+		ScalarValue p = open.top();
+		open.pop();
+		for (int k = -1; k <= 1; k++)
+		{
+			for (int l = -1; l <= 1; l++)
+			{
+				int i = p.x + k, j = p.y + l;
+				if (hf.Inside(i, j) == false || closed[i * nx + j])
+					continue;
+				closed[i * nx + j] = true;
+				h[i * nx + j] = Math::Max(h[i * nx + j], p.value + epsilon);
+				open.push(ScalarValue(i, j, h[i * nx + j]));
+			}
+		}
+	}
+}
+
+/*
+\brief Get the single flow direction drainage area computed during the last step.
+*/
+ScalarField2D LandscapeEvolution::DrainageArea() const
+{
+	ScalarField2D ret(hf.SizeX(), hf.SizeY(), hf.GetBox());
+	std::copy(area.begin(), area.end(), ret.Data());
+	return ret;
+}
+
+/*
+\brief Get the receiver of every cell, computed during the last step.
+*/
+const std::vector<int>& LandscapeEvolution::Receivers() const
+{
+	return receivers;
+}
+
+/*
+\brief Get the cells ordered from the base level to the top of the donor trees, computed during the last step.
+*/
+const std::vector<int>& LandscapeEvolution::Stack() const
+{
+	return stack;
+}
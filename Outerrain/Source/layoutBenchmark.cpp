@@ -0,0 +1,121 @@
+#include "layoutBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+/*
+\class LayoutBenchmark layoutBenchmark.h
+\brief Timings of the gradient and of thermal weathering over row major, tiled and Morton fields.
+Both layouts of TiledField run the same kernels as HeightField, GradientKernel, ThermalTargetKernel and ThermalTransferKernel,
+through the tiled overloads of Stencil, and give the same heights. Conversions between layouts are not timed.
+*/
+
+/*
+\brief Get the milliseconds elapsed since a time point.
+*/
+static double Milliseconds(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+\brief Time the gradient of a row major field.
+\param hf terrain
+\param repeat pass count, the best pass is kept
+\return time of a pass, in milliseconds
+*/
+double LayoutBenchmark::Gradient(const HeightField& hf, int repeat)
+{
+	ValueField<Vector2> gradient(hf.SizeX(), hf.SizeY(), hf.GetBox());
+	GradientKernel kernel(hf.CellSize());
+	double best = -1.0;
+	for (int k = 0; k < repeat; k++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		Stencil::Apply(hf, gradient, 1, kernel);
+		double time = Milliseconds(start);
+		best = (best < 0.0) ? time : std::min(best, time);
+	}
+	return best;
+}
+
+/*
+\brief Time the gradient of a tiled field.
+\param hf terrain, converted to the layout before timing
+\param layout order of the cells inside the tiles
+\param repeat pass count, the best pass is kept
+\return time of a pass, in milliseconds
+*/
+double LayoutBenchmark::Gradient(const HeightField& hf, FieldLayout layout, int repeat)
+{
+	TiledField<float> field(hf, layout);
+	TiledField<Vector2> gradient(hf.SizeX(), hf.SizeY(), hf.GetBox(), layout, Vector2(0.0f));
+	GradientKernel kernel(hf.CellSize());
+	double best = -1.0;
+	for (int k = 0; k < repeat; k++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		Stencil::Apply(field, gradient, 1, kernel);
+		double time = Milliseconds(start);
+		best = (best < 0.0) ? time : std::min(best, time);
+	}
+	return best;
+}
+
+/*
+\brief Time thermal weathering steps over a copy of a row major field, see HeightField::ThermalWeathering().
+\param hf terrain
+\param steps step count
+\return time of all the steps, in milliseconds
+*/
+double LayoutBenchmark::Thermal(const HeightField& hf, int steps)
+{
+	HeightField field(hf);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int k = 0; k < steps; k++)
+		field.ThermalWeathering(1.0f);
+	return Milliseconds(start);
+}
+
+/*
+\brief Time thermal weathering steps over a tiled field, with the two passes of HeightField::ThermalWeathering().
+\param hf terrain, converted to the layout before timing
+\param layout order of the cells inside the tiles
+\param steps step count
+\return time of all the steps, in milliseconds
+*/
+double LayoutBenchmark::Thermal(const HeightField& hf, FieldLayout layout, int steps)
+{
+	TiledField<float> field(hf, layout);
+	TiledField<char> target(hf.SizeX(), hf.SizeY(), hf.GetBox(), layout);
+	ThermalTargetKernel targetKernel(0.6f * hf.CellSize().x);
+	ThermalTransferKernel transfer(1.0f);
+	float* h = field.Data();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int k = 0; k < steps; k++)
+	{
+		Stencil::Apply(field, target, 1, targetKernel);
+		Stencil::ForEach(target, 1, [&](const auto& n, int i, int j)
+		{
+			h[field.Index(i, j)] += transfer(n, i, j);
+		});
+	}
+	return Milliseconds(start);
+}
+
+/*
+\brief Print the times of the gradient and of thermal weathering steps over a fractal terrain in every layout.
+\param n resolution of the n x n terrain
+\param repeat gradient pass count, the best pass is kept
+\param steps thermal weathering step count
+*/
+void LayoutBenchmark::PrintTimes(int n, int repeat, int steps)
+{
+	HeightField hf(n, n, Box2D(Vector2(0.0f), Vector2(float(n))), PerlinNoise(), 100.0f, 0.004f, 6, FractalType::fBm);
+	std::cout << "Stencil passes over " << n << " x " << n << " fields, ms" << std::endl;
+	std::cout << "Layout : gradient / " << steps << " thermal steps" << std::endl;
+	std::cout << "Row major : " << Gradient(hf, repeat) << " / " << Thermal(hf, steps) << std::endl;
+	std::cout << "Tiled : " << Gradient(hf, LayoutTiled, repeat) << " / " << Thermal(hf, LayoutTiled, steps) << std::endl;
+	std::cout << "Morton : " << Gradient(hf, LayoutMorton, repeat) << " / " << Thermal(hf, LayoutMorton, steps) << std::endl;
+}
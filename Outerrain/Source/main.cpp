@@ -1,12 +1,24 @@
 #include "mainwindow.h"
+#include "memoryBenchmark.h"
+#include "layoutBenchmark.h"
+
+#include <cstring>
 
 //#include "ray.h"
 //#include "cameraOrbiter.h"
 //#include <iostream>
 //using namespace std;
 
-int main()
+int main(int argc, char* argv[])
 {
+	// Print the benchmarks of the simulation loops instead of opening the window
+	if (argc > 1 && strcmp(argv[1], "--benchmark") == 0)
+	{
+		MemoryBenchmark::PrintScaling();
+		LayoutBenchmark::PrintTimes();
+		return 0;
+	}
+
 	MainWindow mw = MainWindow(1280, 720);
 	mw.Show();
 
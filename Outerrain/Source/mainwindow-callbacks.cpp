@@ -4,48 +4,93 @@
 
 void MainWindow::StreamPowerErosionStep()
 {
-	if (hf == nullptr)
-		return;
-	hf->StreamPowerErosion(2.0);
-	UpdateMeshRenderer();
+	RunErosion(ErosionStreamPower, 10);
 }
 
 void MainWindow::ThermalErosionStep()
 {
-	if (hf == nullptr)
+	// GPU terrains keep their compute shader, which needs the OpenGL context of this thread
+	GPUHeightfield* gpuField = dynamic_cast<GPUHeightfield*>(hf);
+	if (gpuField != nullptr)
+	{
+		UpdateErosion();
+		StopErosion();
+		for (int i = 0; i < 1000; i++)
+			gpuField->ThermalWeathering(1.0f);
+		UpdateMeshRenderer();
 		return;
+	}
+	RunErosion(ErosionThermal, 1000);
+}
 
-	auto cpu_start = std::chrono::high_resolution_clock::now();
+void MainWindow::HydraulicErosionStep()
+{
+	RunErosion(ErosionHydraulic, 1);
+}
 
-	for (int i = 0; i < 1000; i++)
-		hf->ThermalWeathering(1.0f);
+void MainWindow::RunErosion(ErosionType type, int stepCount)
+{
+	if (hf == nullptr)
+		return;
+	if (erosion == nullptr)
+	{
+		erosion = new ErosionWorker(*hf);
+		erosionVersion = erosion->Version();
+	}
+	erosion->Run(type, stepCount);
+}
 
-	auto cpu_stop = std::chrono::high_resolution_clock::now();
-	long long int cpu_time = std::chrono::duration_cast<std::chrono::nanoseconds>(cpu_stop - cpu_start).count();
-	std::cout << "CPU " << int((cpu_time / 1000000)) << "ms" << int(((cpu_time / 1000) % 1000)) << "us" << std::endl;
+void MainWindow::UpdateErosion()
+{
+	// The render loop keeps drawing the last published state, and only copies newer ones
+	if (erosion != nullptr && hf != nullptr && erosion->CopySnapshot(*hf, erosionVersion))
+		UpdateMeshRenderer();
+}
 
-	UpdateMeshRenderer();
+void MainWindow::StopErosion()
+{
+	if (erosion != nullptr)
+		delete erosion;
+	erosion = nullptr;
 }
 
-void MainWindow::HydraulicErosionStep()
+void MainWindow::UpdateStreamer()
 {
-	if (hf == nullptr)
+	if (settings.terrainType != TerrainType::NoiseFieldTerrain || hf == nullptr)
 		return;
-	hf->HydraulicErosion();
-	UpdateMeshRenderer();
+	if (streamer == nullptr)
+	{
+		int tileCells = Math::Max(16, (settings.resolution - 1) / 4);
+		streamer = new TerrainStreamer(*settings.noise, settings.amplitude, settings.frequency, settings.octaves, settings.fractalType, settings.bottomLeft, hf->CellSize().x, tileCells);
+	}
+
+	// Tiles are requested around the camera in noise space, which is world space translated by offsetVector
+	Vector3 eye = orbiter.Position();
+	streamer->Update(Vector2(eye.x + settings.offsetVector.x, eye.z + settings.offsetVector.z));
 }
 
 void MainWindow::TranslateNoise(int y, int x)
 {
-	if (settings.terrainType != TerrainType::NoiseFieldTerrain)
+	if (settings.terrainType != TerrainType::NoiseFieldTerrain || hf == nullptr)
 		return;
+	StopErosion();
+	UpdateStreamer();
+
+	// The offset is kept exact, but the field is assembled from the nearest sample of the streamer grid,
+	// so that only the newly exposed tiles have to be computed.
+	Vector2 cellSize = hf->CellSize();
 	settings.offsetVector = settings.offsetVector + Vector3(float(x), 0.0f, float(y));
-	hf->InitFromNoise(*settings.noise, settings.amplitude, settings.frequency, settings.octaves, settings.offsetVector, settings.fractalType);
+	Vector2i firstSample = Vector2i(int(roundf(settings.offsetVector.x / cellSize.x)), int(roundf(settings.offsetVector.z / cellSize.y)));
+	streamer->Assemble(*hf, firstSample);
 	UpdateMeshRenderer();
 }
 
 void MainWindow::GenerateTerrainFromSettings(bool gpu)
 {
+	if (streamer != nullptr)
+		delete streamer;
+	streamer = nullptr;
+	StopErosion();
 	if (hf != nullptr)
 		delete hf;
 	if (gpu)
@@ -104,6 +149,14 @@ void MainWindow::UpdateMeshMaterial()
 
 void MainWindow::ClearScene() 
 {
+	if (streamer != nullptr)
+		delete streamer;
+	streamer = nullptr;
+	StopErosion();
+	if (graph != nullptr)
+		delete graph;
+	graph = nullptr;
+	graphRidges = nullptr;
 	if (hf != nullptr)
 		delete hf;
 	hf = nullptr;
@@ -1,5 +1,4 @@
 #include "mainwindow.h"
-#include "random.h"
 
 DirectionnalLight MainWindow::sceneLight = DirectionnalLight(Vector3(0.707f, -0.707f, 0.0f), Color(1.0f, 1.0f, 1.0f), Color(0.1, 0.1f, 0.1f), 0.8f);
 
@@ -161,3 +160,36 @@ void MainWindow::NoiseField2Scene()
 	GenerateTerrainFromSettings();
 	UpdateMeshRenderer();
 }
+
+void MainWindow::GraphScene()
+{
+	ClearScene();
+
+	settings.terrainType = TerrainType::GraphTerrain;
+	settings.resolution = 256;
+	settings.bottomLeft = Vector2(-1024, -1024);
+	settings.topRight = Vector2(1024, 1024);
+	settings.shaderType = MaterialType::TerrainSplatmapMaterial;
+
+	// Eroded mountains, with ridges added on the lower slopes only
+	graph = new TerrainGraph(settings.bottomLeft, (settings.topRight.x - settings.bottomLeft.x) / (settings.resolution - 1));
+	FractalNode* mountains = graph->Add(new FractalNode(NoisePerlin, 0, FractalType::MusgraveHybridMultifractal, 100.0f, 0.002f, 8));
+	ErosionNode* eroded = graph->Add(new ErosionNode(mountains, ErosionThermal, 50));
+	FractalNode* ridges = graph->Add(new FractalNode(NoiseSimplex, 1, FractalType::Ridge, 40.0f, 0.004f, 4));
+	MaskNode* valleys = graph->Add(new MaskNode(mountains, -1000.0f, 20.0f, 30.0f));
+	graphRidges = graph->Add(new BlendNode(eroded, ridges, BlendAdd, 0.5f, valleys));
+
+	hf = new HeightField(graph->Evaluate(graphRidges, Vector2i(0), settings.resolution));
+	UpdateMeshRenderer();
+}
+
+/*
+\brief Evaluate the graph terrain again after a parameter change : only the modified nodes and
+their downstream nodes are recomputed.
+*/
+void MainWindow::UpdateGraphTerrain()
+{
+	HeightField field = graph->Evaluate(graphRidges, Vector2i(0), settings.resolution);
+	std::copy(field.Data(), field.Data() + field.SizeX() * field.SizeY(), hf->Data());
+	UpdateMeshRenderer();
+}
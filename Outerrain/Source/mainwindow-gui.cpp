@@ -39,8 +39,33 @@ void MainWindow::RenderGUI()
 	ImGui::Text(gpuStream.str().data());
 	ImGui::Text((std::string("Vertices : ") + PrettyFormatNumbers(AppStatistics::vertexCount)).c_str());
 	ImGui::Text((std::string("Triangles : ") + PrettyFormatNumbers(AppStatistics::triangleCount)).c_str());
+	TaskScheduler& scheduler = TaskScheduler::Global();
+	for (int i = 0; i < scheduler.ThreadCount(); i++)
+	{
+		WorkerStatistics stats = scheduler.Statistics(i);
+		ImGui::Text("Worker %d : %3.0f%% %llu tasks %llu steals", i, 100.0 * scheduler.Utilization(i), stats.taskCount, stats.stealCount);
+	}
 	ImGui::End();
 
+	/* Erosion panel */
+	if (erosion != nullptr)
+	{
+		ImGui::Begin("Erosion");
+		ImGui::Text("Steps : %d done, %d left", erosion->CompletedSteps(), erosion->RemainingSteps());
+		ImGui::Text("Active cells : %d", erosion->ActiveCellCount());
+		if (erosion->IsPaused())
+		{
+			if (ImGui::Button("Resume"))
+				erosion->Resume();
+		}
+		else if (ImGui::Button("Pause"))
+			erosion->Pause();
+		ImGui::SameLine();
+		if (ImGui::Button("Cancel"))
+			erosion->Cancel();
+		ImGui::End();
+	}
+
 	ImGui::Begin("Examples");
 	if (ImGui::Button("Heightfield 1"))
 		Heightfield1Scene();
@@ -54,6 +79,11 @@ void MainWindow::RenderGUI()
 	if (ImGui::Button("NoiseField 2"))
 		NoiseField2Scene();
 	ImGui::Spacing();
+	if (ImGui::Button("Graph"))
+		GraphScene();
+	if (graphRidges != nullptr && ImGui::SliderFloat("Ridges", &graphRidges->weight, 0.0f, 1.0f))
+		UpdateGraphTerrain();
+	ImGui::Spacing();
 	ImGui::Spacing();
 	ImGui::Spacing();
 
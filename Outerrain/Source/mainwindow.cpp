@@ -7,6 +7,11 @@
 MainWindow::MainWindow(int windowWidth, int windowHeight)
 {
 	hf = nullptr;
+	streamer = nullptr;
+	erosion = nullptr;
+	erosionVersion = 0;
+	graph = nullptr;
+	graphRidges = nullptr;
 	mainWindowHandler = new Window(windowWidth, windowHeight);
 	Init();
 }
@@ -20,6 +25,17 @@ void MainWindow::Quit()
 	MaterialBase::ReleaseStaticMaterials();
 	ImGui_OpenGL_Shutdown();
 	AppStatistics::Release();
+	if (streamer)
+	{
+		delete streamer;
+		streamer = nullptr;
+	}
+	StopErosion();
+	if (graph)
+	{
+		delete graph;
+		graph = nullptr;
+	}
 	if (hf)
 	{
 		delete hf;
@@ -85,6 +101,7 @@ void MainWindow::Update()
 		ThermalErosionStep();
 	if (mainWindowHandler->KeyState(SDLK_F3))
 		HydraulicErosionStep();
+	UpdateErosion();
 
 	if (mainWindowHandler->ButtonEvent().button == SDL_BUTTON_LEFT && mainWindowHandler->KeyState(SDLK_LCTRL) && mainWindowHandler->KeyState(SDLK_LSHIFT))
 	{
@@ -115,6 +132,7 @@ void MainWindow::Update()
 		TranslateNoise(0, offset);
 	if (mainWindowHandler->KeyState(SDLK_RIGHT))
 		TranslateNoise(0, -offset);
+	UpdateStreamer();
 
 	// Changing shader
 	if (mainWindowHandler->KeyState(SDLK_1))
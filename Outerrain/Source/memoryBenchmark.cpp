@@ -0,0 +1,97 @@
+#include "memoryBenchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+/*
+\class MemoryBenchmark memoryBenchmark.h
+\brief Bandwidth measures of the banded loops over large fields.
+The kernel is a triad a = b + s c over three fields, the access pattern of the explicit erosion and uplift updates.
+It streams 12 bytes per cell, or 16 bytes counting the read of the written line.
+On a NUMA machine, fields first touched by the calling thread all live on its node, and the bandwidth stops
+growing once the threads of the other nodes start reading them remotely : with first touched bands it keeps scaling.
+*/
+
+/*
+\brief Write the values of a field for the first time, internal function.
+*/
+void MemoryBenchmark::FirstTouch(TaskScheduler& scheduler, float* data, int nx, int ny, float value, FieldAllocation allocation)
+{
+	if (allocation == AllocateSerial)
+	{
+		std::fill(data, data + size_t(nx) * ny, value);
+		return;
+	}
+	scheduler.ParallelBands(0, ny, [&](int first, int last)
+	{
+		std::fill(data + size_t(first) * nx, data + size_t(last) * nx, value);
+	});
+}
+
+/*
+\brief Measure the bandwidth of a triad over three new fields, by bands of rows of a scheduler.
+\param scheduler scheduler running the bands, whose threads should be pinned, see TaskScheduler::PinThreads()
+\param nx, ny resolution, fields should be much larger than the last level cache
+\param allocation how the fields are first touched
+\param repeat pass count, the best pass is kept
+\return bandwidth, in GB/s, counting 12 bytes per cell
+*/
+double MemoryBenchmark::Bandwidth(TaskScheduler& scheduler, int nx, int ny, FieldAllocation allocation, int repeat)
+{
+	// Buffers are uninitialized until first touched, see AlignedAllocator
+	size_t size = size_t(nx) * ny;
+	ValueField<float>::Buffer a, b, c;
+	a.resize(size);
+	b.resize(size);
+	c.resize(size);
+	FirstTouch(scheduler, a.data(), nx, ny, 0.0f, allocation);
+	FirstTouch(scheduler, b.data(), nx, ny, 1.0f, allocation);
+	FirstTouch(scheduler, c.data(), nx, ny, 2.0f, allocation);
+
+	float* pa = a.data();
+	const float* pb = b.data();
+	const float* pc = c.data();
+	const float s = 0.5f;
+	double best = 0.0;
+	for (int k = 0; k < repeat; k++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		scheduler.ParallelBands(0, ny, [&](int first, int last)
+		{
+			for (size_t id = size_t(first) * nx; id < size_t(last) * nx; id++)
+				pa[id] = pb[id] + s * pc[id];
+		});
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (seconds > 0.0)
+			best = std::max(best, 12.0 * double(size) / seconds * 1.0e-9);
+	}
+	return best;
+}
+
+/*
+\brief Print the bandwidth of the triad for thread counts doubling up to the hardware thread count,
+with fields first touched by the calling thread and by bands, threads being pinned to their cores.
+The cores of the calling thread are restored after every measure, so that every scheduler pins its threads over all of them.
+\param n resolution of the n x n fields
+\param repeat pass count per measure
+*/
+void MemoryBenchmark::PrintScaling(int n, int repeat)
+{
+	int hardware = std::max(1, int(std::thread::hardware_concurrency()));
+	std::cout << "Triad bandwidth over " << n << " x " << n << " fields, GB/s" << std::endl;
+	std::cout << "Threads : serial first touch / banded first touch" << std::endl;
+	std::vector<int> cores = TaskScheduler::CallingThreadCores();
+	for (int threads = 1; ; threads = std::min(2 * threads, hardware))
+	{
+		TaskScheduler scheduler(threads);
+		bool pinned = scheduler.PinThreads();
+		double serial = Bandwidth(scheduler, n, n, AllocateSerial, repeat);
+		double banded = Bandwidth(scheduler, n, n, AllocateFirstTouch, repeat);
+		TaskScheduler::SetCallingThreadCores(cores);
+		std::cout << scheduler.ThreadCount() << (pinned ? " pinned" : "") << " : " << serial << " / " << banded << std::endl;
+		if (threads == hardware)
+			break;
+	}
+}
@@ -45,6 +45,23 @@ void Mesh::AddTexcoord(const Vector2& t)
 	isDirty = true;
 }
 
+/*
+\brief Reserve the buffers of a mesh whose size is known, so that adding its vertices and triangles never reallocates.
+\param vertexCount vertex count
+\param triangleCount triangle count
+\param withNormals true if a normal is added per vertex
+\param withTexcoords true if a texcoord is added per vertex
+*/
+void Mesh::Reserve(size_t vertexCount, size_t triangleCount, bool withNormals, bool withTexcoords)
+{
+	vertices.reserve(vertexCount);
+	if (withNormals)
+		normals.reserve(vertexCount);
+	if (withTexcoords)
+		texcoords.reserve(vertexCount);
+	indices.reserve(3 * triangleCount);
+}
+
 Box Mesh::GetBounds() const
 {
 	Box ret = Box(Vector3(0), 1.0);
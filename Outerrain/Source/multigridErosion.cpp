@@ -0,0 +1,109 @@
+#include "multigridErosion.h"
+#include "landscapeEvolution.h"
+
+#include <cmath>
+
+/*
+\class MultigridErosion multigridErosion.h
+\brief Coarse to fine erosion driver. Erosion moves matter by about a cell per step, so the large scale features
+of a fine terrain take thousands of steps to form. The driver erodes the coarsest level of a pyramid of the terrain
+first, where a step spans many fine cells, then goes up the pyramid : the change of every level is upsampled and
+added to the next finer level, which keeps its own details, and refined with fewer steps.
+Step counts decrease geometrically from the coarsest level to the finest one.
+Thermal weathering benefits most. Stream power erosion reaches a lower relief on coarse levels, as drainage areas
+start at the cell area, so the finest level needs more steps to rebuild its hillslopes.
+*/
+
+/*
+\brief Constructor
+\param type erosion type, see ErosionWorker
+\param levelCount pyramid level count, 1 erodes the terrain directly
+\param coarseSteps step count of the coarsest level
+\param fineSteps step count of the finest level
+*/
+MultigridErosion::MultigridErosion(ErosionType type, int levelCount, int coarseSteps, int fineSteps)
+	: type(type), levelCount(levelCount), coarseSteps(coarseSteps), fineSteps(fineSteps), amplitude(1.0f), tanThresholdAngle(0.6f), dt(1.0e4f)
+{
+}
+
+/*
+\brief Set the thermal weathering parameters, see HeightField::ThermalWeathering().
+*/
+void MultigridErosion::SetThermal(float a, float t)
+{
+	amplitude = a;
+	tanThresholdAngle = t;
+}
+
+/*
+\brief Set the time step of stream power erosion, see LandscapeEvolution.
+*/
+void MultigridErosion::SetStreamPower(float t)
+{
+	dt = t;
+}
+
+/*
+\brief Get the step count of a level.
+\param level level, 0 being the finest
+\param count level count of the pyramid
+*/
+int MultigridErosion::StepCount(int level, int count) const
+{
+	if (count <= 1)
+		return coarseSteps;
+	float t = float(level) / float(count - 1);
+	return int(roundf(fineSteps * powf(float(coarseSteps) / float(fineSteps), t)));
+}
+
+/*
+\brief Erode a level, internal function.
+\param hf level
+\param steps step count
+\param scale cell size of the level relative to the finest level. Thermal weathering moves matter in proportion,
+so that a step changes slopes by the same amount at every level.
+*/
+void MultigridErosion::Erode(HeightField& hf, int steps, float scale) const
+{
+	if (type == ErosionThermal)
+		hf.ThermalWeatheringUntilStable(amplitude * scale, tanThresholdAngle, steps);
+	else if (type == ErosionHydraulic)
+	{
+		for (int k = 0; k < steps; k++)
+			hf.HydraulicErosion();
+	}
+	else if (type == ErosionStreamPower)
+	{
+		LandscapeEvolution evolution(hf);
+		evolution.FillDepressions();
+		for (int k = 0; k < steps; k++)
+			evolution.Step(dt);
+	}
+}
+
+/*
+\brief Erode a terrain from its coarsest level to its finest one.
+\param hf eroded heightfield
+*/
+void MultigridErosion::Run(HeightField& hf) const
+{
+	FieldPyramid pyramid(hf, levelCount);
+	int count = pyramid.LevelCount();
+	for (int l = count - 1; l >= 0; l--)
+	{
+		const ScalarField2D& level = pyramid.Level(l);
+		HeightField eroded(level.SizeX(), level.SizeY(), level.GetBox());
+		std::copy(level.Data(), level.Data() + level.SizeX() * level.SizeY(), eroded.Data());
+		Erode(eroded, StepCount(l, count), eroded.CellSize().x / hf.CellSize().x);
+		if (l == 0)
+		{
+			std::copy(eroded.Data(), eroded.Data() + hf.SizeX() * hf.SizeY(), hf.Data());
+			break;
+		}
+
+		// Correction of the finer level by the change of this level
+		ScalarField2D change(eroded - level);
+		ScalarField2D& finer = pyramid.Level(l - 1);
+		finer = finer + FieldPyramid::Upsample(change, finer.SizeX(), finer.SizeY());
+	}
+}
@@ -0,0 +1,19 @@
+#include "noise.h"
+#include "randomStream.h"
+
+/*
+\brief Build a shuffled permutation table of 256 entries, duplicated to 512 so that
+lattice hashes like perm[perm[i] + j] never need to wrap.
+\param seed seed of the shuffle
+\param perm output table, must hold 512 integers
+*/
+void Noise::InitPermutation(unsigned int seed, int* perm)
+{
+	for (int i = 0; i < 256; i++)
+		perm[i] = i;
+	RandomStream random(seed, RandomSubsystem::Noise, 0);
+	for (int i = 255; i > 0; i--)
+		Math::Swap(perm[i], perm[random.Range(i + 1)]);
+	for (int i = 0; i < 256; i++)
+		perm[256 + i] = perm[i];
+}
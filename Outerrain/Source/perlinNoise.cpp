@@ -1,5 +1,5 @@
 #include "noise.h"
-#include "random.h"
+#include "randomStream.h"
 
 /*
 \brief Perlin/Gradient noise class. Returns value between [-1, 1] in 2D or 3D.
@@ -7,14 +7,14 @@ https://www.scratchapixel.com/lessons/procedural-generation-virtual-worlds/perli
 
 */
 
-// get base random alias which is auto seeded and has static API and internal state
-using Random = effolkronium::random_static;
-
 /*
 \brief Constructor. Initialize gradient arrays.
+\param seed noise seed
 */
-PerlinNoise::PerlinNoise()
+PerlinNoise::PerlinNoise(unsigned int seed)
 {
+	RandomStream random(seed, RandomSubsystem::Noise, 1);
+
 	p = new int[256];
 	Gx = new float[256];
 	Gy = new float[256];
@@ -23,16 +23,16 @@ PerlinNoise::PerlinNoise()
 	for (int i = 0; i < 256; ++i) 
 	{
 		p[i] = i;
-		Gx[i] = (float(Random::get()) / (Random::max() / 2)) - 1.0f;
-		Gy[i] = (float(Random::get()) / (Random::max() / 2)) - 1.0f;
-		Gz[i] = (float(Random::get()) / (Random::max() / 2)) - 1.0f;
+		Gx[i] = random.Uniform(-1.0f, 1.0f);
+		Gy[i] = random.Uniform(-1.0f, 1.0f);
+		Gz[i] = random.Uniform(-1.0f, 1.0f);
 	}
 
 	int j = 0;
 	int swp = 0;
 	for (int i = 0; i < 256; i++)
 	{
-		j = Random::get() & 255;
+		j = random.Range(256);
 		swp = p[i];
 		p[i] = p[j];
 		p[j] = swp;
@@ -115,14 +115,38 @@ float PerlinNoise::At(const Vector3& point) const
 
 /*
 \brief Compute Perlin noise in 2D. Last coordinates is set to 1.0f by default.
+Since the sample lies on the z0 face of the unit cube, only the 4 corners of this face contribute :
+the result is the same as the 3D version, at half the cost.
 \param point position
 */
 float PerlinNoise::GetValue(const Vector2& point) const
 {
-	float sample_x = point.x;
-	float sample_y = point.y;
-	float sample_z = 1.0f;
-	return At(Vector3(sample_x, sample_y, sample_z));
+	int x0 = int(floorf(point.x));
+	int x1 = x0 + 1;
+	int y0 = int(floorf(point.y));
+	int y1 = y0 + 1;
+
+	float px0 = point.x - float(x0);
+	float px1 = px0 - 1.0f;
+	float py0 = point.y - float(y0);
+	float py1 = py0 - 1.0f;
+
+	int pz = p[1];
+	int gIndex = p[(x0 + p[(y0 + pz) & 255]) & 255];
+	float d00 = Gx[gIndex] * px0 + Gy[gIndex] * py0;
+	gIndex = p[(x1 + p[(y0 + pz) & 255]) & 255];
+	float d01 = Gx[gIndex] * px1 + Gy[gIndex] * py0;
+	gIndex = p[(x0 + p[(y1 + pz) & 255]) & 255];
+	float d10 = Gx[gIndex] * px0 + Gy[gIndex] * py1;
+	gIndex = p[(x1 + p[(y1 + pz) & 255]) & 255];
+	float d11 = Gx[gIndex] * px1 + Gy[gIndex] * py1;
+
+	float wx = ((6 * px0 - 15)*px0 + 10)*px0*px0*px0;
+	float wy = ((6 * py0 - 15)*py0 + 10)*py0*py0*py0;
+
+	float xa = d00 + wx*(d01 - d00);
+	float xb = d10 + wx*(d11 - d10);
+	return xa + wy*(xb - xa);
 }
 
 /*
@@ -1,28 +1,27 @@
 #include "poissonTile2D.h"
-#include "random.h"
+#include "randomStream.h"
 
-using Random = effolkronium::random_static;
 
-
-PoissonTile2D::PoissonTile2D() : r(0), tileSize(0), maxTries(0)
+PoissonTile2D::PoissonTile2D() : r(0), tileSize(0), maxTries(0), seed(0)
 {
 
 }
 
-PoissonTile2D::PoissonTile2D(int r, float tileSize, int maxTries) : r(r), tileSize(tileSize), maxTries(maxTries)
+PoissonTile2D::PoissonTile2D(int r, float tileSize, int maxTries, unsigned int seed) : r(r), tileSize(tileSize), maxTries(maxTries), seed(seed)
 {
 	Generate();
 }
 
 void PoissonTile2D::Generate()
 {
+	RandomStream random(seed, RandomSubsystem::Poisson);
 	Vector2 tileCenter = Vector2(tileSize / 2.0f, tileSize / 2.0f);
 	int i = 0;
 	while (i < maxTries)
 	{
 		// Get random sample point
-		float randX = Random::get() / float(Random::max());
-		float randY = Random::get() / float(Random::max());
+		float randX = random.NextFloat();
+		float randY = random.NextFloat();
 		Vector2 point = Vector2(randX * tileSize, randY * tileSize);
 		i++;
 
@@ -86,6 +85,7 @@ void PoissonTile2D::Generate()
 
 void PoissonTile2D::Randomize()
 {
+	seed++;
 	Generate();
 }
 
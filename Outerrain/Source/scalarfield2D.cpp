@@ -1,6 +1,7 @@
 #include "scalarfield2D.h"
 #include "mathUtils.h"
 #include "texture2D.h"
+#include "heightmapImporter.h"
 
 /*!
 \class Scalarfield2D scalarfield.h
@@ -47,49 +48,83 @@ ScalarField2D::ScalarField2D(int nx, int ny, const Box2D& bbox, float value) : V
 {
 }
 
+/*
+\brief Constructor, with values first touched in parallel for large fields on NUMA machines, see FieldAllocation.
+\param nx size in x axis
+\param ny size in y axis
+\param bbox bounding box of the domain
+\param value default value of the field
+\param allocation how values are written for the first time
+*/
+ScalarField2D::ScalarField2D(int nx, int ny, const Box2D& bbox, float value, FieldAllocation allocation) : ValueField(nx, ny, bbox, value, allocation)
+{
+}
+
+/*
+\brief Constructor taking over a buffer, usually from BufferPool<float>::Global(). Values are left as they are in the buffer.
+\param nx size in x axis
+\param ny size in y axis
+\param bbox bounding box of the domain
+\param buffer values
+*/
+ScalarField2D::ScalarField2D(int nx, int ny, const Box2D& bbox, Buffer&& buffer) : ValueField(nx, ny, bbox, std::move(buffer))
+{
+}
+
 /*
 \brief copy constructor
 \param field Scalarfield2D to copy
 */
-ScalarField2D::ScalarField2D(const ScalarField2D& field) : ValueField(field.nx, field.ny, field.box)
+ScalarField2D::ScalarField2D(const ScalarField2D& field) : ValueField(field)
 {
-	for (unsigned int i = 0; i < values.size(); i++)
-		values[i] = field.values[i];
 }
 
 /*
-\brief Destructor
+\brief Move constructor, takes over the values of the field, which is left empty.
+\param field Scalarfield2D to move
 */
-ScalarField2D::~ScalarField2D() 
+ScalarField2D::ScalarField2D(ScalarField2D&& field) : ValueField(std::move(field))
 {
+	field.nx = field.ny = 0;
 }
 
 /*
-\brief Compute the gradient for the vertex (i, j)
+\brief Copy assignment.
+\param field Scalarfield2D to copy
 */
-Vector2 ScalarField2D::Gradient(int i, int j) const
+ScalarField2D& ScalarField2D::operator=(const ScalarField2D& field)
 {
-	Vector2 ret;
-	float cellSizeX = (box.Vertex(1).x - box.Vertex(0).x) / (nx - 1);
-	float cellSizeY = (box.Vertex(1).y - box.Vertex(0).y) / (ny - 1);
+	ValueField::operator=(field);
+	return *this;
+}
 
-	// X Gradient
-	if (i == 0)
-		ret.x = (Get(i + 1, j) - Get(i, j)) / cellSizeX;
-	else if (i == ny - 1)
-		ret.x = (Get(i, j) - Get(i - 1, j)) / cellSizeX;
-	else
-		ret.x = (Get(i + 1, j) - Get(i - 1, j)) / (2.0f * cellSizeX);
+/*
+\brief Move assignment, takes over the values of the field, which is left empty.
+\param field Scalarfield2D to move
+*/
+ScalarField2D& ScalarField2D::operator=(ScalarField2D&& field)
+{
+	if (this != &field)
+	{
+		ValueField::operator=(std::move(field));
+		field.nx = field.ny = 0;
+	}
+	return *this;
+}
 
-	// Y Gradient
-	if (j == 0)
-		ret.y = (Get(i, j + 1) - Get(i, j)) / cellSizeY;
-	else if (j == nx - 1)
-		ret.y = (Get(i, j) - Get(i, j - 1)) / cellSizeY;
-	else
-		ret.y = (Get(i, j + 1) - Get(i, j - 1)) / (2.0f * cellSizeY);
+/*
+\brief Destructor
+*/
+ScalarField2D::~ScalarField2D() 
+{
+}
 
-	return ret;
+/*
+\brief Compute the gradient for the vertex (i, j), see GradientKernel.
+*/
+Vector2 ScalarField2D::Gradient(int i, int j) const
+{
+	return Stencil::At(*this, 1, i, j, GradientKernel(CellSize()));
 }
 
 /*
@@ -113,10 +148,9 @@ void ScalarField2D::Remove(int i, int j, float v)
 */
 void ScalarField2D::NormalizeField()
 {
-	float min = Min();
-	float max = Max();
-	for (int i = 0; i < ny * nx; i++)
-		values[i] = (values[i] - min) / (max - min);
+	float min, max;
+	ReduceMinMax(*this, min, max);
+	*this = (*this - min) / (max - min);
 }
 
 /*
@@ -126,8 +160,7 @@ void ScalarField2D::NormalizeField()
 */
 void ScalarField2D::NormalizeField(float min, float max)
 {
-	for (int i = 0; i < ny * nx; i++)
-		values[i] = (values[i] - min) / (max - min);
+	*this = (*this - min) / (max - min);
 }
 
 /*
@@ -135,12 +168,9 @@ void ScalarField2D::NormalizeField(float min, float max)
 */
 ScalarField2D ScalarField2D::Normalized() const
 {
-	ScalarField2D ret(*this);
-	float min = Min();
-	float max = Max();
-	for (int i = 0; i < ny * nx; i++)
-		ret.values[i] = (ret.values[i] - min) / (max - min);
-	return ret;
+	float min, max;
+	ReduceMinMax(*this, min, max);
+	return ScalarField2D((*this - min) / (max - min));
 }
 
 /*
@@ -148,10 +178,7 @@ ScalarField2D ScalarField2D::Normalized() const
 */
 float ScalarField2D::Average() const
 {
-	float ret = 0.0f;
-	for (unsigned int i = 0; i < values.size(); i++)
-		ret += values[i];
-	return ret / float(values.size());
+	return ReduceAverage(*this);
 }
 
 /*
@@ -255,46 +282,18 @@ Vector3 ScalarField2D::Vertex(const Vector2& v) const
 }
 
 /*
-\brief todo
+\brief Fill the field from a heightmap file, resampled bilinearly to the field resolution.
+See HeightmapImporter for the supported formats.
+\param filePath image file path
+\param blackValue value of black pixels
+\param whiteValue value of white pixels
 */
 void ScalarField2D::ReadFromImage(const std::string& filePath, float blackValue, float whiteValue)
 {
-	Texture2D grayscaleTex = Texture2D(filePath);
-	float texelX = 1.0f / (grayscaleTex.Width());
-	float texelY = 1.0f / (grayscaleTex.GetValueBilinear());
-	for (int i = 0; i < ny; i++)
-	{
-		for (int j = 0; j < nx; j++)
-		{
-			float u = j / float(nx - 1);
-			float v = i / float(ny - 1);
-
-			int anchorX = int((u * (grayscaleTex.Width() - 1)));
-			int anchorY = int((v * (grayscaleTex.GetValueBilinear() - 1)));
-			if (anchorX == grayscaleTex.Width() - 1)
-				anchorX--;
-			if (anchorY == grayscaleTex.GetValueBilinear() - 1)
-				anchorY--;
-
-			// Bilinear interpolation
-			float a = grayscaleTex.Pixel(anchorX, anchorY).r;
-			float b = grayscaleTex.Pixel(anchorX, anchorY + 1).r;
-			float c = grayscaleTex.Pixel(anchorX + 1, anchorY + 1).r;
-			float d = grayscaleTex.Pixel(anchorX + 1, anchorY).r;
-
-			float anchorU = anchorX * texelX;
-			float anchorV = anchorY * texelY;
-
-			float localU = (u - anchorU) / texelX;
-			float localV = (v - anchorV) / texelY;
-
-			float abu = Math::Lerp(a, b, localV);
-			float dcu = Math::Lerp(d, c, localV);
-
-			float value = Math::Lerp(abu, dcu, localU);
-			Set(i, j, blackValue + value * (whiteValue - blackValue));
-		}
-	}
+	ValueField<float> image;
+	if (HeightmapImporter::Load(filePath, image) == false)
+		return;
+	HeightmapImporter::Resample(image, *this, blackValue, whiteValue);
 }
 
 /*
@@ -0,0 +1,184 @@
+#include "noise.h"
+
+/*
+\brief Simplex noise class. Returns value between [-1, 1] in 2D or 3D.
+Evaluates 3 corners in 2D and 4 corners in 3D instead of the 4 and 8 of Perlin noise.
+Based on http://staffwww.itn.liu.se/~stegu/simplexnoise/simplexnoise.pdf
+*/
+
+static const float F2 = 0.366025403f;	// (sqrt(3) - 1) / 2
+static const float G2 = 0.211324865f;	// (3 - sqrt(3)) / 6
+static const float F3 = 1.0f / 3.0f;
+static const float G3 = 1.0f / 6.0f;
+
+static const float Grad2X[8] = { 1.0f, -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 0.0f, 0.0f };
+static const float Grad2Y[8] = { 1.0f, 1.0f, -1.0f, -1.0f, 0.0f, 0.0f, 1.0f, -1.0f };
+
+static const float Grad3X[12] = { 1, -1, 1, -1, 1, -1, 1, -1, 0, 0, 0, 0 };
+static const float Grad3Y[12] = { 1, 1, -1, -1, 0, 0, 0, 0, 1, -1, 1, -1 };
+static const float Grad3Z[12] = { 0, 0, 0, 0, 1, 1, -1, -1, 1, 1, -1, -1 };
+
+/*
+\brief Constructor. Initialize the permutation table.
+\param seed noise seed
+*/
+SimplexNoise::SimplexNoise(unsigned int seed)
+{
+	InitPermutation(seed, perm);
+}
+
+/*
+\brief Compute Simplex noise in 2D. This is an internal function.
+Written without branches so that batch evaluation can be vectorized by the compiler.
+*/
+inline float SimplexNoise::At(float x, float y) const
+{
+	// Skew input space to find the simplex cell
+	float s = (x + y) * F2;
+	int i = FastFloor(x + s);
+	int j = FastFloor(y + s);
+	float t = float(i + j) * G2;
+	float x0 = x - (float(i) - t);
+	float y0 = y - (float(j) - t);
+
+	// Lower or upper triangle of the cell
+	int i1 = x0 > y0 ? 1 : 0;
+	int j1 = 1 - i1;
+
+	float x1 = x0 - float(i1) + G2;
+	float y1 = y0 - float(j1) + G2;
+	float x2 = x0 - 1.0f + 2.0f * G2;
+	float y2 = y0 - 1.0f + 2.0f * G2;
+
+	int ii = i & 255;
+	int jj = j & 255;
+	int g0 = perm[ii + perm[jj]] & 7;
+	int g1 = perm[ii + i1 + perm[jj + j1]] & 7;
+	int g2 = perm[ii + 1 + perm[jj + 1]] & 7;
+
+	// Corner contributions
+	float t0 = Math::Max(0.5f - x0 * x0 - y0 * y0, 0.0f);
+	float t1 = Math::Max(0.5f - x1 * x1 - y1 * y1, 0.0f);
+	float t2 = Math::Max(0.5f - x2 * x2 - y2 * y2, 0.0f);
+	t0 *= t0;
+	t1 *= t1;
+	t2 *= t2;
+	float n0 = t0 * t0 * (Grad2X[g0] * x0 + Grad2Y[g0] * y0);
+	float n1 = t1 * t1 * (Grad2X[g1] * x1 + Grad2Y[g1] * y1);
+	float n2 = t2 * t2 * (Grad2X[g2] * x2 + Grad2Y[g2] * y2);
+
+	return 70.0f * (n0 + n1 + n2);
+}
+
+/*
+\brief Compute Simplex noise in 3D for arrays of coordinates. This is an internal function.
+The loop over the points has no branches and is vectorized by the compiler.
+*/
+void SimplexNoise::At(const float* px, const float* py, const float* pz, float* values, int count) const
+{
+	for (int c = 0; c < count; c++)
+	{
+		float x = px[c], y = py[c], z = pz[c];
+		float s = (x + y + z) * F3;
+		int i = FastFloor(x + s);
+		int j = FastFloor(y + s);
+		int k = FastFloor(z + s);
+		float t = float(i + j + k) * G3;
+		float x0 = x - (float(i) - t);
+		float y0 = y - (float(j) - t);
+		float z0 = z - (float(k) - t);
+
+		// Rank the coordinates to find the simplex among the six of the cube
+		int xy = x0 >= y0 ? 1 : 0;
+		int yz = y0 >= z0 ? 1 : 0;
+		int xz = x0 >= z0 ? 1 : 0;
+		int i1 = xy & xz;
+		int j1 = (1 - xy) & yz;
+		int k1 = (1 - xz) & (1 - yz);
+		int i2 = xy | xz;
+		int j2 = (1 - xy) | yz;
+		int k2 = (1 - xz) | (1 - yz);
+
+		float x1 = x0 - float(i1) + G3;
+		float y1 = y0 - float(j1) + G3;
+		float z1 = z0 - float(k1) + G3;
+		float x2 = x0 - float(i2) + 2.0f * G3;
+		float y2 = y0 - float(j2) + 2.0f * G3;
+		float z2 = z0 - float(k2) + 2.0f * G3;
+		float x3 = x0 - 1.0f + 3.0f * G3;
+		float y3 = y0 - 1.0f + 3.0f * G3;
+		float z3 = z0 - 1.0f + 3.0f * G3;
+
+		int ii = i & 255;
+		int jj = j & 255;
+		int kk = k & 255;
+		int g0 = perm[ii + perm[jj + perm[kk]]] % 12;
+		int g1 = perm[ii + i1 + perm[jj + j1 + perm[kk + k1]]] % 12;
+		int g2 = perm[ii + i2 + perm[jj + j2 + perm[kk + k2]]] % 12;
+		int g3 = perm[ii + 1 + perm[jj + 1 + perm[kk + 1]]] % 12;
+
+		float t0 = Math::Max(0.6f - x0 * x0 - y0 * y0 - z0 * z0, 0.0f);
+		float t1 = Math::Max(0.6f - x1 * x1 - y1 * y1 - z1 * z1, 0.0f);
+		float t2 = Math::Max(0.6f - x2 * x2 - y2 * y2 - z2 * z2, 0.0f);
+		float t3 = Math::Max(0.6f - x3 * x3 - y3 * y3 - z3 * z3, 0.0f);
+		t0 *= t0;
+		t1 *= t1;
+		t2 *= t2;
+		t3 *= t3;
+		float n0 = t0 * t0 * (Grad3X[g0] * x0 + Grad3Y[g0] * y0 + Grad3Z[g0] * z0);
+		float n1 = t1 * t1 * (Grad3X[g1] * x1 + Grad3Y[g1] * y1 + Grad3Z[g1] * z1);
+		float n2 = t2 * t2 * (Grad3X[g2] * x2 + Grad3Y[g2] * y2 + Grad3Z[g2] * z2);
+		float n3 = t3 * t3 * (Grad3X[g3] * x3 + Grad3Y[g3] * y3 + Grad3Z[g3] * z3);
+
+		values[c] = 32.0f * (n0 + n1 + n2 + n3);
+	}
+}
+
+/*
+\brief Compute Simplex noise in 2D.
+\param point position
+*/
+float SimplexNoise::GetValue(const Vector2& point) const
+{
+	return At(point.x, point.y);
+}
+
+/*
+\brief Compute Simplex noise in 3D.
+\param point position
+*/
+float SimplexNoise::GetValue(const Vector3& point) const
+{
+	float value;
+	At(&point.x, &point.y, &point.z, &value, 1);
+	return value;
+}
+
+/*
+\brief Compute Simplex noise in 2D for an array of points.
+\param points positions
+\param values returned noise values
+\param count point count
+*/
+void SimplexNoise::GetValues(const Vector2* points, float* values, int count) const
+{
+	Batch(points, values, count, [this](const float* x, const float* y, float* r, int n)
+	{
+		for (int k = 0; k < n; k++)
+			r[k] = At(x[k], y[k]);
+	});
+}
+
+/*
+\brief Compute Simplex noise in 3D for an array of points.
+\param points positions
+\param values returned noise values
+\param count point count
+*/
+void SimplexNoise::GetValues(const Vector3* points, float* values, int count) const
+{
+	Batch(points, values, count, [this](const float* x, const float* y, const float* z, float* r, int n)
+	{
+		At(x, y, z, r, n);
+	});
+}
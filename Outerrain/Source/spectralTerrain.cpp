@@ -0,0 +1,108 @@
+#include "spectralTerrain.h"
+#include "fft.h"
+#include "randomStream.h"
+#include "taskScheduler.h"
+
+#include <cmath>
+#include <iostream>
+
+/*
+\class SpectralTerrain spectralTerrain.h
+\brief Spectral synthesis of fractal terrains : complex white noise is shaped in the frequency domain
+so that its power spectrum decreases as 1 / f^beta, and transformed back to a heightfield with an inverse FFT.
+The cost is O(n log n) whatever the range of frequencies, and the terrain is periodic, so it tiles seamlessly.
+Higher beta give smoother terrains, beta between 2 and 3 looks like natural relief.
+The noise of a row of the spectrum only depends on the seed and on the row, so terrains do not depend on scheduling.
+The real part of the inverse transform of a complex noise whose filter is symmetric is a real Gaussian field
+with the same spectrum, so the spectrum needs no Hermitian symmetry.
+*/
+
+/*
+\brief Fill the filtered spectrum of a terrain, internal function.
+\param hf terrain, giving the resolution and the cell size
+\param beta spectral exponent
+\param seed random seed
+\param anisotropy stretching of the relief along the direction, between 0 (isotropic) and 1 (excluded)
+\param angle direction of the stretching, in radians, from the x axis, along i
+\param re, im returned spectrum
+*/
+void SpectralTerrain::Spectrum(const HeightField& hf, float beta, uint64_t seed, float anisotropy, float angle, float* re, float* im)
+{
+	int nx = hf.SizeX(), ny = hf.SizeY();
+	Vector2 cell = hf.CellSize();
+
+	// Frequencies in cycles per unit, the terrain being one period : the ny rows are cell.x apart along i, the nx columns cell.y apart along j
+	float du = 1.0f / (float(ny) * cell.x);
+	float dv = 1.0f / (float(nx) * cell.y);
+	float ca = cosf(angle), sa = sinf(angle);
+	float stretch = 1.0f / (1.0f - Math::Clamp(anisotropy, 0.0f, 0.99f));
+	float exponent = -0.25f * beta;
+
+	TaskScheduler::Global().ParallelFor(0, ny, [&](int first, int last)
+	{
+		for (int i = first; i < last; i++)
+		{
+			// Uniform complex noise : the terrain sums every frequency, so it is Gaussian whatever the distribution of the noise
+			float* r = re + size_t(i) * nx;
+			float* m = im + size_t(i) * nx;
+			RandomStream random(seed, RandomSubsystem::Terrain, uint64_t(i));
+			for (int j = 0; j < nx; j++)
+			{
+				r[j] = random.Uniform(-1.0f, 1.0f);
+				m[j] = random.Uniform(-1.0f, 1.0f);
+			}
+
+			// Amplitude f^(-beta / 2) for a power spectrum in f^(-beta), the mean height is removed
+			float fu = float(i < ny / 2 ? i : i - ny) * du;
+			for (int j = 0; j < nx; j++)
+			{
+				// Anisotropy compresses wavelengths across the direction, features get longer along it
+				float fv = float(j < nx / 2 ? j : j - nx) * dv;
+				float a = (ca * fu + sa * fv) * stretch;
+				float b = -sa * fu + ca * fv;
+				float f2 = a * a + b * b;
+				float s = f2 > 0.0f ? powf(f2, exponent) : 0.0f;
+				r[j] *= s;
+				m[j] *= s;
+			}
+		}
+	});
+}
+
+/*
+\brief Generate a periodic fractal terrain.
+\param nx, ny resolution, powers of two
+\param box world box of the terrain
+\param amplitude largest absolute height, heights range in [-amplitude, amplitude]
+\param beta spectral exponent, the power of a frequency f is proportional to 1 / f^beta
+\param seed random seed
+\param anisotropy stretching of the relief along a direction, between 0 (isotropic) and 1 (excluded)
+\param angle direction of the stretching, in radians, from the x axis, along i
+*/
+HeightField SpectralTerrain::Generate(int nx, int ny, const Box2D& box, float amplitude, float beta, uint64_t seed, float anisotropy, float angle)
+{
+	HeightField hf(nx, ny, box, 0.0f);
+	FFT2D fft(nx, ny);
+	if (!fft.IsValid())
+	{
+		std::cout << "Spectral synthesis requires a power of two resolution" << std::endl;
+		return hf;
+	}
+
+	std::vector<float> im(size_t(nx) * ny);
+	float* re = hf.Data();
+	Spectrum(hf, beta, seed, anisotropy, angle, re, im.data());
+	fft.Inverse(re, im.data());
+
+	float scale = Math::Max(fabsf(hf.Min()), fabsf(hf.Max()));
+	if (scale > 0.0f)
+	{
+		float s = amplitude / scale;
+		TaskScheduler::Global().ParallelFor(0, ny, [&](int first, int last)
+		{
+			for (size_t k = size_t(first) * nx; k < size_t(last) * nx; k++)
+				re[k] *= s;
+		});
+	}
+	return hf;
+}
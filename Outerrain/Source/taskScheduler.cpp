@@ -0,0 +1,549 @@
+#include "taskScheduler.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/*
+\class TaskScheduler taskScheduler.h
+\brief Work stealing task scheduler shared by the terrain algorithms.
+Every worker thread owns a deque of tasks : it pushes and pops its own tasks at the back, and steals
+from the front of the other deques when it runs out of work. Threads which are not workers, such as the
+main thread, share an additional deque, and execute tasks while they wait instead of blocking,
+so that waiting never wastes a core and nested parallel loops cannot deadlock.
+Tasks may depend on other tasks, they are only queued once all their dependencies are done.
+Banded loops bind their tasks to given workers instead, so that a band of rows is always processed by the same thread,
+which may be pinned to a core with PinThreads().
+*/
+
+static thread_local const TaskScheduler* currentScheduler = nullptr;
+static thread_local int currentWorker = 0;
+
+/*
+\brief Constructor. Starts the worker threads.
+\param threadCount thread count including the calling thread, 0 means one per hardware thread.
+At least one worker is started, so that background tasks progress even on a single core.
+*/
+TaskScheduler::TaskScheduler(int threadCount) : queuedCount(0), waitingCount(0), stop(false)
+{
+	if (threadCount <= 0)
+		threadCount = int(std::thread::hardware_concurrency());
+	int workerCount = std::max(1, threadCount - 1);
+
+	// Deque 0 is shared by the external threads
+	for (int i = 0; i <= workerCount; i++)
+	{
+		workers.emplace_back(new Worker());
+		workers[i]->boundCount = 0;
+		workers[i]->taskCount = 0;
+		workers[i]->stealCount = 0;
+		workers[i]->busyNanoseconds = 0;
+	}
+	statisticsStart = std::chrono::steady_clock::now();
+	for (int i = 1; i <= workerCount; i++)
+		threads.emplace_back(&TaskScheduler::WorkerLoop, this, i);
+}
+
+/*
+\brief Destructor. Finishes the queued tasks, then joins the workers.
+*/
+TaskScheduler::~TaskScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stop = true;
+	}
+	sleepCondition.notify_all();
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+}
+
+/*
+\brief Worker main loop, internal function.
+*/
+void TaskScheduler::WorkerLoop(int index)
+{
+	currentScheduler = this;
+	currentWorker = index;
+	while (true)
+	{
+		Task task = Pop(index);
+		if (task)
+		{
+			Execute(task, index);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepCondition.wait(lock, [this, index] { return stop || queuedCount > 0 || workers[index]->boundCount > 0; });
+		if (stop && queuedCount == 0 && workers[index]->boundCount == 0)
+			return;
+	}
+}
+
+/*
+\brief Get the deque index of the calling thread.
+*/
+int TaskScheduler::CurrentWorker() const
+{
+	return currentScheduler == this ? currentWorker : 0;
+}
+
+/*
+\brief Queue a task whose dependencies are done, on the deque of the calling thread.
+*/
+void TaskScheduler::Schedule(const Task& task)
+{
+	Worker& worker = *workers[CurrentWorker()];
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.tasks.push_back(task);
+	}
+	queuedCount++;
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+
+	// Waiting threads may be woken instead of a worker, and leave without taking the task
+	if (waitingCount > 0)
+		sleepCondition.notify_all();
+	else
+		sleepCondition.notify_one();
+}
+
+/*
+\brief Queue a task whose dependencies are done, on a given worker which is the only one allowed to run it.
+*/
+void TaskScheduler::ScheduleOn(const Task& task, int index)
+{
+	Worker& worker = *workers[index];
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.bound.push_back(task);
+	}
+	worker.boundCount++;
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+
+	// The bound worker may not be the one notify_one() would wake
+	sleepCondition.notify_all();
+}
+
+/*
+\brief Take the oldest task bound to the worker, or else the most recent task of its deque, or steal the oldest task of another one.
+\return the task, or null if all the deques are empty
+*/
+Task TaskScheduler::Pop(int index)
+{
+	Task ret;
+	Worker& own = *workers[index];
+	if (own.boundCount > 0)
+	{
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.bound.empty())
+		{
+			ret = own.bound.front();
+			own.bound.pop_front();
+			own.boundCount--;
+			return ret;
+		}
+	}
+	int count = int(workers.size());
+	for (int k = 0; k < count && !ret; k++)
+	{
+		Worker& worker = *workers[(index + k) % count];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		if (worker.tasks.empty())
+			continue;
+		if (k == 0)
+		{
+			ret = worker.tasks.back();
+			worker.tasks.pop_back();
+		}
+		else
+		{
+			ret = worker.tasks.front();
+			worker.tasks.pop_front();
+			workers[index]->stealCount++;
+		}
+	}
+	if (ret)
+		queuedCount--;
+	return ret;
+}
+
+/*
+\brief Run a task, then release its successors and wake the threads waiting for it.
+*/
+void TaskScheduler::Execute(const Task& task, int index)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	task->function();
+	task->function = nullptr;
+	std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+	workers[index]->busyNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
+	workers[index]->taskCount++;
+
+	std::vector<Task> successors;
+	{
+		std::lock_guard<std::mutex> lock(task->mutex);
+		task->done = true;
+		successors.swap(task->successors);
+	}
+	for (size_t i = 0; i < successors.size(); i++)
+	{
+		if (--successors[i]->pendingCount == 0)
+			Schedule(successors[i]);
+	}
+	if (waitingCount > 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		sleepCondition.notify_all();
+	}
+}
+
+/*
+\brief Create a task.
+\param function function to execute
+\param dependencies tasks which must be done before the task starts
+\return task handle
+*/
+Task TaskScheduler::Submit(std::function<void()> function, const std::vector<Task>& dependencies)
+{
+	Task task = std::make_shared<TaskState>();
+	task->function = std::move(function);
+	task->pendingCount = 1;
+	task->done = false;
+	for (size_t i = 0; i < dependencies.size(); i++)
+	{
+		std::lock_guard<std::mutex> lock(dependencies[i]->mutex);
+		if (dependencies[i]->done)
+			continue;
+		task->pendingCount++;
+		dependencies[i]->successors.push_back(task);
+	}
+	if (--task->pendingCount == 0)
+		Schedule(task);
+	return task;
+}
+
+/*
+\brief Returns true if the task has been executed. Null tasks are considered done.
+*/
+bool TaskScheduler::IsDone(const Task& task) const
+{
+	return !task || task->done;
+}
+
+/*
+\brief Wait for a task, executing queued tasks in the meantime.
+*/
+void TaskScheduler::Wait(const Task& task)
+{
+	if (IsDone(task))
+		return;
+	int index = CurrentWorker();
+	waitingCount++;
+	while (!task->done)
+	{
+		Task other = Pop(index);
+		if (other)
+		{
+			Execute(other, index);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepCondition.wait(lock, [this, &task, index] { return task->done || queuedCount > 0 || workers[index]->boundCount > 0; });
+	}
+	waitingCount--;
+}
+
+/*
+\brief Wait for a set of tasks, executing queued tasks in the meantime.
+*/
+void TaskScheduler::Wait(const std::vector<Task>& tasks)
+{
+	for (size_t i = 0; i < tasks.size(); i++)
+		Wait(tasks[i]);
+}
+
+/*
+\brief Split [begin, end[ in contiguous chunks executed as tasks, and wait for all of them.
+The calling thread processes the first chunk itself.
+\param begin first index
+\param end last index, excluded
+\param body function called with a sub range [first, last[
+\param grain chunk size, 0 means about four chunks per thread
+*/
+void TaskScheduler::ParallelFor(int begin, int end, const std::function<void(int, int)>& body, int grain)
+{
+	int count = end - begin;
+	if (count <= 0)
+		return;
+	if (grain <= 0)
+		grain = std::max(1, count / (4 * ThreadCount()));
+	if (grain >= count)
+	{
+		body(begin, end);
+		return;
+	}
+
+	std::vector<Task> chunks;
+	chunks.reserve(count / grain + 1);
+	for (int first = begin + grain; first < end; first += grain)
+	{
+		int last = std::min(first + grain, end);
+		chunks.push_back(Submit([&body, first, last] { body(first, last); }));
+	}
+	body(begin, begin + grain);
+	Wait(chunks);
+}
+
+/*
+\brief Split [beginI, endI[ x [beginJ, endJ[ in blocks executed as tasks, and wait for all of them.
+\param body function called with a block [firstI, lastI[ x [firstJ, lastJ[
+\param grainI block size along i, 0 means about two blocks per thread
+\param grainJ block size along j, 0 means about two blocks per thread
+*/
+void TaskScheduler::ParallelFor2D(int beginI, int endI, int beginJ, int endJ, const std::function<void(int, int, int, int)>& body, int grainI, int grainJ)
+{
+	int countI = endI - beginI;
+	int countJ = endJ - beginJ;
+	if (countI <= 0 || countJ <= 0)
+		return;
+	if (grainI <= 0)
+		grainI = std::max(1, countI / (2 * ThreadCount()));
+	if (grainJ <= 0)
+		grainJ = std::max(1, countJ / (2 * ThreadCount()));
+	int blocksI = (countI + grainI - 1) / grainI;
+	int blocksJ = (countJ + grainJ - 1) / grainJ;
+	ParallelFor(0, blocksI * blocksJ, [&](int first, int last)
+	{
+		for (int b = first; b < last; b++)
+		{
+			int i0 = beginI + (b / blocksJ) * grainI;
+			int j0 = beginJ + (b % blocksJ) * grainJ;
+			body(i0, std::min(i0 + grainI, endI), j0, std::min(j0 + grainJ, endJ));
+		}
+	}, 1);
+}
+
+/*
+\brief Split [begin, end[ in one contiguous band per thread, and wait for all of them.
+Band k is always processed by worker k, and band 0 by the calling thread, so that a loop over the rows of a field
+touches the same rows from the same thread at every call. Fields whose pages were first touched by a banded loop,
+see FieldAllocation, then have every band in the memory of the NUMA node of the thread processing it, all the more
+with pinned threads, see PinThreads(). Bands are not balanced by work stealing : the work per index should be uniform.
+Band 0 follows the calling thread : banded loops over a field must be called from the thread which allocated it,
+usually the thread owning the simulation, such as the main thread or the thread of an ErosionWorker.
+Called from a task of this scheduler, the calling worker would process band 0 and its own band, so the loop
+runs as a ParallelFor() instead, without any placement.
+\param begin first index
+\param end last index, excluded
+\param body function called with a band [first, last[
+*/
+void TaskScheduler::ParallelBands(int begin, int end, const std::function<void(int, int)>& body)
+{
+	int count = end - begin;
+	if (count <= 0)
+		return;
+	if (currentScheduler == this)
+	{
+		ParallelFor(begin, end, body);
+		return;
+	}
+	int bands = std::min(ThreadCount(), count);
+	std::vector<Task> tasks;
+	tasks.reserve(bands);
+	for (int k = 1; k < bands; k++)
+	{
+		int first = begin + int((long long)count * k / bands);
+		int last = begin + int((long long)count * (k + 1) / bands);
+		Task task = std::make_shared<TaskState>();
+		task->function = [&body, first, last] { body(first, last); };
+		task->pendingCount = 0;
+		task->done = false;
+		ScheduleOn(task, k);
+		tasks.push_back(task);
+	}
+	body(begin, begin + count / bands);
+	Wait(tasks);
+}
+
+/*
+\brief Pin every thread to its own core : the calling thread to the first core the process may run on, worker k to the k-th one.
+Cores are reused when there are more threads than cores. Called from the thread which runs the banded loops, usually the main thread,
+whose cores may be saved beforehand and restored afterwards, see CallingThreadCores().
+Threads are pinned with pthread_setaffinity_np on Linux and SetThreadAffinityMask on Windows.
+\return false if a thread could not be pinned, or if the system is not supported
+*/
+bool TaskScheduler::PinThreads()
+{
+#if defined(__linux__)
+	cpu_set_t allowed;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+		return false;
+	std::vector<int> cores;
+	for (int c = 0; c < CPU_SETSIZE; c++)
+	{
+		if (CPU_ISSET(c, &allowed))
+			cores.push_back(c);
+	}
+	if (cores.empty())
+		return false;
+	bool ret = true;
+	for (int k = 0; k < ThreadCount(); k++)
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cores[k % cores.size()], &set);
+		pthread_t thread = k == 0 ? pthread_self() : threads[k - 1].native_handle();
+		if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0)
+			ret = false;
+	}
+	return ret;
+#elif defined(_WIN32)
+	DWORD_PTR process, system;
+	if (!GetProcessAffinityMask(GetCurrentProcess(), &process, &system))
+		return false;
+	std::vector<int> cores;
+	for (int c = 0; c < int(sizeof(DWORD_PTR) * 8); c++)
+	{
+		if (process & (DWORD_PTR(1) << c))
+			cores.push_back(c);
+	}
+	if (cores.empty())
+		return false;
+	bool ret = true;
+	for (int k = 0; k < ThreadCount(); k++)
+	{
+		HANDLE thread = k == 0 ? GetCurrentThread() : HANDLE(threads[k - 1].native_handle());
+		if (SetThreadAffinityMask(thread, DWORD_PTR(1) << cores[k % cores.size()]) == 0)
+			ret = false;
+	}
+	return ret;
+#else
+	return false;
+#endif
+}
+
+/*
+\brief Get the cores the calling thread may run on, to restore them with SetCallingThreadCores() after PinThreads().
+\return core indices, empty if they could not be read or if the system is not supported
+*/
+std::vector<int> TaskScheduler::CallingThreadCores()
+{
+	std::vector<int> cores;
+#if defined(__linux__)
+	cpu_set_t allowed;
+	if (pthread_getaffinity_np(pthread_self(), sizeof(allowed), &allowed) != 0)
+		return cores;
+	for (int c = 0; c < CPU_SETSIZE; c++)
+	{
+		if (CPU_ISSET(c, &allowed))
+			cores.push_back(c);
+	}
+#elif defined(_WIN32)
+	// Windows only reads the mask of a thread when changing it
+	DWORD_PTR process, system;
+	if (!GetProcessAffinityMask(GetCurrentProcess(), &process, &system))
+		return cores;
+	DWORD_PTR mask = SetThreadAffinityMask(GetCurrentThread(), process);
+	if (mask == 0)
+		return cores;
+	SetThreadAffinityMask(GetCurrentThread(), mask);
+	for (int c = 0; c < int(sizeof(DWORD_PTR) * 8); c++)
+	{
+		if (mask & (DWORD_PTR(1) << c))
+			cores.push_back(c);
+	}
+#endif
+	return cores;
+}
+
+/*
+\brief Restrict the calling thread to a set of cores, see CallingThreadCores().
+\param cores core indices
+\return false if the set is empty, if the thread could not be moved, or if the system is not supported
+*/
+bool TaskScheduler::SetCallingThreadCores(const std::vector<int>& cores)
+{
+	if (cores.empty())
+		return false;
+#if defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int c : cores)
+		CPU_SET(c, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+	DWORD_PTR mask = 0;
+	for (int c : cores)
+		mask |= DWORD_PTR(1) << c;
+	return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#else
+	return false;
+#endif
+}
+
+/*
+\brief Get the thread count, including the calling thread.
+*/
+int TaskScheduler::ThreadCount() const
+{
+	return int(threads.size()) + 1;
+}
+
+/*
+\brief Get the statistics of a worker since the last reset. Worker 0 gathers the external threads.
+*/
+WorkerStatistics TaskScheduler::Statistics(int worker) const
+{
+	WorkerStatistics ret;
+	ret.taskCount = workers[worker]->taskCount;
+	ret.stealCount = workers[worker]->stealCount;
+	ret.busySeconds = workers[worker]->busyNanoseconds * 1.0e-9;
+	return ret;
+}
+
+/*
+\brief Get the fraction of time spent executing tasks by a worker since the last reset.
+*/
+double TaskScheduler::Utilization(int worker) const
+{
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - statisticsStart).count();
+	return elapsed > 0.0 ? Statistics(worker).busySeconds / elapsed : 0.0;
+}
+
+/*
+\brief Reset the worker statistics.
+*/
+void TaskScheduler::ResetStatistics()
+{
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i]->taskCount = 0;
+		workers[i]->stealCount = 0;
+		workers[i]->busyNanoseconds = 0;
+	}
+	statisticsStart = std::chrono::steady_clock::now();
+}
+
+/*
+\brief Get the scheduler shared by all the terrain subsystems, created on first use.
+*/
+TaskScheduler& TaskScheduler::Global()
+{
+	static TaskScheduler scheduler;
+	return scheduler;
+}
@@ -0,0 +1,363 @@
+#include "terrainGraph.h"
+
+#include <algorithm>
+#include <functional>
+
+/*
+\class TerrainGraph terrainGraph.h
+\brief Lazy, tile based evaluation of a graph of terrain nodes.
+The graph covers an infinite grid of samples : sample (i, j) lies at origin + (i, j) * cellSize in the (x, z) plane,
+and tile t holds the tileCells x tileCells samples starting at t * tileCells. A tile of a node is only computed when
+it is requested, directly or by a downstream node, and is stored in a LRU cache keyed by the content hash of the
+node and the tile coordinate. Since the hash of a node covers its parameters and its inputs, changing a node only
+invalidates its own tiles and the tiles of its downstream nodes, and restoring a parameter finds the old tiles again.
+The graph has no dependency on the renderer, so it can be driven headless :
+	TerrainGraph graph(Vector2(0), 8.0f);
+	FractalNode* mountains = graph.Add(new FractalNode(NoisePerlin, 0, MusgraveHybridMultifractal, 100.0f, 0.002f, 8));
+	ErosionNode* eroded = graph.Add(new ErosionNode(mountains, ErosionThermal, 50));
+	HeightField hf = graph.Evaluate(eroded, Box2D(Vector2(-1024), Vector2(1024)));
+*/
+
+/*
+\brief Compute the content hash of a node, including the hashes of its inputs.
+*/
+unsigned long long TerrainNode::Key() const
+{
+	ContentHash hash;
+	HashParameters(hash);
+	for (size_t i = 0; i < inputs.size(); i++)
+		hash.Add(inputs[i] != nullptr ? inputs[i]->Key() : 0ull);
+	return hash.Value();
+}
+
+/*
+\brief Floor division, valid for negative sample indices.
+*/
+static inline int FloorDiv(int a, int b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+/*
+\brief Constructor
+\param origin world position of the sample (0, 0)
+\param cellSize distance between two samples in world coordinates
+\param tileCells sample count along a tile edge
+\param maxTileCount maximum number of tiles in the cache, all nodes included
+*/
+TerrainGraph::TerrainGraph(const Vector2& origin, float cellSize, int tileCells, int maxTileCount)
+	: origin(origin), cellSize(cellSize), tileCells(tileCells), maxTileCount(size_t(maxTileCount)), reservedTileCount(0), computedTileCount(0), cacheHitCount(0)
+{
+}
+
+/*
+\brief Destructor. Deletes the nodes of the graph.
+*/
+TerrainGraph::~TerrainGraph()
+{
+	for (size_t i = 0; i < nodes.size(); i++)
+		delete nodes[i];
+}
+
+/*
+\brief Get the sample count along a tile edge.
+*/
+int TerrainGraph::TileCells() const
+{
+	return tileCells;
+}
+
+/*
+\brief Get the distance between two samples in world coordinates.
+*/
+float TerrainGraph::CellSize() const
+{
+	return cellSize;
+}
+
+/*
+\brief Get the world position of a sample in the (x, z) plane.
+*/
+Vector2 TerrainGraph::SamplePosition(const Vector2i& sample) const
+{
+	return origin + Vector2(float(sample.x), float(sample.y)) * cellSize;
+}
+
+/*
+\brief Hash key of a tile of a node.
+*/
+unsigned long long TerrainGraph::TileKey(unsigned long long nodeKey, const Vector2i& t)
+{
+	ContentHash hash;
+	hash.Add(nodeKey);
+	hash.Add(t.x);
+	hash.Add(t.y);
+	return hash.Value();
+}
+
+/*
+\brief Get the coordinates of the tile containing a sample.
+*/
+Vector2i TerrainGraph::TileCoord(const Vector2i& sample) const
+{
+	return Vector2i(FloorDiv(sample.x, tileCells), FloorDiv(sample.y, tileCells));
+}
+
+/*
+\brief Compute the world box of a square block of samples, such that ValueField::Vertex() returns the sample positions.
+*/
+Box2D TerrainGraph::SampleBox(const Vector2i& firstSample, int n) const
+{
+	Vector2 a = SamplePosition(firstSample);
+	return Box2D(a, a + Vector2(float(n - 1) * cellSize));
+}
+
+/*
+\brief Look a tile up in the cache, and mark it as recently used.
+\return the tile, or null if it is not cached
+*/
+std::shared_ptr<const HeightField> TerrainGraph::Find(unsigned long long key)
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	auto it = cache.find(key);
+	if (it == cache.end())
+		return nullptr;
+	lru.splice(lru.begin(), lru, it->second.lruPosition);
+	return it->second.field;
+}
+
+/*
+\brief Store a computed tile, and release the least recently used tiles beyond maxTileCount.
+Two threads may compute the same tile concurrently : the first stored tile is kept and returned to both.
+*/
+std::shared_ptr<const HeightField> TerrainGraph::Insert(unsigned long long key, const std::shared_ptr<const HeightField>& field)
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	auto it = cache.find(key);
+	if (it != cache.end())
+		return it->second.field;
+
+	CacheEntry& entry = cache[key];
+	entry.field = field;
+	lru.push_front(key);
+	entry.lruPosition = lru.begin();
+	Evict();
+	return field;
+}
+
+/*
+\brief Release the least recently used tiles beyond maxTileCount and the tiles reserved by the running evaluations,
+internal function. The cache mutex must be locked.
+*/
+void TerrainGraph::Evict()
+{
+	while (cache.size() > maxTileCount + reservedTileCount)
+	{
+		cache.erase(lru.back());
+		lru.pop_back();
+	}
+}
+
+/*
+\brief Get a tile of a node, computing it and the missing tiles of its inputs if needed.
+\param node graph node
+\param t tile coordinates
+*/
+std::shared_ptr<const HeightField> TerrainGraph::Tile(const TerrainNode* node, const Vector2i& t)
+{
+	unsigned long long key = TileKey(node->Key(), t);
+	std::shared_ptr<const HeightField> ret = Find(key);
+	if (ret)
+	{
+		cacheHitCount++;
+		return ret;
+	}
+
+	Vector2i first = Vector2i(t.x * tileCells, t.y * tileCells);
+	std::shared_ptr<HeightField> field = std::make_shared<HeightField>(tileCells, tileCells, SampleBox(first, tileCells));
+	node->Evaluate(*this, *field, first);
+	computedTileCount++;
+	return Insert(key, field);
+}
+
+/*
+\brief Get a square block of samples of a node, gathered from its tiles. Missing tiles are computed.
+A block matching exactly one tile is the cached tile itself.
+\param node graph node
+\param firstSample global index of the first sample of the block
+\param n sample count along the block edge
+*/
+std::shared_ptr<const HeightField> TerrainGraph::Region(const TerrainNode* node, const Vector2i& firstSample, int n)
+{
+	Vector2i a = TileCoord(firstSample);
+	Vector2i b = TileCoord(Vector2i(firstSample.x + n - 1, firstSample.y + n - 1));
+	if (n == tileCells && firstSample.x == a.x * tileCells && firstSample.y == a.y * tileCells)
+		return Tile(node, a);
+
+	std::shared_ptr<HeightField> ret = std::make_shared<HeightField>(n, n, SampleBox(firstSample, n));
+	for (int ti = a.x; ti <= b.x; ti++)
+	{
+		for (int tj = a.y; tj <= b.y; tj++)
+		{
+			std::shared_ptr<const HeightField> tile = Tile(node, Vector2i(ti, tj));
+
+			// Overlap of the tile and the block, in global sample indices
+			int i0 = std::max(firstSample.x, ti * tileCells), i1 = std::min(firstSample.x + n, (ti + 1) * tileCells);
+			int j0 = std::max(firstSample.y, tj * tileCells), j1 = std::min(firstSample.y + n, (tj + 1) * tileCells);
+			for (int i = i0; i < i1; i++)
+			{
+				const float* src = tile->Data() + (i - ti * tileCells) * tileCells + (j0 - tj * tileCells);
+				float* dst = ret->Data() + (i - firstSample.x) * n + (j0 - firstSample.y);
+				std::copy(src, src + (j1 - j0), dst);
+			}
+		}
+	}
+	return ret;
+}
+
+/*
+\brief Evaluate a node over a square block of samples, computing the missing tiles in parallel.
+Nodes are processed from upstream to downstream : all the tiles a node needs, halos of its consumers
+included, are computed together by the task scheduler once its inputs are cached, so that no tile is
+computed twice and every node level runs fully in parallel.
+\param node graph node
+\param firstSample global index of the first sample of the block
+\param n sample count along the block edge
+*/
+HeightField TerrainGraph::Evaluate(const TerrainNode* node, const Vector2i& firstSample, int n)
+{
+	// Upstream nodes in topological order
+	std::vector<const TerrainNode*> order;
+	std::function<void(const TerrainNode*)> visit = [&](const TerrainNode* current)
+	{
+		if (current == nullptr || std::find(order.begin(), order.end(), current) != order.end())
+			return;
+		for (size_t i = 0; i < current->Inputs().size(); i++)
+			visit(current->Inputs()[i]);
+		order.push_back(current);
+	};
+	visit(node);
+
+	// Sample rectangles needed for every node, propagated from downstream to upstream
+	struct Rectangle
+	{
+		Vector2i a, b;
+		bool used;
+	};
+	std::vector<Rectangle> needed(order.size());
+	for (size_t k = 0; k < needed.size(); k++)
+		needed[k].used = false;
+	needed.back().a = firstSample;
+	needed.back().b = Vector2i(firstSample.x + n - 1, firstSample.y + n - 1);
+	needed.back().used = true;
+	size_t tileCount = 0;
+	for (int k = int(order.size()) - 1; k >= 0; k--)
+	{
+		if (needed[k].used == false)
+			continue;
+		Vector2i ta = TileCoord(needed[k].a), tb = TileCoord(needed[k].b);
+		tileCount += size_t((tb.x - ta.x + 1) * (tb.y - ta.y + 1));
+
+		int halo = order[k]->Halo();
+		Vector2i a = Vector2i(ta.x * tileCells - halo, ta.y * tileCells - halo);
+		Vector2i b = Vector2i((tb.x + 1) * tileCells - 1 + halo, (tb.y + 1) * tileCells - 1 + halo);
+		for (size_t i = 0; i < order[k]->Inputs().size(); i++)
+		{
+			Rectangle& r = needed[std::find(order.begin(), order.end(), order[k]->Inputs()[i]) - order.begin()];
+			if (r.used == false)
+			{
+				r.a = a;
+				r.b = b;
+				r.used = true;
+				continue;
+			}
+			r.a = Vector2i(std::min(r.a.x, a.x), std::min(r.a.y, a.y));
+			r.b = Vector2i(std::max(r.b.x, b.x), std::max(r.b.y, b.y));
+		}
+	}
+
+	// Keep all the tiles of the evaluation cached until the end, the cache shrinks back to maxTileCount afterwards
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		reservedTileCount += tileCount;
+	}
+
+	for (size_t k = 0; k < order.size(); k++)
+	{
+		if (needed[k].used == false)
+			continue;
+		Vector2i ta = TileCoord(needed[k].a), tb = TileCoord(needed[k].b);
+		int countJ = tb.y - ta.y + 1;
+		const TerrainNode* current = order[k];
+		TaskScheduler::Global().ParallelFor(0, (tb.x - ta.x + 1) * countJ, [&](int first, int last)
+		{
+			for (int t = first; t < last; t++)
+				Tile(current, Vector2i(ta.x + t / countJ, ta.y + t % countJ));
+		}, 1);
+	}
+
+	std::shared_ptr<const HeightField> region = Region(node, firstSample, n);
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		reservedTileCount -= tileCount;
+		Evict();
+	}
+	return HeightField(*region);
+}
+
+/*
+\brief Evaluate a node over the samples inside a world box. Fields are square : the block is sized
+after the largest extent of the box.
+*/
+HeightField TerrainGraph::Evaluate(const TerrainNode* node, const Box2D& box)
+{
+	Vector2 a = (box.Vertex(0) - origin) / cellSize;
+	Vector2 b = (box.Vertex(1) - origin) / cellSize;
+	Vector2i first = Vector2i(int(ceilf(a.x - 1.0e-3f)), int(ceilf(a.y - 1.0e-3f)));
+	Vector2i last = Vector2i(int(floorf(b.x + 1.0e-3f)), int(floorf(b.y + 1.0e-3f)));
+	return Evaluate(node, first, Math::Max(Math::Max(last.x - first.x, last.y - first.y) + 1, 2));
+}
+
+/*
+\brief Release all the cached tiles.
+*/
+void TerrainGraph::ClearCache()
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	cache.clear();
+	lru.clear();
+}
+
+/*
+\brief Get the number of cached tiles.
+*/
+size_t TerrainGraph::CachedTileCount()
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	return cache.size();
+}
+
+/*
+\brief Get the number of tiles computed since the last reset.
+*/
+int TerrainGraph::ComputedTileCount() const
+{
+	return computedTileCount;
+}
+
+/*
+\brief Get the number of tile requests served by the cache since the last reset.
+*/
+int TerrainGraph::CacheHitCount() const
+{
+	return cacheHitCount;
+}
+
+/*
+\brief Reset the computed tile and cache hit counters.
+*/
+void TerrainGraph::ResetStatistics()
+{
+	computedTileCount = 0;
+	cacheHitCount = 0;
+}
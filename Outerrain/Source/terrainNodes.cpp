@@ -0,0 +1,430 @@
+#include "terrainNodes.h"
+#include "heightmapImporter.h"
+#include "fieldExpression.h"
+#include "landscapeEvolution.h"
+
+/*
+\brief Copy the samples of a region without its margin into a tile.
+*/
+static void CopyCenter(const ScalarField2D& region, int margin, HeightField& tile)
+{
+	int n = tile.SizeX();
+	for (int i = 0; i < n; i++)
+	{
+		const float* src = region.Data() + (i + margin) * region.SizeX() + margin;
+		std::copy(src, src + n, tile.Data() + i * n);
+	}
+}
+
+/*
+\brief Fill a tile with a function of the world positions of its samples, one row at a time.
+*/
+template<typename Function>
+static void EvaluateRows(const TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample, const Vector2& offset, const Function& function)
+{
+	int n = tile.SizeX();
+	std::vector<Vector2> row(n);
+	for (int i = 0; i < n; i++)
+	{
+		for (int j = 0; j < n; j++)
+			row[j] = graph.SamplePosition(Vector2i(firstSample.x + i, firstSample.y + j)) + offset;
+		function(row.data(), tile.Data() + i * n, n);
+	}
+}
+
+/*
+\class NoiseNode terrainNodes.h
+\brief Single octave of a noise, evaluated at the world positions of the samples.
+*/
+
+/*
+\brief Constructor
+\param type noise type
+\param seed noise seed
+\param amplitude noise amplitude
+\param frequency noise frequency
+\param offset translation of the noise
+*/
+NoiseNode::NoiseNode(NoiseType type, unsigned int seed, float amplitude, float frequency, const Vector2& offset)
+	: noiseType(type), seed(seed), amplitude(amplitude), frequency(frequency), offset(offset)
+{
+}
+
+void NoiseNode::HashParameters(ContentHash& hash) const
+{
+	hash.Add(std::string("Noise"));
+	hash.Add(int(noiseType));
+	hash.Add(int(seed));
+	hash.Add(amplitude);
+	hash.Add(frequency);
+	hash.Add(offset);
+}
+
+void NoiseNode::Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const
+{
+	Noise* noise = CreateNoise(noiseType, seed);
+	EvaluateRows(graph, tile, firstSample, offset, [&](Vector2* points, float* values, int count)
+	{
+		for (int k = 0; k < count; k++)
+			points[k] = points[k] * frequency;
+		noise->GetValues(points, values, count);
+		for (int k = 0; k < count; k++)
+			values[k] *= amplitude;
+	});
+	delete noise;
+}
+
+/*
+\brief Create a noise, to be deleted by the caller.
+*/
+Noise* NoiseNode::CreateNoise(NoiseType type, unsigned int seed)
+{
+	if (type == NoiseSimplex)
+		return new SimplexNoise(seed);
+	else if (type == NoiseValue)
+		return new ValueNoise(seed);
+	else if (type == NoiseCellular)
+		return new CellularNoise(seed);
+	return new PerlinNoise(seed);
+}
+
+/*
+\class FractalNode terrainNodes.h
+\brief Fractal noise, with the same amplitude mapping as the noise heightfields.
+*/
+
+/*
+\brief Constructor
+\param noise noise type
+\param seed noise seed
+\param type fractal type. See enum.
+\param amplitude noise amplitude
+\param frequency noise frequency
+\param octaves octave count
+\param offset translation of the noise
+*/
+FractalNode::FractalNode(NoiseType noise, unsigned int seed, FractalType type, float amplitude, float frequency, int octaves, const Vector2& offset)
+	: noiseType(noise), seed(seed), fractalType(type), amplitude(amplitude), frequency(frequency), octaves(octaves), offset(offset)
+{
+}
+
+void FractalNode::HashParameters(ContentHash& hash) const
+{
+	hash.Add(std::string("Fractal"));
+	hash.Add(int(noiseType));
+	hash.Add(int(seed));
+	hash.Add(int(fractalType));
+	hash.Add(amplitude);
+	hash.Add(frequency);
+	hash.Add(octaves);
+	hash.Add(offset);
+}
+
+void FractalNode::Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const
+{
+	Noise* noise = NoiseNode::CreateNoise(noiseType, seed);
+	EvaluateRows(graph, tile, firstSample, offset, [&](Vector2* points, float* values, int count)
+	{
+		Fractal::Evaluate(*noise, fractalType, points, values, count, amplitude, frequency, octaves);
+	});
+	delete noise;
+}
+
+/*
+\class ImageNode terrainNodes.h
+\brief Heightmap image stretched over a world box, and clamped outside of it.
+The image is loaded once, and its content is part of the hash of the node, so that reloading
+a modified file recomputes the downstream tiles.
+*/
+
+/*
+\brief Constructor
+\param filePath heightmap file, see HeightmapImporter
+\param blackAltitude altitude of black pixels
+\param whiteAltitude altitude of white pixels
+\param box world box covered by the image
+*/
+ImageNode::ImageNode(const std::string& filePath, float blackAltitude, float whiteAltitude, const Box2D& box)
+	: blackAltitude(blackAltitude), whiteAltitude(whiteAltitude), box(box)
+{
+	Load(filePath);
+}
+
+/*
+\brief Load the heightmap. An unreadable file gives a flat image.
+\return false if the file could not be read
+*/
+bool ImageNode::Load(const std::string& filePath)
+{
+	this->filePath = filePath;
+	bool ret = HeightmapImporter::Load(filePath, image);
+	if (ret == false)
+		image = ValueField<float>(2, 2, Box2D(), 0.0f);
+	image.SetBox(Box2D(Vector2(0), Vector2(1)));
+	return ret;
+}
+
+void ImageNode::HashParameters(ContentHash& hash) const
+{
+	hash.Add(std::string("Image"));
+	hash.Add(filePath);
+	hash.Add(image.SizeX());
+	hash.Add(image.SizeY());
+	hash.Add(image.Data(), sizeof(float) * image.SizeX() * image.SizeY());
+	hash.Add(blackAltitude);
+	hash.Add(whiteAltitude);
+	hash.Add(box);
+}
+
+void ImageNode::Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const
+{
+	BilinearSampler<float> sampler(image);
+	Vector2 a = box.Vertex(0);
+	Vector2 d = box.Vertex(1) - a;
+	EvaluateRows(graph, tile, firstSample, Vector2(0), [&](Vector2* points, float* values, int count)
+	{
+		for (int k = 0; k < count; k++)
+			points[k] = Vector2((points[k].x - a.x) / d.x, (points[k].y - a.y) / d.y);
+		sampler.Sample(points, values, count);
+		for (int k = 0; k < count; k++)
+			values[k] = blackAltitude + (whiteAltitude - blackAltitude) * values[k];
+	});
+}
+
+/*
+\class ErosionNode terrainNodes.h
+\brief Erosion of the input terrain, computed for every tile on the tile extended by a margin.
+A thermal step is two stencil passes, the choice of the targets and the transfers to the neighbours targeting a cell,
+so it spreads changes by two cells : tiles are identical to a whole terrain erosion as long as the margin is at least
+twice the step count. Hydraulic erosion carries water and sediment along whole rows in scan order, and stream power
+erosion along whole drainage paths : neither is local, their tiles are an approximation, which improves with the margin.
+*/
+
+/*
+\brief Constructor
+\param input eroded node
+\param type erosion type, see ErosionWorker
+\param steps erosion step count
+\param margin sample margin around the tiles, -1 selects twice the step count for thermal erosion, 64 samples otherwise
+*/
+ErosionNode::ErosionNode(const TerrainNode* input, ErosionType type, int steps, int margin) : erosionType(type), steps(steps), margin(margin)
+{
+	inputs.push_back(input);
+}
+
+void ErosionNode::HashParameters(ContentHash& hash) const
+{
+	hash.Add(std::string("Erosion"));
+	hash.Add(int(erosionType));
+	hash.Add(steps);
+	hash.Add(Halo());
+}
+
+int ErosionNode::Halo() const
+{
+	if (margin >= 0)
+		return margin;
+	return erosionType == ErosionThermal ? 2 * steps : 64;
+}
+
+void ErosionNode::Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const
+{
+	int m = Halo();
+	HeightField region = *graph.Region(inputs[0], Vector2i(firstSample.x - m, firstSample.y - m), tile.SizeX() + 2 * m);
+	if (erosionType == ErosionThermal)
+		region.ThermalWeatheringUntilStable(1.0f, 0.6f, steps);
+	else if (erosionType == ErosionHydraulic)
+	{
+		for (int k = 0; k < steps; k++)
+			region.HydraulicErosion();
+	}
+	else if (erosionType == ErosionStreamPower)
+	{
+		LandscapeEvolution evolution(region);
+		evolution.FillDepressions();
+		for (int k = 0; k < steps; k++)
+			evolution.Step(1.0e4f);
+	}
+	CopyCenter(region, m, tile);
+}
+
+/*
+\class BlendNode terrainNodes.h
+\brief Combination of two inputs a and b :
+a + w b, a - w b, a b, min(a, b), max(a, b), or lerp(a, b, w) where w is the weight, multiplied by the mask if any.
+*/
+
+/*
+\brief Constructor
+\param a first input
+\param b second input
+\param operation blend operator. See enum.
+\param weight weight of b
+\param mask optional mask multiplied with the weight
+*/
+BlendNode::BlendNode(const TerrainNode* a, const TerrainNode* b, BlendOperation operation, float weight, const TerrainNode* mask) : operation(operation), weight(weight)
+{
+	inputs.push_back(a);
+	inputs.push_back(b);
+	if (mask != nullptr)
+		inputs.push_back(mask);
+}
+
+void BlendNode::HashParameters(ContentHash& hash) const
+{
+	hash.Add(std::string("Blend"));
+	hash.Add(int(operation));
+	hash.Add(weight);
+}
+
+void BlendNode::Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const
+{
+	int n = tile.SizeX();
+	std::shared_ptr<const HeightField> a = graph.Region(inputs[0], firstSample, n);
+	std::shared_ptr<const HeightField> b = graph.Region(inputs[1], firstSample, n);
+	std::shared_ptr<const HeightField> mask = inputs.size() > 2 ? graph.Region(inputs[2], firstSample, n) : nullptr;
+	const HeightField& A = *a;
+	const HeightField& B = *b;
+	float* out = tile.Data();
+	if (operation == BlendMin)
+		FieldAlgebra::Evaluate(select(A < B, A, B), out, n * n);
+	else if (operation == BlendMax)
+		FieldAlgebra::Evaluate(select(A > B, A, B), out, n * n);
+	else if (operation == BlendMultiply)
+		FieldAlgebra::Evaluate(A * B, out, n * n);
+	else if (mask)
+	{
+		const HeightField& M = *mask;
+		if (operation == BlendAdd)
+			FieldAlgebra::Evaluate(A + B * M * weight, out, n * n);
+		else if (operation == BlendSubtract)
+			FieldAlgebra::Evaluate(A - B * M * weight, out, n * n);
+		else
+			FieldAlgebra::Evaluate(lerp(A, B, M * weight), out, n * n);
+	}
+	else
+	{
+		if (operation == BlendAdd)
+			FieldAlgebra::Evaluate(A + B * weight, out, n * n);
+		else if (operation == BlendSubtract)
+			FieldAlgebra::Evaluate(A - B * weight, out, n * n);
+		else
+			FieldAlgebra::Evaluate(lerp(A, B, weight), out, n * n);
+	}
+}
+
+/*
+\class MaskNode terrainNodes.h
+\brief Mask equal to 1 for input values in [low, high], decreasing linearly to 0 over the falloff distance.
+*/
+
+/*
+\brief Constructor
+\param input masked node
+\param low lower bound of the range
+\param high upper bound of the range
+\param falloff width of the transition outside of the range, 0 gives a binary mask
+*/
+MaskNode::MaskNode(const TerrainNode* input, float low, float high, float falloff) : low(low), high(high), falloff(falloff)
+{
+	inputs.push_back(input);
+}
+
+void MaskNode::HashParameters(ContentHash& hash) const
+{
+	hash.Add(std::string("Mask"));
+	hash.Add(low);
+	hash.Add(high);
+	hash.Add(falloff);
+}
+
+void MaskNode::Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const
+{
+	int n = tile.SizeX();
+	std::shared_ptr<const HeightField> input = graph.Region(inputs[0], firstSample, n);
+	const HeightField& X = *input;
+	if (falloff <= 0.0f)
+	{
+		FieldAlgebra::Evaluate((1.0f - (X < low)) * (1.0f - (X > high)), tile.Data(), n * n);
+		return;
+	}
+	float invFalloff = 1.0f / falloff;
+	FieldAlgebra::Evaluate(clamp(select(X < low, (X - (low - falloff)) * invFalloff, ((high + falloff) - X) * invFalloff), 0.0f, 1.0f), tile.Data(), n * n);
+}
+
+/*
+\class RemapNode terrainNodes.h
+\brief Linear mapping of [inputMin, inputMax] onto [outputMin, outputMax].
+*/
+
+/*
+\brief Constructor
+\param input remapped node
+\param inputMin, inputMax input range
+\param outputMin, outputMax output range
+*/
+RemapNode::RemapNode(const TerrainNode* input, float inputMin, float inputMax, float outputMin, float outputMax)
+	: inputMin(inputMin), inputMax(inputMax), outputMin(outputMin), outputMax(outputMax)
+{
+	inputs.push_back(input);
+}
+
+void RemapNode::HashParameters(ContentHash& hash) const
+{
+	hash.Add(std::string("Remap"));
+	hash.Add(inputMin);
+	hash.Add(inputMax);
+	hash.Add(outputMin);
+	hash.Add(outputMax);
+}
+
+void RemapNode::Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const
+{
+	int n = tile.SizeX();
+	std::shared_ptr<const HeightField> input = graph.Region(inputs[0], firstSample, n);
+	const HeightField& X = *input;
+	FieldAlgebra::Evaluate(lerp(outputMin, outputMax, (X - inputMin) / (inputMax - inputMin)), tile.Data(), n * n);
+}
+
+/*
+\class DerivedNode terrainNodes.h
+\brief Field derived from the input heightfield. The slope only needs the direct neighbours of a sample,
+drainage based fields are computed on the tile extended by a margin, and are approximate near the tile borders.
+*/
+
+/*
+\brief Constructor
+\param input heightfield node
+\param type derived field. See enum.
+\param margin sample margin around the tiles for drainage based fields
+*/
+DerivedNode::DerivedNode(const TerrainNode* input, DerivedType type, int margin) : derivedType(type), margin(margin)
+{
+	inputs.push_back(input);
+}
+
+void DerivedNode::HashParameters(ContentHash& hash) const
+{
+	hash.Add(std::string("Derived"));
+	hash.Add(int(derivedType));
+	hash.Add(Halo());
+}
+
+int DerivedNode::Halo() const
+{
+	return derivedType == DerivedSlope ? 1 : margin;
+}
+
+void DerivedNode::Evaluate(TerrainGraph& graph, HeightField& tile, const Vector2i& firstSample) const
+{
+	int m = Halo();
+	std::shared_ptr<const HeightField> region = graph.Region(inputs[0], Vector2i(firstSample.x - m, firstSample.y - m), tile.SizeX() + 2 * m);
+	if (derivedType == DerivedSlope)
+		CopyCenter(region->Slope(), m, tile);
+	else if (derivedType == DerivedDrainageArea)
+		CopyCenter(region->DrainageArea(), m, tile);
+	else if (derivedType == DerivedWetness)
+		CopyCenter(region->Wetness(), m, tile);
+	else if (derivedType == DerivedStreamPower)
+		CopyCenter(region->StreamPower(), m, tile);
+}
@@ -0,0 +1,251 @@
+#include "terrainStreamer.h"
+
+/*
+\class TerrainStreamer terrainStreamer.h
+\brief Generates an infinite noise terrain as square HeightField tiles, on demand and in the background.
+Tiles are aligned on a global sample grid : tile t covers samples [t * tileCells, (t + 1) * tileCells],
+so neighbour tiles share their border samples and compute them at the exact same positions (no seams).
+Generated tiles are kept in a LRU cache, and the fields of evicted tiles are recycled for new ones.
+*/
+
+/*
+\brief Floor division, valid for negative tile coordinates.
+*/
+static inline int FloorDiv(int a, int b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+/*
+\brief Returns true if the tile has been generated.
+*/
+bool TerrainTile::IsReady() const
+{
+	return TaskScheduler::Global().IsDone(job);
+}
+
+/*
+\brief Constructor
+\param n noise used for the terrain
+\param amplitude noise amplitude
+\param freq noise frequency
+\param oct noise octave count
+\param type fractal type. See enum.
+\param origin world position of the sample (0, 0)
+\param cellSize distance between two samples in world coordinates
+\param tileCells cell count along a tile edge, tiles hold tileCells + 1 samples
+\param viewRadius tile radius kept around the camera
+\param prefetchRadius additional tile ring generated ahead of time
+\param maxTileCount maximum number of tiles in the cache
+*/
+TerrainStreamer::TerrainStreamer(const Noise& n, float amplitude, float freq, int oct, FractalType type, const Vector2& origin, float cellSize, int tileCells,
+								 int viewRadius, int prefetchRadius, int maxTileCount)
+	: noise(n), amplitude(amplitude), frequency(freq), octaves(oct), fractalType(type), origin(origin), cellSize(cellSize), tileCells(tileCells),
+	  viewRadius(viewRadius), prefetchRadius(prefetchRadius), generatedTileCount(0)
+{
+	int side = 2 * (viewRadius + prefetchRadius) + 1;
+	this->maxTileCount = size_t(Math::Max(maxTileCount, side * side));
+}
+
+/*
+\brief Destructor. Waits for pending tiles before releasing the fields.
+*/
+TerrainStreamer::~TerrainStreamer()
+{
+	for (auto& it : tiles)
+	{
+		TaskScheduler::Global().Wait(it.second.job);
+		delete it.second.field;
+	}
+	for (size_t i = 0; i < freeFields.size(); i++)
+		delete freeFields[i];
+}
+
+/*
+\brief Hash key of a tile coordinate.
+*/
+unsigned long long TerrainStreamer::Key(const Vector2i& t)
+{
+	return (unsigned long long)(unsigned int)(t.x) << 32 | (unsigned int)(t.y);
+}
+
+/*
+\brief Compute the coordinates of the tile containing a world position.
+*/
+Vector2i TerrainStreamer::TileCoord(const Vector2& p) const
+{
+	float tileSize = tileCells * cellSize;
+	return Vector2i(int(floorf((p.x - origin.x) / tileSize)), int(floorf((p.y - origin.y) / tileSize)));
+}
+
+/*
+\brief Get a tile, scheduling its generation if it is not in the cache. Marks the tile as recently used.
+*/
+TerrainTile& TerrainStreamer::Request(const Vector2i& t)
+{
+	unsigned long long key = Key(t);
+	auto it = tiles.find(key);
+	if (it != tiles.end())
+	{
+		lru.splice(lru.begin(), lru, it->second.lruPosition);
+		return it->second;
+	}
+
+	HeightField* field = nullptr;
+	Vector2 bottomLeft = origin + Vector2(float(t.x * tileCells), float(t.y * tileCells)) * cellSize;
+	Box2D tileBox = Box2D(bottomLeft, bottomLeft + Vector2(tileCells * cellSize));
+	if (freeFields.empty())
+		field = new HeightField(tileCells + 1, tileCells + 1, tileBox);
+	else
+	{
+		field = freeFields.back();
+		freeFields.pop_back();
+		field->SetBox(tileBox);
+	}
+
+	TerrainTile& tile = tiles[key];
+	tile.coord = t;
+	tile.field = field;
+	lru.push_front(key);
+	tile.lruPosition = lru.begin();
+	tile.job = TaskScheduler::Global().Submit([this, field, t] { Generate(field, t); });
+	generatedTileCount++;
+	return tile;
+}
+
+/*
+\brief Request all tiles in [a, b] plus a surrounding ring, prefetched for the next moves.
+The ring is requested first, so that the tiles of [a, b] end up at the front of the LRU list.
+All the requested tiles are kept by the eviction which follows, even if there are more than maxTileCount of them.
+*/
+void TerrainStreamer::RequestRange(const Vector2i& a, const Vector2i& b, int ring)
+{
+	for (int i = a.x - ring; i <= b.x + ring; i++)
+	{
+		for (int j = a.y - ring; j <= b.y + ring; j++)
+		{
+			if (i < a.x || i > b.x || j < a.y || j > b.y)
+				Request(Vector2i(i, j));
+		}
+	}
+	for (int i = a.x; i <= b.x; i++)
+	{
+		for (int j = a.y; j <= b.y; j++)
+			Request(Vector2i(i, j));
+	}
+
+	Evict(size_t((b.x - a.x + 1 + 2 * ring) * (b.y - a.y + 1 + 2 * ring)));
+}
+
+/*
+\brief Compute the samples of a tile from their global indices. Called on a worker thread.
+*/
+void TerrainStreamer::Generate(HeightField* field, const Vector2i& t) const
+{
+	int n = tileCells + 1;
+	std::vector<Vector2> row(n);
+	std::vector<float> heights(n);
+	for (int i = 0; i < n; i++)
+	{
+		float x = origin.x + (t.x * tileCells + i) * cellSize;
+		for (int j = 0; j < n; j++)
+			row[j] = Vector2(x, origin.y + (t.y * tileCells + j) * cellSize);
+		Fractal::Evaluate(noise, fractalType, row.data(), heights.data(), n, amplitude, frequency, octaves);
+		for (int j = 0; j < n; j++)
+			field->Set(i, j, heights[j]);
+	}
+}
+
+/*
+\brief Release the least recently used tiles until the cache fits in maxTileCount. Pending tiles are kept,
+and so are the most recently used ones, which were just requested.
+\param requestedCount number of tiles at the front of the LRU list which must be kept
+*/
+void TerrainStreamer::Evict(size_t requestedCount)
+{
+	size_t candidateCount = lru.size() > requestedCount ? lru.size() - requestedCount : 0;
+	auto it = lru.end();
+	for (size_t k = 0; k < candidateCount && tiles.size() > maxTileCount; k++)
+	{
+		--it;
+		auto tile = tiles.find(*it);
+		if (tile->second.IsReady() == false)
+			continue;
+		freeFields.push_back(tile->second.field);
+		tiles.erase(tile);
+		it = lru.erase(it);
+	}
+}
+
+/*
+\brief Schedule the tiles around a camera position, and release the tiles that are too far.
+\param cameraPosition camera position projected in the (x, z) plane
+*/
+void TerrainStreamer::Update(const Vector2& cameraPosition)
+{
+	Vector2i c = TileCoord(cameraPosition);
+	RequestRange(Vector2i(c.x - viewRadius, c.y - viewRadius), Vector2i(c.x + viewRadius, c.y + viewRadius), prefetchRadius);
+}
+
+/*
+\brief Get a generated tile.
+\return the tile field, or nullptr if the tile is not generated yet.
+*/
+const HeightField* TerrainStreamer::GetTile(const Vector2i& t)
+{
+	auto it = tiles.find(Key(t));
+	if (it == tiles.end() || it->second.IsReady() == false)
+		return nullptr;
+	return it->second.field;
+}
+
+/*
+\brief Fill a field with the samples [firstSample, firstSample + size[ of the global grid.
+Only tiles missing from the cache are generated, the others are copied.
+\param field returned field
+\param firstSample global sample index of field (0, 0)
+*/
+void TerrainStreamer::Assemble(HeightField& field, const Vector2i& firstSample)
+{
+	int rows = field.SizeY();
+	int columns = field.SizeX();
+	Vector2i a = Vector2i(FloorDiv(firstSample.x, tileCells), FloorDiv(firstSample.y, tileCells));
+	Vector2i b = Vector2i(FloorDiv(firstSample.x + rows - 1, tileCells), FloorDiv(firstSample.y + columns - 1, tileCells));
+	RequestRange(a, b, prefetchRadius);
+
+	for (int ti = a.x; ti <= b.x; ti++)
+	{
+		for (int tj = a.y; tj <= b.y; tj++)
+		{
+			auto it = tiles.find(Key(Vector2i(ti, tj)));
+			TerrainTile& tile = it != tiles.end() ? it->second : Request(Vector2i(ti, tj));
+			TaskScheduler::Global().Wait(tile.job);
+
+			int i0 = Math::Max(ti * tileCells, firstSample.x);
+			int i1 = Math::Min((ti + 1) * tileCells, firstSample.x + rows);
+			int j0 = Math::Max(tj * tileCells, firstSample.y);
+			int j1 = Math::Min((tj + 1) * tileCells, firstSample.y + columns);
+			for (int i = i0; i < i1; i++)
+			{
+				for (int j = j0; j < j1; j++)
+					field.Set(i - firstSample.x, j - firstSample.y, tile.field->Get(i - ti * tileCells, j - tj * tileCells));
+			}
+		}
+	}
+}
+
+/*
+\brief Get the number of tiles computed since the creation of the streamer.
+*/
+int TerrainStreamer::GeneratedTileCount() const
+{
+	return generatedTileCount;
+}
+
+/*
+\brief Get the number of tiles in the cache.
+*/
+size_t TerrainStreamer::CachedTileCount() const
+{
+	return tiles.size();
+}
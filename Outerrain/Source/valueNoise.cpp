@@ -0,0 +1,130 @@
+#include "noise.h"
+#include "randomStream.h"
+
+/*
+\brief Value noise class. Interpolates random values stored on an integer lattice.
+Returns value between [-1, 1] in 2D or 3D. Cheaper than gradient noise, but with a more 'blocky' look.
+*/
+
+/*
+\brief Quintic interpolation curve 6x^5 - 15x^4 + 10x^3.
+*/
+static inline float Fade(float t)
+{
+	return ((6.0f * t - 15.0f) * t + 10.0f) * t * t * t;
+}
+
+/*
+\brief Constructor. Initialize the permutation table and the lattice values.
+\param seed noise seed
+*/
+ValueNoise::ValueNoise(unsigned int seed)
+{
+	InitPermutation(seed, perm);
+	RandomStream random(seed, RandomSubsystem::Noise, 2);
+	for (int i = 0; i < 256; i++)
+		lattice[i] = random.Uniform(-1.0f, 1.0f);
+}
+
+/*
+\brief Compute Value noise in 2D. This is an internal function.
+*/
+inline float ValueNoise::At(float x, float y) const
+{
+	int x0 = FastFloor(x);
+	int y0 = FastFloor(y);
+	float u = Fade(x - float(x0));
+	float v = Fade(y - float(y0));
+
+	int i = x0 & 255;
+	int j = y0 & 255;
+	float a = lattice[perm[i + perm[j]]];
+	float b = lattice[perm[i + 1 + perm[j]]];
+	float c = lattice[perm[i + perm[j + 1]]];
+	float d = lattice[perm[i + 1 + perm[j + 1]]];
+
+	float ab = a + u * (b - a);
+	float cd = c + u * (d - c);
+	return ab + v * (cd - ab);
+}
+
+/*
+\brief Compute Value noise in 3D. This is an internal function.
+*/
+inline float ValueNoise::At(float x, float y, float z) const
+{
+	int x0 = FastFloor(x);
+	int y0 = FastFloor(y);
+	int z0 = FastFloor(z);
+	float u = Fade(x - float(x0));
+	float v = Fade(y - float(y0));
+	float w = Fade(z - float(z0));
+
+	int i = x0 & 255;
+	int j = y0 & 255;
+	int k = z0 & 255;
+	float a = lattice[perm[i + perm[j + perm[k]]]];
+	float b = lattice[perm[i + 1 + perm[j + perm[k]]]];
+	float c = lattice[perm[i + perm[j + 1 + perm[k]]]];
+	float d = lattice[perm[i + 1 + perm[j + 1 + perm[k]]]];
+	float e = lattice[perm[i + perm[j + perm[k + 1]]]];
+	float f = lattice[perm[i + 1 + perm[j + perm[k + 1]]]];
+	float g = lattice[perm[i + perm[j + 1 + perm[k + 1]]]];
+	float h = lattice[perm[i + 1 + perm[j + 1 + perm[k + 1]]]];
+
+	float ab = a + u * (b - a);
+	float cd = c + u * (d - c);
+	float ef = e + u * (f - e);
+	float gh = g + u * (h - g);
+	float abcd = ab + v * (cd - ab);
+	float efgh = ef + v * (gh - ef);
+	return abcd + w * (efgh - abcd);
+}
+
+/*
+\brief Compute Value noise in 2D.
+\param point position
+*/
+float ValueNoise::GetValue(const Vector2& point) const
+{
+	return At(point.x, point.y);
+}
+
+/*
+\brief Compute Value noise in 3D.
+\param point position
+*/
+float ValueNoise::GetValue(const Vector3& point) const
+{
+	return At(point.x, point.y, point.z);
+}
+
+/*
+\brief Compute Value noise in 2D for an array of points.
+\param points positions
+\param values returned noise values
+\param count point count
+*/
+void ValueNoise::GetValues(const Vector2* points, float* values, int count) const
+{
+	Batch(points, values, count, [this](const float* x, const float* y, float* r, int n)
+	{
+		for (int k = 0; k < n; k++)
+			r[k] = At(x[k], y[k]);
+	});
+}
+
+/*
+\brief Compute Value noise in 3D for an array of points.
+\param points positions
+\param values returned noise values
+\param count point count
+*/
+void ValueNoise::GetValues(const Vector3* points, float* values, int count) const
+{
+	Batch(points, values, count, [this](const float* x, const float* y, const float* z, float* r, int n)
+	{
+		for (int k = 0; k < n; k++)
+			r[k] = At(x[k], y[k], z[k]);
+	});
+}
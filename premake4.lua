@@ -23,7 +23,7 @@ solution "Outerrain"
 		buildoptions { "-W -Wall -Wsign-compare -Wno-unused-parameter -Wno-unused-variable" }
 		buildoptions { "-flto"}
 		linkoptions { "-flto"}
-		links { "GLEW", "SDL2", "SDL2_image", "GL" }
+		links { "GLEW", "SDL2", "SDL2_image", "GL", "pthread" }
 
 	configuration { "linux", "debug" }
 		buildoptions { "-g"}